@@ -0,0 +1,213 @@
+/*
+GPU-ready texture container: baking and memory mapped loading
+*/
+
+#include "BakedTexture.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+#include "stb_image_.h"
+
+// Only for the format enums stored in headers; nothing here calls GL
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// More levels than a 2^31 texture has means a corrupt file
+static const uint32_t kMaxBakedLevels{ 32 };
+
+// @return: value rounded up to a multiple of alignment (power of two)
+static size_t AlignUp(size_t value, size_t alignment);
+// @return: bytes of a width x height level in the format of header, or 0 if the baker never writes that format
+static size_t GetLevelBytes(const BakedTextureHeader& header, uint32_t width, uint32_t height);
+
+/* BakedTexture implementation */
+
+// Map path; the bake is valid if it is well formed and was made from a source hashing to source_hash
+BakedTexture::BakedTexture(const std::string& path, uint64_t source_hash) :
+    file_{ std::make_unique<MappedFile>(path.c_str()) },
+    status_{ BakedTextureStatus::kMissing },
+    header_{ nullptr },
+    levels_{ nullptr } {
+    if (!file_->IsValid()) {
+        return;
+    }
+    status_ = BakedTextureStatus::kInvalid;
+    const char* data{ file_->GetData() };
+    size_t size{ file_->GetSize() };
+    if (size < sizeof(BakedTextureHeader)) {
+        return;
+    }
+    const BakedTextureHeader* header{ reinterpret_cast<const BakedTextureHeader*>(data) };
+    if (header->magic != kBakedTextureMagic || header->version != kBakedTextureVersion
+        || header->level_count == 0 || header->level_count > kMaxBakedLevels
+        || size < sizeof(BakedTextureHeader) + header->level_count * sizeof(BakedTextureLevel)) {
+        return;
+    }
+    // Levels must be the mip chain of the header's size, in a format GL is known to accept, inside the file
+    const BakedTextureLevel* levels{ reinterpret_cast<const BakedTextureLevel*>(data + sizeof(BakedTextureHeader)) };
+    uint32_t width{ header->width }, height{ header->height };
+    for (uint32_t i{}; i < header->level_count; ++i) {
+        const BakedTextureLevel& level{ levels[i] };
+        if (level.width != width || level.height != height || width == 0 || height == 0
+            || level.size != GetLevelBytes(*header, width, height)
+            || level.offset > size || level.size > size - level.offset) {
+            return;
+        }
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    header_ = header;
+    levels_ = levels;
+    status_ = header->source_hash == source_hash ? BakedTextureStatus::kValid : BakedTextureStatus::kStale;
+}
+
+BakedTexture::~BakedTexture() {}
+
+// Level i's data inside the mapping
+const char* BakedTexture::GetLevelData(uint32_t i) const {
+    return file_->GetData() + levels_[i].offset;
+}
+
+// @return: bytes of level data, all levels
+size_t BakedTexture::GetDataBytes() const {
+    size_t bytes{};
+    for (uint32_t i{}; i < header_->level_count; ++i) {
+        bytes += static_cast<size_t>(levels_[i].size);
+    }
+    return bytes;
+}
+
+// @return: hash of a source image file's bytes, as stored in bakes
+uint64_t HashTextureSource(const void* data, size_t size) {
+    return HashBytes(kHashSeed, data, size);
+}
+
+// @return: path of the bake of source_path
+std::string GetBakedTexturePath(const std::string& source_path) {
+    return source_path + kBakedTextureExtension;
+}
+
+// Decode source_path, build its mip chain with MipGenerator and write it to baked_path
+// RGB images stay RGB8 (rows padded to 4 bytes), anything with alpha becomes RGBA8, unless options compress them
+bool BakeTexture(const std::string& source_path, const std::string& baked_path, const TextureBakeOptions& options) {
+    MappedFile source{ source_path.c_str() };
+    if (!source.IsValid()) {
+        std::cout << "ERROR [BAKE SOURCE NOT FOUND]\n" << source_path << std::endl;
+        return false;
+    }
+    const stbi_uc* encoded{ reinterpret_cast<const stbi_uc*>(source.GetData()) };
+    int encoded_size{ static_cast<int>(source.GetSize()) };
+    int width{}, height{}, channels{};
+    if (!stbi_info_from_memory(encoded, encoded_size, &width, &height, &channels)) {
+        std::cout << "ERROR [BAKE SOURCE DECODE FAILED]\n" << source_path << std::endl;
+        return false;
+    }
+    // The block encoder reads RGBA
+    int components{ (options.compress || channels == 2 || channels == 4) ? 4 : 3 };
+    unsigned char* decoded{ stbi_load_from_memory(encoded, encoded_size, &width, &height, &channels, components) };
+    if (!decoded) {
+        std::cout << "ERROR [BAKE SOURCE DECODE FAILED]\n" << source_path << std::endl;
+        return false;
+    }
+    MipOptions mip_options;
+    mip_options.filter = options.mip_filter;
+    mip_options.srgb = options.srgb;
+    mip_options.jobs = options.jobs;
+    std::vector<std::vector<unsigned char>> chain{ GenerateMipChain(decoded, width, height, components, 1, mip_options) };
+    chain.emplace(chain.begin(), decoded, decoded + static_cast<size_t>(width) * height * components);
+    stbi_image_free(decoded);
+
+    BakedTextureHeader header{};
+    header.magic = kBakedTextureMagic;
+    header.version = kBakedTextureVersion;
+    header.source_hash = HashTextureSource(source.GetData(), source.GetSize());
+    if (options.compress) {
+        header.internal_format = GetBlockFormatGL(options.format);
+    }
+    else {
+        header.internal_format = components == 4 ? GL_RGBA8 : GL_RGB8;
+        header.format = components == 4 ? GL_RGBA : GL_RGB;
+        header.type = GL_UNSIGNED_BYTE;
+    }
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+
+    std::vector<BakedTextureLevel> levels;
+    size_t offset{ sizeof(BakedTextureHeader) };
+    for (int level_width{ width }, level_height{ height }; ; ) {
+        levels.push_back(BakedTextureLevel{ static_cast<uint32_t>(level_width), static_cast<uint32_t>(level_height), 0,
+            GetLevelBytes(header, static_cast<uint32_t>(level_width), static_cast<uint32_t>(level_height)) });
+        if (level_width == 1 && level_height == 1) {
+            break;
+        }
+        level_width = std::max(1, level_width / 2);
+        level_height = std::max(1, level_height / 2);
+    }
+    header.level_count = static_cast<uint32_t>(levels.size());
+    offset += levels.size() * sizeof(BakedTextureLevel);
+    for (BakedTextureLevel& level : levels) {
+        offset = AlignUp(offset, kBakedLevelAlignment);
+        level.offset = offset;
+        offset += static_cast<size_t>(level.size);
+    }
+
+    std::ofstream output{ baked_path, std::ios::binary | std::ios::trunc };
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(BakedTextureLevel));
+    size_t written{ sizeof(header) + levels.size() * sizeof(BakedTextureLevel) };
+    const char kPadding[kBakedLevelAlignment]{};
+    std::vector<unsigned char> blocks;
+    for (size_t i{}; i < levels.size(); ++i) {
+        output.write(kPadding, levels[i].offset - written);
+        written = static_cast<size_t>(levels[i].offset + levels[i].size);
+        if (options.compress) {
+            blocks.resize(static_cast<size_t>(levels[i].size));
+            CompressImage(chain[i].data(), static_cast<int>(levels[i].width), static_cast<int>(levels[i].height),
+                options.format, options.quality, blocks.data(), options.jobs);
+            output.write(reinterpret_cast<const char*>(blocks.data()), blocks.size());
+            continue;
+        }
+        size_t row_bytes{ static_cast<size_t>(levels[i].width) * components };
+        size_t pitch{ AlignUp(row_bytes, 4) };
+        for (uint32_t y{}; y < levels[i].height; ++y) {
+            output.write(reinterpret_cast<const char*>(chain[i].data() + y * row_bytes), row_bytes);
+            output.write(kPadding, pitch - row_bytes);
+        }
+    }
+    if (!output) {
+        std::cout << "ERROR [BAKE WRITE FAILED]\n" << baked_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/* Non-member helper implementation */
+
+// @return: value rounded up to a multiple of alignment (power of two)
+size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// @return: bytes of a width x height level in the format of header, or 0 if the baker never writes that format
+// Uncompressed rows are padded to 4 bytes
+size_t GetLevelBytes(const BakedTextureHeader& header, uint32_t width, uint32_t height) {
+    BlockFormat block_format;
+    if (header.format == 0 && header.type == 0 && FindBlockFormat(header.internal_format, &block_format)) {
+        return GetCompressedSize(block_format, static_cast<int>(width), static_cast<int>(height));
+    }
+    if (header.type != GL_UNSIGNED_BYTE) {
+        return 0;
+    }
+    if (header.internal_format == GL_RGB8 && header.format == GL_RGB) {
+        return AlignUp(static_cast<size_t>(width) * 3, 4) * height;
+    }
+    if (header.internal_format == GL_RGBA8 && header.format == GL_RGBA) {
+        return static_cast<size_t>(width) * 4 * height;
+    }
+    return 0;
+}
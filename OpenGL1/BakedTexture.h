@@ -0,0 +1,121 @@
+/*
+GPU-ready texture container (.btx), written by TextureBaker and memory mapped at runtime.
+It holds the full mip chain in the final GL internal format, so loading is glTexImage2D (or
+glCompressedTexImage2D) per level straight from the mapping: no image decode, no
+glGenerateMipmap and no copy on the CPU. Baking and mapping make no GL calls, so the offline
+baker needs no context; the upload itself is UploadBakedTexture (TextureUpload.h).
+
+File layout, little endian, in the spirit of KTX:
+    BakedTextureHeader
+    BakedTextureLevel[level_count], largest level first
+    level data, each level starting at a multiple of kBakedLevelAlignment
+Uncompressed rows are padded to 4 bytes, which is GL's default GL_UNPACK_ALIGNMENT; block
+compressed levels (BlockCompression.h) are the blocks as glCompressedTexImage2D takes them.
+The header records the FNV-1a hash of the source image file; a bake whose hash does not match
+the source any more is stale and is not loaded.
+*/
+
+#ifndef BAKED_TEXTURE_H
+#define BAKED_TEXTURE_H
+
+#include "BlockCompression.h"
+#include "MipGenerator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class JobSystem;
+class MappedFile;
+
+// "BTX1"
+const uint32_t kBakedTextureMagic{ 0x31585442u };
+const uint32_t kBakedTextureVersion{ 1 };
+// Level data starts on 16 byte boundaries, so it can be read with aligned SIMD loads or copied to a PBO as is
+const size_t kBakedLevelAlignment{ 16 };
+// Appended to the source path to name its bake, e.g. container.jpg.btx
+constexpr const char* kBakedTextureExtension{ ".btx" };
+
+struct BakedTextureHeader {
+    uint32_t magic;
+    uint32_t version;
+    // HashTextureSource of the file the bake was made from
+    uint64_t source_hash;
+    // GL internal format, e.g. GL_RGBA8 or GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    uint32_t internal_format;
+    // glTexImage2D format and type; 0 for compressed formats, which use glCompressedTexImage2D
+    uint32_t format;
+    uint32_t type;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+};
+
+struct BakedTextureLevel {
+    uint32_t width;
+    uint32_t height;
+    // Byte offset of the level data from the start of the file, and its size
+    uint64_t offset;
+    uint64_t size;
+};
+
+static_assert(sizeof(BakedTextureHeader) == 40, "BakedTextureHeader is part of the file format");
+static_assert(sizeof(BakedTextureLevel) == 24, "BakedTextureLevel is part of the file format");
+
+// Outcome of opening a bake
+enum class BakedTextureStatus {
+    kMissing, // no file
+    kInvalid, // not a bake of this version, or truncated
+    kStale,   // made from a different version of the source
+    kValid
+};
+
+// Memory mapped bake, checked against its source
+class BakedTexture {
+    std::unique_ptr<MappedFile> file_;
+    BakedTextureStatus status_;
+    const BakedTextureHeader* header_;
+    const BakedTextureLevel* levels_;
+public:
+    // Map path; the bake is valid if it is well formed and was made from a source hashing to source_hash
+    BakedTexture(const std::string& path, uint64_t source_hash);
+    ~BakedTexture();
+    BakedTexture(const BakedTexture&) = delete;
+    BakedTexture& operator=(const BakedTexture&) = delete;
+
+    BakedTextureStatus GetStatus() const { return status_; }
+    bool IsValid() const { return status_ == BakedTextureStatus::kValid; }
+    // Header fields; only meaningful for valid and stale bakes
+    const BakedTextureHeader& GetHeader() const { return *header_; }
+    bool IsCompressed() const { return header_->format == 0; }
+    // Level i, largest first, and its data inside the mapping; valid and stale bakes only
+    const BakedTextureLevel& GetLevel(uint32_t i) const { return levels_[i]; }
+    const char* GetLevelData(uint32_t i) const;
+    // @return: bytes of level data, all levels; valid and stale bakes only
+    size_t GetDataBytes() const;
+};
+
+// How BakeTexture stores the levels
+struct TextureBakeOptions {
+    // Block compress every level in format instead of storing RGB8/RGBA8
+    bool compress{};
+    BlockFormat format{ BlockFormat::kBC1 };
+    BlockQuality quality{ BlockQuality::kQuality };
+    MipFilter mip_filter{ MipFilter::kBox };
+    // Filter the color channels in linear light (MipOptions::srgb); off for data such as normal maps
+    bool srgb{ true };
+    // Spreads the mip filtering and the compression of each level over its threads; may be nullptr
+    JobSystem* jobs{};
+};
+
+// @return: hash of a source image file's bytes, as stored in bakes
+uint64_t HashTextureSource(const void* data, size_t size);
+// @return: path of the bake of source_path
+std::string GetBakedTexturePath(const std::string& source_path);
+// Decode source_path, build its mip chain and write it to baked_path
+// @return: false if the source cannot be decoded or the bake cannot be written
+bool BakeTexture(const std::string& source_path, const std::string& baked_path,
+    const TextureBakeOptions& options = TextureBakeOptions{});
+
+#endif // !BAKED_TEXTURE_H
@@ -0,0 +1,968 @@
+/*
+CPU benchmarks for the renderer's hot loops
+*/
+
+#include "Benchmark.h"
+#include "BakedTexture.h"
+#include "BlockCompression.h"
+#include "Camera.h"
+#include "Culling.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+#include "ProgramCache.h"
+#include "Shader.h"
+#include "ShaderCompiler.h"
+#include "SpirvLibrary.h"
+#include "TextureManager.h"
+#include "TextureStreamer.h"
+#include "TextureUpload.h"
+#include "stb_image_.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Timed repetitions per measurement; the median is reported
+static const int kBenchmarkRepeats{ 15 };
+// Textures loaded per textures measurement at most, kTexturesPerFrame of them requested each frame
+static const size_t kMaxStreamedTextures{ 1000 };
+static const size_t kTexturesPerFrame{ 10 };
+// Textures kept alive at once; older ones have left the view of the flythrough and are deleted
+static const size_t kLiveTextures{ 64 };
+// Frame time of 60 Hz
+static const double kFrameBudgetMs{ 1000. / 60. };
+// texture_cache: distinct images along the flythrough, their size, and how many are in view at once
+static const int kCacheTextures{ 200 };
+static const int kCacheTextureSize{ 128 };
+static const int kCacheVisibleTextures{ 32 };
+// In view in every frame, like terrain or UI textures
+static const int kCachePinnedTextures{ 4 };
+// Every kCacheCopyInterval-th image is also written under a second name with the same bytes
+static const int kCacheCopyInterval{ 10 };
+// Side of the square images of the block compression corpus
+static const int kCompressImageSize{ 256 };
+// Side of the square image mip chains are built for
+static const int kMipImageSize{ 1024 };
+
+// Frustum culling throughput of each SIMD level on spheres and boxes
+static int RunCullingBenchmark(size_t object_count);
+// Per-frame culling + animation over JobSystems of 1..N threads
+static int RunJobScalingBenchmark(size_t object_count);
+// Cost of one model matrix upload through each way of naming the uniform
+static int RunUniformBenchmark(size_t object_count);
+// Startup cost of building the scene program from source vs from the binary cache
+static int RunProgramCacheBenchmark(size_t object_count);
+// Startup cost of building the scene variants from GLSL vs from precompiled SPIR-V
+static int RunSpirvBenchmark(size_t object_count);
+// Frame times while textures load during a flythrough, on the GL thread vs through TextureStreamer
+static int RunTextureStreamingBenchmark(size_t object_count);
+// Hit rate and reloads of TextureManager along a flythrough under budgets below and above its working set
+static int RunTextureCacheBenchmark(size_t object_count);
+// Load time of a texture decoded from its source file vs uploaded from its bake
+static int RunBakedTextureBenchmark(size_t object_count);
+// PSNR and encode throughput of the block compression formats over a synthetic image corpus
+static int RunBlockCompressionBenchmark(size_t object_count);
+// CPU mip chains per filter, SIMD level and thread count vs glGenerateMipmap, and the gamma of each
+static int RunMipGenerationBenchmark(size_t object_count);
+// Hidden window whose core context of at least the given version is current on this thread; nullptr on failure
+// Terminate with glfwTerminate
+static GLFWwindow* CreateBenchmarkContext(int major = 3, int minor = 3);
+// @return: median milliseconds of kBenchmarkRepeats calls of body, after one warm-up call
+template <typename Body>
+static double TimeMedianMs(Body&& body);
+
+// Every benchmark, looked up by name
+struct BenchmarkEntry {
+    const char* name;
+    int (*run)(size_t object_count);
+};
+static const BenchmarkEntry kBenchmarks[]{
+    { "cull", RunCullingBenchmark },
+    { "jobs", RunJobScalingBenchmark },
+    { "uniforms", RunUniformBenchmark },
+    { "programs", RunProgramCacheBenchmark },
+    { "spirv", RunSpirvBenchmark },
+    { "textures", RunTextureStreamingBenchmark },
+    { "texture_cache", RunTextureCacheBenchmark },
+    { "baked", RunBakedTextureBenchmark },
+    { "compress", RunBlockCompressionBenchmark },
+    { "mips", RunMipGenerationBenchmark },
+};
+
+// Run the named benchmark over object_count objects and print the results
+int RunBenchmark(const char* name, size_t object_count) {
+    for (const BenchmarkEntry& entry : kBenchmarks) {
+        if (strcmp(entry.name, name) == 0) {
+            return entry.run(object_count);
+        }
+    }
+    std::cout << "ERROR [UNKNOWN BENCHMARK " << name << "] available:";
+    for (const BenchmarkEntry& entry : kBenchmarks) { std::cout << " " << entry.name; }
+    std::cout << std::endl;
+    return 1;
+}
+
+/* Non-member helper implementation */
+
+// Frustum culling throughput of each SIMD level on spheres and boxes
+int RunCullingBenchmark(size_t object_count) {
+    // Same camera and projection as the render loop
+    const Camera& camera{ Camera::GetInstance() };
+    glm::mat4 proj{ glm::perspective(glm::radians(static_cast<float>(camera.GetZoom())), 800.f / 600.f, 0.1f, 100.f) };
+    Frustum frustum{ ExtractFrustum(proj * camera.GetViewTransform()) };
+
+    // Objects scattered around the camera, so a realistic fraction ends up outside
+    std::mt19937 rng{ 1234 };
+    std::uniform_real_distribution<float> spread{ -100.f, 100.f };
+    std::uniform_real_distribution<float> size{ 0.25f, 2.f };
+    BoundingSpheres spheres;
+    BoundingBoxes boxes;
+    for (size_t i{}; i < object_count; ++i) {
+        glm::vec3 center{ spread(rng), spread(rng), spread(rng) };
+        glm::vec3 half{ size(rng), size(rng), size(rng) };
+        spheres.Add(center, glm::length(half));
+        boxes.Add(center - half, center + half);
+    }
+
+    std::cout << "Frustum culling, " << object_count << " objects, best SIMD level "
+        << GetSimdLevelName(GetBestSimdLevel()) << std::endl;
+
+    std::vector<uint32_t> reference_spheres, reference_boxes, visible;
+    CullSpheres(frustum, spheres, reference_spheres, SimdLevel::kScalar);
+    CullBoxes(frustum, boxes, reference_boxes, SimdLevel::kScalar);
+
+    int result{};
+    for (SimdLevel level : { SimdLevel::kScalar, SimdLevel::kSse2, SimdLevel::kAvx2 }) {
+        if (level > GetBestSimdLevel()) {
+            continue;
+        }
+        double sphere_ms{ TimeMedianMs([&] { CullSpheres(frustum, spheres, visible, level); }) };
+        bool spheres_match{ visible == reference_spheres };
+        double box_ms{ TimeMedianMs([&] { CullBoxes(frustum, boxes, visible, level); }) };
+        bool boxes_match{ visible == reference_boxes };
+
+        std::cout << "    " << GetSimdLevelName(level) << ": spheres " << object_count / sphere_ms / 1e6 << " M objects/ms ("
+            << reference_spheres.size() << " visible), boxes " << object_count / box_ms / 1e6 << " M objects/ms ("
+            << reference_boxes.size() << " visible)" << std::endl;
+        if (!spheres_match || !boxes_match) {
+            std::cout << "ERROR [" << GetSimdLevelName(level) << " CULLING RESULT DIFFERS FROM SCALAR]" << std::endl;
+            result = 1;
+        }
+    }
+
+    // The JobSystem overloads on every hardware thread; the single core figures above are compute bound, see Culling.h
+    JobSystem jobs{ std::max(1u, std::thread::hardware_concurrency()) };
+    double sphere_ms{ TimeMedianMs([&] { CullSpheres(frustum, spheres, visible, jobs); }) };
+    bool spheres_match{ visible == reference_spheres };
+    double box_ms{ TimeMedianMs([&] { CullBoxes(frustum, boxes, visible, jobs); }) };
+    bool boxes_match{ visible == reference_boxes };
+    std::cout << "    JobSystem, " << jobs.GetThreadCount() << " threads: spheres " << object_count / sphere_ms / 1e6
+        << " M objects/ms, boxes " << object_count / box_ms / 1e6 << " M objects/ms" << std::endl;
+    if (!spheres_match || !boxes_match) {
+        std::cout << "ERROR [JOB SYSTEM CULLING RESULT DIFFERS FROM SCALAR]" << std::endl;
+        result = 1;
+    }
+    return result;
+}
+
+// Per-frame culling + animation over JobSystems of 1..N threads
+int RunJobScalingBenchmark(size_t object_count) {
+    const Camera& camera{ Camera::GetInstance() };
+    glm::mat4 proj{ glm::perspective(glm::radians(static_cast<float>(camera.GetZoom())), 800.f / 600.f, 0.1f, 100.f) };
+    Frustum frustum{ ExtractFrustum(proj * camera.GetViewTransform()) };
+
+    // Laid out like the render loop's cube field: mostly in front of the camera
+    std::mt19937 rng{ 1234 };
+    float extent{ std::cbrt(static_cast<float>(object_count)) };
+    std::uniform_real_distribution<float> spread{ -extent, extent };
+    std::uniform_real_distribution<float> depth{ -2.f * extent, 0.f };
+    std::vector<glm::vec3> positions(object_count);
+    BoundingSpheres spheres;
+    for (glm::vec3& position : positions) {
+        position = glm::vec3{ spread(rng), spread(rng), depth(rng) };
+        spheres.Add(position, std::sqrt(3.f) * 0.5f);
+    }
+
+    std::vector<uint32_t> visible;
+    std::vector<glm::mat4> transforms(object_count);
+    const size_t max_threads{ std::max(1u, std::thread::hardware_concurrency()) };
+    std::cout << "Job scaling, " << object_count << " objects: cull, then animate the visible ones; up to "
+        << max_threads << " threads" << std::endl;
+
+    double single_thread_ms{};
+    for (size_t thread_count{ 1 }; thread_count <= max_threads; ++thread_count) {
+        JobSystem jobs{ thread_count };
+        double ms{ TimeMedianMs([&] {
+            CullSpheres(frustum, spheres, visible, jobs);
+            jobs.ParallelFor(visible.size(), [&](size_t begin, size_t end) {
+                for (size_t v{ begin }; v < end; ++v) {
+                    uint32_t i{ visible[v] };
+                    glm::mat4 model{ glm::translate(glm::mat4{ 1.f }, positions[i]) };
+                    transforms[v] = glm::rotate(model, 1.5f * glm::radians(20.f * (i % 10 + 1)), glm::vec3{ 1.f, 0.3f, 0.5f });
+                }
+            }, 256);
+        }) };
+        if (thread_count == 1) {
+            single_thread_ms = ms;
+        }
+        double speedup{ single_thread_ms / ms };
+        std::cout << "    " << thread_count << " threads: " << ms << " ms/frame (" << visible.size() << " visible), "
+            << speedup << "x, " << 100. * speedup / thread_count << "% efficiency" << std::endl;
+    }
+    return 0;
+}
+
+// Cost of one model matrix upload through each way of naming the uniform
+int RunUniformBenchmark(size_t object_count) {
+    if (!CreateBenchmarkContext()) {
+        return 1;
+    }
+    int result{};
+    {
+        Shader shader{ "shader0.vert", "shader0.frag" };
+        shader.Use();
+        constexpr UniformName kModel{ "model" };
+        UniformHandle model{ shader.GetUniform(kModel) };
+        glm::mat4 transform{ 1.f };
+
+        std::cout << "Uniform upload, " << object_count << " glUniformMatrix4fv calls per measurement, "
+            << shader.GetUniformCount() << " active uniforms" << std::endl;
+        auto report = [object_count](const char* label, double ms) {
+            std::cout << "    " << label << ": " << ms * 1e6 / object_count << " ns/call" << std::endl;
+        };
+        // glFinish keeps queued driver work from one variant from being billed to the next
+        report("glGetUniformLocation per call", TimeMedianMs([&] {
+            for (size_t i{}; i < object_count; ++i) {
+                glUniformMatrix4fv(glGetUniformLocation(shader.GetId(), "model"), 1, GL_FALSE, &transform[0][0]);
+            }
+            glFinish();
+        }));
+        report("runtime hashed name", TimeMedianMs([&] {
+            for (size_t i{}; i < object_count; ++i) {
+                shader.SetMatrix4("model", transform);
+            }
+            glFinish();
+        }));
+        report("constexpr hashed name", TimeMedianMs([&] {
+            for (size_t i{}; i < object_count; ++i) {
+                shader.SetMatrix4(kModel, transform);
+            }
+            glFinish();
+        }));
+        report("pre-resolved handle", TimeMedianMs([&] {
+            for (size_t i{}; i < object_count; ++i) {
+                shader.SetMatrix4(model, transform);
+            }
+            glFinish();
+        }));
+        if (model.location != glGetUniformLocation(shader.GetId(), "model")) {
+            std::cout << "ERROR [UNIFORM TABLE DISAGREES WITH glGetUniformLocation]" << std::endl;
+            result = 1;
+        }
+    }
+    glfwTerminate();
+    return result;
+}
+
+// Startup cost of building the scene program from source vs from the binary cache
+int RunProgramCacheBenchmark(size_t) {
+    if (!CreateBenchmarkContext()) {
+        return 1;
+    }
+    int result{};
+    {
+        // Separate from the app's cache so the cold runs do not evict anything it relies on
+        const char* directory{ "shader_cache_bench" };
+        ProgramCache cold_cache{ directory, false };
+        ProgramCache warm_cache{ directory };
+        if (!warm_cache.IsSupported()) {
+            glfwTerminate();
+            return 1;
+        }
+        // The median of several builds; the driver's own shader cache may already shorten cold builds
+        auto build_ms = [](ProgramCache& cache) {
+            return TimeMedianMs([&cache] {
+                Shader shader{ "shader0.vert", "shader0.frag", &cache };
+            });
+        };
+        double cold_ms{ build_ms(cold_cache) };
+        double warm_ms{ build_ms(warm_cache) };
+        const ProgramCacheStats& stats{ warm_cache.GetStats() };
+
+        std::cout << "Program build, shader0 (vertex + fragment)" << std::endl;
+        std::cout << "    compiled from source: " << cold_ms << " ms" << std::endl;
+        std::cout << "    loaded from binary cache: " << warm_ms << " ms (" << cold_ms / warm_ms << "x)" << std::endl;
+        std::cout << "    cache hits " << stats.hits << ", misses " << stats.misses
+            << ", rejected " << stats.rejected << std::endl;
+        if (stats.hits == 0) {
+            std::cout << "ERROR [PROGRAM CACHE NEVER HIT]" << std::endl;
+            result = 1;
+        }
+    }
+    glfwTerminate();
+    return result;
+}
+
+// Startup cost of building the scene variants from GLSL vs from precompiled SPIR-V
+// The first run exports the GLSL of every stage; compile it with compile_spirv.py and run again
+int RunSpirvBenchmark(size_t) {
+#ifndef _WIN32
+    // Mesa's on-disk cache would turn repeated GLSL builds into cache hits; the caller's setting wins
+    setenv("MESA_SHADER_CACHE_DISABLE", "true", 0);
+#endif
+    // SPIR-V is core in 4.6; older contexts may still have ARB_gl_spirv
+    if (!CreateBenchmarkContext(4, 6) && !CreateBenchmarkContext(4, 5)) {
+        return 1;
+    }
+    {
+        std::cout << "GL_RENDERER: " << glGetString(GL_RENDERER) << std::endl;
+        // Every combination of the scene's feature defines, as the variant cache builds them
+        const char* const kFeatures[]{ "INSTANCED", "QUANTIZED_POSITIONS" };
+        std::vector<std::vector<std::string>> variants;
+        for (uint32_t mask{}; mask < 4; ++mask) {
+            std::vector<std::string> defines;
+            for (uint32_t bit{}; bit < 2; ++bit) {
+                if (mask & (1u << bit)) { defines.push_back(kFeatures[bit]); }
+            }
+            variants.push_back(defines);
+        }
+        SpirvLibrary library{ "spirv", true };
+        if (!library.IsSupported()) {
+            std::cout << "ERROR [DRIVER HAS NO ARB_gl_spirv]" << std::endl;
+            glfwTerminate();
+            return 1;
+        }
+        // @return: whether every variant was linked from SPIR-V; programs are deleted right away
+        auto build_all = [&variants](SpirvLibrary* spirv) {
+            ShaderCompiler compiler{ nullptr, spirv };
+            std::vector<std::unique_ptr<Shader>> shaders;
+            for (const std::vector<std::string>& defines : variants) {
+                shaders.push_back(std::make_unique<Shader>("shader0.vert", "shader0.frag", compiler, defines));
+            }
+            compiler.Finish();
+            bool all_spirv{ true };
+            for (const std::unique_ptr<Shader>& shader : shaders) {
+                all_spirv = all_spirv && shader->IsReady() && shader->IsSpirv();
+            }
+            return all_spirv;
+        };
+        if (!build_all(&library)) {
+            std::cout << "Missing SPIR-V modules; " << library.GetStats().exported << " stage sources exported to spirv/."
+                << " Run python compile_spirv.py spirv and benchmark again" << std::endl;
+            glfwTerminate();
+            return 1;
+        }
+        double glsl_ms{ TimeMedianMs([&build_all] { build_all(nullptr); }) };
+        double spirv_ms{ TimeMedianMs([&build_all, &library] { build_all(&library); }) };
+
+        std::cout << "Program build, " << variants.size() << " variants of shader0 (vertex + fragment), compile + link" << std::endl;
+        std::cout << "    GLSL: " << glsl_ms << " ms, " << glsl_ms / variants.size() << " ms per program" << std::endl;
+        std::cout << "    SPIR-V: " << spirv_ms << " ms, " << spirv_ms / variants.size() << " ms per program ("
+            << glsl_ms / spirv_ms << "x)" << std::endl;
+    }
+    glfwTerminate();
+    return 0;
+}
+
+// Frame times while textures load during a flythrough, on the GL thread vs through TextureStreamer
+// A frame requests kTexturesPerFrame textures and ends with glFinish, so upload work the driver
+// defers is billed to the frame that caused it
+int RunTextureStreamingBenchmark(size_t object_count) {
+    if (!CreateBenchmarkContext()) {
+        return 1;
+    }
+    int result{};
+    {
+        const char* const kFiles[]{ "container.jpg", "awesomeface.png" };
+        size_t texture_count{ std::min(object_count, kMaxStreamedTextures) };
+
+        // Run frames at 60 Hz until every texture has been requested and done() holds; a frame that
+        // finishes early sleeps out the rest of its interval, as it would waiting for vsync
+        // @return: milliseconds of work in each frame, and the wall time of all frames last
+        auto run_frames = [texture_count, &kFiles](auto&& request, auto&& update, auto&& done) {
+            std::vector<double> frame_ms;
+            size_t requested{};
+            auto first = std::chrono::steady_clock::now();
+            while (requested < texture_count || !done()) {
+                auto start = std::chrono::steady_clock::now();
+                for (size_t i{}; i < kTexturesPerFrame && requested < texture_count; ++i, ++requested) {
+                    request(kFiles[requested % 2]);
+                }
+                update();
+                glClear(GL_COLOR_BUFFER_BIT);
+                glFinish();
+                frame_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                std::this_thread::sleep_until(start + std::chrono::duration<double, std::milli>(kFrameBudgetMs));
+            }
+            frame_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - first).count());
+            return frame_ms;
+        };
+        auto report = [](const char* label, std::vector<double> frame_ms) {
+            double total_ms{ frame_ms.back() };
+            frame_ms.pop_back();
+            size_t over_budget{ static_cast<size_t>(std::count_if(frame_ms.begin(), frame_ms.end(),
+                [](double ms) { return ms > kFrameBudgetMs; })) };
+            std::sort(frame_ms.begin(), frame_ms.end());
+            std::cout << "    " << label << ": " << frame_ms.size() << " frames, " << total_ms << " ms until loaded; frame ms median "
+                << frame_ms[frame_ms.size() / 2] << ", p99 " << frame_ms[frame_ms.size() * 99 / 100] << ", max " << frame_ms.back()
+                << "; " << over_budget << " frames over " << kFrameBudgetMs << " ms" << std::endl;
+        };
+
+        // The old path: decode and upload on the GL thread, as TextureManager does without a streamer
+        std::deque<unsigned int> live;
+        auto evict = [&live](auto&& is_loaded, auto&& destroy) {
+            while (live.size() > kLiveTextures && is_loaded(live.front())) {
+                destroy(live.front());
+                live.pop_front();
+            }
+        };
+        auto delete_texture = [](unsigned int texture) { glDeleteTextures(1, &texture); };
+        size_t failed{};
+        std::vector<double> sync_ms{ run_frames([&](const char* path) {
+            unsigned int texture;
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            int width, height, channels;
+            unsigned char* pixels{ stbi_load(path, &width, &height, &channels, 0) };
+            if (!pixels) {
+                ++failed;
+            }
+            else {
+                GLenum format{ channels == 4 ? static_cast<GLenum>(GL_RGBA) : static_cast<GLenum>(GL_RGB) };
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                glTexImage2D(GL_TEXTURE_2D, 0, channels == 4 ? GL_RGBA8 : GL_RGB8, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                glGenerateMipmap(GL_TEXTURE_2D);
+                stbi_image_free(pixels);
+            }
+            live.push_back(texture);
+            evict([](unsigned int) { return true; }, delete_texture);
+        }, [] {}, [] { return true; }) };
+        std::for_each(live.begin(), live.end(), delete_texture);
+        live.clear();
+
+        // A frame with nothing to load, for reference
+        std::vector<double> idle_ms{ run_frames([](const char*) {}, [] {}, [] { return true; }) };
+
+        std::cout << "Texture loading, " << texture_count << " textures (" << kFiles[0] << ", " << kFiles[1] << "), "
+            << kTexturesPerFrame << " requested per frame, " << kLiveTextures << " kept alive" << std::endl;
+        std::cout << "    GL_RENDERER: " << glGetString(GL_RENDERER) << std::endl;
+        report("no loading", idle_ms);
+        report("decode + upload on the GL thread", sync_ms);
+
+        // The default budget, and four times it to show what a larger budget costs in frame time
+        for (size_t budget : { kDefaultTextureUploadBudget, kDefaultTextureUploadBudget * 4 }) {
+            TextureStreamer streamer{ budget };
+            std::vector<double> streamed_ms{ run_frames([&](const char* path) {
+                live.push_back(streamer.Request(path));
+            }, [&] {
+                streamer.Update();
+                evict([&streamer](unsigned int texture) { return streamer.IsLoaded(texture); },
+                    [&streamer](unsigned int texture) { streamer.Release(texture); });
+            }, [&streamer] { return streamer.GetPendingCount() == 0; }) };
+            std::for_each(live.begin(), live.end(), [&streamer](unsigned int texture) { streamer.Release(texture); });
+            live.clear();
+
+            const TextureStreamerStats& stats{ streamer.GetStats() };
+            std::string label{ "TextureStreamer, " + std::to_string(budget >> 20) + " MB per frame" };
+            report(label.c_str(), streamed_ms);
+            std::cout << "        " << streamer.GetDecodeThreadCount() << " decode threads, "
+                << stats.uploaded << " uploaded (" << stats.direct_uploads << " direct), "
+                << stats.bytes_uploaded / (1024. * 1024.) << " MB, " << stats.update_ms / streamed_ms.size() << " ms per Update" << std::endl;
+            failed += stats.failed + (texture_count - stats.uploaded - stats.failed);
+        }
+        if (failed > 0) {
+            std::cout << "ERROR [" << failed << " TEXTURES FAILED TO LOAD]" << std::endl;
+            result = 1;
+        }
+    }
+    glfwTerminate();
+    return result;
+}
+
+// Hit rate and reloads of TextureManager along a flythrough under budgets below and above its working set
+// The camera passes kCacheTextures images twice, kCacheVisibleTextures of them in view at a time;
+// the second lap finds them all resident only if the budget holds the whole lap
+int RunTextureCacheBenchmark(size_t) {
+    if (!CreateBenchmarkContext()) {
+        return 1;
+    }
+    int result{};
+    {
+        // PPM, which stb_image reads, so no encoder is needed; each image gets its own gradient
+        const std::string directory{ "texture_cache_bench" };
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+        std::vector<std::string> paths;
+        std::vector<unsigned char> pixels(kCacheTextureSize * kCacheTextureSize * 3);
+        for (int t{}; t < kCacheTextures; ++t) {
+            for (size_t i{}; i < pixels.size(); ++i) {
+                pixels[i] = static_cast<unsigned char>(i * (t + 1) + t);
+            }
+            std::string header{ "P6\n" + std::to_string(kCacheTextureSize) + " " + std::to_string(kCacheTextureSize) + "\n255\n" };
+            // Copies stand in for the same image shipped in two places
+            int copies{ t % kCacheCopyInterval == 0 ? 2 : 1 };
+            for (int copy{}; copy < copies; ++copy) {
+                paths.push_back(directory + "/" + std::to_string(t) + (copy ? "_copy" : "") + ".ppm");
+                std::ofstream file{ paths.back(), std::ios::binary };
+                file << header;
+                file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+            }
+        }
+        size_t texture_bytes{ EstimateTextureBytes(kCacheTextureSize, kCacheTextureSize, 4) };
+        size_t working_set{ kCacheTextures * texture_bytes };
+
+        std::cout << "Texture cache, " << kCacheTextures << " images (" << paths.size() << " files) of "
+            << kCacheTextureSize << "x" << kCacheTextureSize << ", " << kCacheVisibleTextures << " + "
+            << kCachePinnedTextures << " in view, 2 laps; all images " << working_set / (1024. * 1024.) << " MB" << std::endl;
+        for (double fraction : { 0.25, 0.5, 1., 2. }) {
+            TextureManager manager{ static_cast<size_t>(working_set * fraction) };
+            std::vector<TextureHandle> in_view;
+            auto start = std::chrono::steady_clock::now();
+            // The window of files in view moves one file forward per step
+            int steps{ 2 * static_cast<int>(paths.size()) };
+            for (int step{}; step < steps; ++step) {
+                // Acquire the new view before dropping the old one, as a renderer swapping frames would
+                std::vector<TextureHandle> next_view;
+                for (int i{}; i < kCachePinnedTextures; ++i) {
+                    next_view.push_back(manager.Acquire(paths[i]));
+                }
+                for (int i{}; i < kCacheVisibleTextures; ++i) {
+                    next_view.push_back(manager.Acquire(paths[(kCachePinnedTextures + step + i) % paths.size()]));
+                }
+                in_view = std::move(next_view);
+            }
+            in_view.clear();
+            glFinish();
+            double total_ms{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+
+            const TextureManagerStats& stats{ manager.GetStats() };
+            size_t acquires{ stats.hits + stats.content_hits + stats.misses };
+            std::cout << "    budget " << fraction * 100. << "% (" << manager.GetBudget() / (1024. * 1024.) << " MB): "
+                << 100. * (stats.hits + stats.content_hits) / acquires << "% hits (" << stats.content_hits << " by content), "
+                << stats.misses << " loads (" << stats.misses - kCacheTextures << " reloads), " << stats.evictions << " evictions, peak "
+                << stats.peak_bytes / (1024. * 1024.) << " MB, " << total_ms << " ms" << std::endl;
+            if (stats.failed > 0 || stats.misses < static_cast<size_t>(kCacheTextures)) {
+                std::cout << "ERROR [TEXTURE CACHE LOADED " << stats.misses << " OF " << kCacheTextures << " IMAGES]" << std::endl;
+                result = 1;
+            }
+            // With room for everything, the second lap must not load anything
+            if (fraction >= 1. && stats.misses != static_cast<size_t>(kCacheTextures)) {
+                std::cout << "ERROR [TEXTURE CACHE RELOADED WITHIN BUDGET]" << std::endl;
+                result = 1;
+            }
+        }
+    }
+    glfwTerminate();
+    return result;
+}
+
+// Load time of a texture decoded from its source file vs uploaded from its bake
+// Each load ends with glFinish, so uploads and mip generation the driver defers are included
+int RunBakedTextureBenchmark(size_t) {
+    if (!CreateBenchmarkContext()) {
+        return 1;
+    }
+    int result{};
+    {
+        // Bakes go here rather than next to the sources, so the app keeps decoding unless baked on purpose
+        const std::string directory{ "texture_bake_bench" };
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+        std::cout << "Texture loading, source file vs bake, GL_RENDERER: " << glGetString(GL_RENDERER) << std::endl;
+        for (const char* source_path : { "container.jpg", "awesomeface.png" }) {
+            std::string baked_path{ directory + "/" + source_path + kBakedTextureExtension };
+            auto bake_start = std::chrono::steady_clock::now();
+            if (!BakeTexture(source_path, baked_path)) {
+                result = 1;
+                continue;
+            }
+            double bake_ms{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bake_start).count() };
+            MappedFile source{ source_path };
+            uint64_t source_hash{ HashTextureSource(source.GetData(), source.GetSize()) };
+
+            unsigned int texture;
+            // What the app did before bakes: decode, upload level 0, let the driver build the mips
+            double decode_ms{ TimeMedianMs([&] {
+                glGenTextures(1, &texture);
+                glBindTexture(GL_TEXTURE_2D, texture);
+                int width, height, channels;
+                unsigned char* pixels{ stbi_load(source_path, &width, &height, &channels, 0) };
+                GLenum format{ channels == 4 ? static_cast<GLenum>(GL_RGBA) : static_cast<GLenum>(GL_RGB) };
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                glTexImage2D(GL_TEXTURE_2D, 0, channels == 4 ? GL_RGBA8 : GL_RGB8, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                glGenerateMipmap(GL_TEXTURE_2D);
+                stbi_image_free(pixels);
+                glFinish();
+                glDeleteTextures(1, &texture);
+            }) };
+            // As TextureManager loads a bake: the source is read and hashed to reject stale bakes
+            auto load_baked = [&](bool hash_source) {
+                glGenTextures(1, &texture);
+                glBindTexture(GL_TEXTURE_2D, texture);
+                uint64_t hash{ source_hash };
+                if (hash_source) {
+                    MappedFile file{ source_path };
+                    hash = HashTextureSource(file.GetData(), file.GetSize());
+                }
+                BakedTexture baked{ baked_path, hash };
+                if (baked.IsValid()) {
+                    UploadBakedTexture(baked);
+                }
+                glFinish();
+                glDeleteTextures(1, &texture);
+            };
+            double baked_ms{ TimeMedianMs([&] { load_baked(true); }) };
+            double trusted_ms{ TimeMedianMs([&] { load_baked(false); }) };
+
+            BakedTexture baked{ baked_path, source_hash };
+            BakedTexture stale{ baked_path, source_hash + 1 };
+            if (!baked.IsValid() || stale.GetStatus() != BakedTextureStatus::kStale) {
+                std::cout << "ERROR [BAKE OF " << source_path << " NOT ACCEPTED, OR A STALE ONE WAS]" << std::endl;
+                result = 1;
+                continue;
+            }
+            const BakedTextureHeader& header{ baked.GetHeader() };
+            std::cout << "    " << source_path << ", " << header.width << "x" << header.height << ", "
+                << header.level_count << " levels; source " << source.GetSize() / 1024. << " KB, bake "
+                << baked.GetDataBytes() / 1024. << " KB, baked in " << bake_ms << " ms" << std::endl;
+            std::cout << "        decode + glGenerateMipmap: " << decode_ms << " ms" << std::endl;
+            std::cout << "        bake, source hash checked: " << baked_ms << " ms (" << decode_ms / baked_ms << "x)" << std::endl;
+            std::cout << "        bake, hash known: " << trusted_ms << " ms (" << decode_ms / trusted_ms << "x)" << std::endl;
+        }
+    }
+    glfwTerminate();
+    return result;
+}
+
+int RunBlockCompressionBenchmark(size_t) {
+    if (!CreateBenchmarkContext()) {
+        return 1;
+    }
+    int result{};
+    {
+        // What textures tend to hold: smooth color, fine detail, hard edges with alpha, and a normal map
+        const int size{ kCompressImageSize };
+        std::mt19937 rng{ 1234 };
+        std::uniform_int_distribution<int> grain{ -12, 12 };
+        struct CorpusImage {
+            const char* name;
+            std::vector<unsigned char> rgba;
+        };
+        std::vector<CorpusImage> corpus{ { "gradient", {} }, { "detail", {} }, { "edges", {} }, { "normals", {} } };
+        for (CorpusImage& image : corpus) {
+            image.rgba.resize(static_cast<size_t>(size) * size * 4);
+        }
+        auto height_at = [](float x, float y) { return std::sin(x * 0.05f) * std::cos(y * 0.07f) + 0.5f * std::sin((x + y) * 0.13f); };
+        for (int y{}; y < size; ++y) {
+            for (int x{}; x < size; ++x) {
+                size_t i{ (static_cast<size_t>(y) * size + x) * 4 };
+                auto clamp = [](float value) { return static_cast<unsigned char>(std::min(255.f, std::max(0.f, value))); };
+                float u{ static_cast<float>(x) / size }, v{ static_cast<float>(y) / size };
+                unsigned char gradient[4]{ clamp(255.f * u), clamp(255.f * v), clamp(255.f * (1.f - u * v)), clamp(255.f * (u + v) / 2.f) };
+                memcpy(&corpus[0].rgba[i], gradient, 4);
+                float base{ 128.f + 100.f * height_at(static_cast<float>(x), static_cast<float>(y)) };
+                unsigned char detail[4]{ clamp(base + grain(rng)), clamp(0.8f * base + 30.f + grain(rng)), clamp(0.5f * base + grain(rng)), clamp(base) };
+                memcpy(&corpus[1].rgba[i], detail, 4);
+                bool cell{ ((x / 16) + (y / 16)) % 2 == 0 };
+                bool ring{ std::abs(std::hypot(x - size / 2.f, y - size / 2.f) - size / 3.f) < 6.f };
+                unsigned char edges[4]{ static_cast<unsigned char>(cell ? 230 : 20), static_cast<unsigned char>(ring ? 200 : 40),
+                    static_cast<unsigned char>(cell ? 60 : 180), static_cast<unsigned char>(ring ? 0 : 255) };
+                memcpy(&corpus[2].rgba[i], edges, 4);
+                // Central differences of the height field, packed as unsigned X and Y
+                float dx{ height_at(x + 1.f, y * 1.f) - height_at(x - 1.f, y * 1.f) };
+                float dy{ height_at(x * 1.f, y + 1.f) - height_at(x * 1.f, y - 1.f) };
+                float length{ std::sqrt(dx * dx + dy * dy + 0.04f) };
+                unsigned char normal[4]{ clamp(127.5f - 127.5f * dx / length), clamp(127.5f - 127.5f * dy / length),
+                    clamp(127.5f + 127.5f * 0.2f / length), 255 };
+                memcpy(&corpus[3].rgba[i], normal, 4);
+            }
+        }
+
+        const size_t max_threads{ std::max(1u, std::thread::hardware_concurrency()) };
+        JobSystem jobs{ max_threads };
+        const double megapixels{ static_cast<double>(size) * size * corpus.size() / 1e6 };
+        std::cout << "Block compression, " << corpus.size() << " images of " << size << "x" << size
+            << ", best SIMD level " << GetSimdLevelName(GetBestSimdLevel()) << ", GL_RENDERER: " << glGetString(GL_RENDERER) << std::endl;
+        std::vector<unsigned char> blocks, decoded(static_cast<size_t>(size) * size * 4), reference, readback(decoded.size());
+        for (BlockFormat format : { BlockFormat::kBC1, BlockFormat::kBC3, BlockFormat::kBC4, BlockFormat::kBC5 }) {
+            // Channels the format stores, which the PSNR is taken over
+            int channels{ format == BlockFormat::kBC1 ? 3 : format == BlockFormat::kBC3 ? 4 : format == BlockFormat::kBC4 ? 1 : 2 };
+            blocks.resize(GetCompressedSize(format, size, size));
+            std::cout << "    " << GetBlockFormatName(format) << ", " << blocks.size() / 1024. << " KB per image vs "
+                << size * size * 4 / 1024 << " KB RGBA8" << std::endl;
+            for (BlockQuality quality : { BlockQuality::kFast, BlockQuality::kQuality }) {
+                std::cout << "        " << (quality == BlockQuality::kFast ? "fast" : "quality") << ", PSNR";
+                for (const CorpusImage& image : corpus) {
+                    CompressImage(image.rgba.data(), size, size, format, quality, blocks.data());
+                    DecompressImage(blocks.data(), size, size, format, decoded.data());
+                    double squared_error{};
+                    for (size_t texel{}; texel < static_cast<size_t>(size) * size; ++texel) {
+                        for (int c{}; c < channels; ++c) {
+                            double d{ static_cast<double>(decoded[texel * 4 + c]) - image.rgba[texel * 4 + c] };
+                            squared_error += d * d;
+                        }
+                    }
+                    double mse{ squared_error / (static_cast<double>(size) * size * channels) };
+                    std::cout << " " << image.name << " " << (mse > 0. ? 10. * std::log10(255. * 255. / mse) : 99.) << " dB";
+                }
+                std::cout << std::endl;
+
+                // Every level must write the same blocks, so they only differ in speed
+                std::cout << "            ";
+                reference.clear();
+                for (SimdLevel level : { SimdLevel::kScalar, SimdLevel::kSse2, SimdLevel::kAvx2 }) {
+                    if (static_cast<int>(level) > static_cast<int>(GetBestSimdLevel())) {
+                        continue;
+                    }
+                    double ms{ TimeMedianMs([&] {
+                        for (const CorpusImage& image : corpus) {
+                            CompressImage(image.rgba.data(), size, size, format, quality, blocks.data(), nullptr, level);
+                        }
+                    }) };
+                    if (reference.empty()) {
+                        reference = blocks;
+                    }
+                    else if (blocks != reference) {
+                        std::cout << "ERROR [" << GetSimdLevelName(level) << " BLOCKS DIFFER FROM SCALAR]" << std::endl;
+                        result = 1;
+                    }
+                    std::cout << GetSimdLevelName(level) << " " << megapixels * 1000. / ms << " MP/s, ";
+                }
+                double threaded_ms{ TimeMedianMs([&] {
+                    for (const CorpusImage& image : corpus) {
+                        CompressImage(image.rgba.data(), size, size, format, quality, blocks.data(), &jobs);
+                    }
+                }) };
+                std::cout << max_threads << " threads " << megapixels * 1000. / threaded_ms << " MP/s" << std::endl;
+            }
+
+            // Direct upload: the driver must decode the blocks as DecompressImage does
+            if (!IsBlockFormatSupported(format)) {
+                std::cout << "        not supported by the GL driver, upload skipped" << std::endl;
+                continue;
+            }
+            const CorpusImage& image{ corpus[format == BlockFormat::kBC5 ? 3 : 1] };
+            CompressImage(image.rgba.data(), size, size, format, BlockQuality::kQuality, blocks.data(), &jobs);
+            DecompressImage(blocks.data(), size, size, format, decoded.data());
+            unsigned int texture;
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            double upload_ms{ TimeMedianMs([&] {
+                UploadCompressedImage(image.rgba.data(), size, size, 0, format, BlockQuality::kQuality, &jobs);
+                glFinish();
+            }) };
+            GLint uploaded_bytes{};
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &uploaded_bytes);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, readback.data());
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            int max_difference{};
+            for (size_t i{}; i < readback.size(); ++i) {
+                if (i % 4 < static_cast<size_t>(channels)) {
+                    max_difference = std::max(max_difference, std::abs(static_cast<int>(readback[i]) - decoded[i]));
+                }
+            }
+            glDeleteTextures(1, &texture);
+            std::cout << "        glCompressedTexImage2D of " << image.name << ": " << upload_ms << " ms with compression, "
+                << uploaded_bytes / 1024. << " KB on the GPU, driver decode differs by at most " << max_difference << std::endl;
+            if (uploaded_bytes != static_cast<GLint>(blocks.size()) || glGetError() != GL_NO_ERROR) {
+                std::cout << "ERROR [COMPRESSED UPLOAD OF " << GetBlockFormatName(format) << " FAILED]" << std::endl;
+                result = 1;
+            }
+        }
+    }
+    glfwTerminate();
+    return result;
+}
+
+int RunMipGenerationBenchmark(size_t) {
+    if (!CreateBenchmarkContext()) {
+        return 1;
+    }
+    int result{};
+    {
+        // Smooth color with per texel grain, in 8 and 16 bit channels
+        const int size{ kMipImageSize };
+        std::mt19937 rng{ 1234 };
+        std::uniform_int_distribution<int> grain{ -16, 16 };
+        std::vector<unsigned char> image(static_cast<size_t>(size) * size * 4);
+        std::vector<uint16_t> image16(image.size());
+        for (int y{}; y < size; ++y) {
+            for (int x{}; x < size; ++x) {
+                float base{ 128.f + 100.f * std::sin(x * 0.02f) * std::cos(y * 0.03f) };
+                for (int c{}; c < 4; ++c) {
+                    size_t i{ (static_cast<size_t>(y) * size + x) * 4 + c };
+                    image[i] = static_cast<unsigned char>(std::min(255.f, std::max(0.f, base * (1.f - 0.2f * c) + 40.f + grain(rng))));
+                    image16[i] = static_cast<uint16_t>(image[i] * 257 + grain(rng));
+                }
+            }
+        }
+        const size_t max_threads{ std::max(1u, std::thread::hardware_concurrency()) };
+        JobSystem jobs{ max_threads };
+        std::cout << "Mip chain of a " << size << "x" << size << " RGBA image, GL_RENDERER: " << glGetString(GL_RENDERER) << std::endl;
+
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        // What the streamer and TextureManager do without CPU mips: upload level 0, let the driver filter the rest
+        double base_upload_ms{ TimeMedianMs([&] {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+            glFinish();
+        }) };
+        double gl_ms{ TimeMedianMs([&] {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glFinish();
+        }) };
+        std::cout << "    glGenerateMipmap: " << gl_ms - base_upload_ms << " ms on the GL thread (" << gl_ms
+            << " ms with the level 0 upload)" << std::endl;
+
+        std::vector<std::vector<unsigned char>> chain;
+        for (MipFilter filter : { MipFilter::kBox, MipFilter::kKaiser, MipFilter::kLanczos }) {
+            for (bool srgb : { false, true }) {
+                MipOptions options;
+                options.filter = filter;
+                options.srgb = srgb;
+                std::cout << "    " << GetMipFilterName(filter) << (srgb ? ", sRGB: " : ", linear: ");
+                std::vector<std::vector<unsigned char>> reference;
+                double scalar_ms{};
+                for (SimdLevel level : { SimdLevel::kScalar, SimdLevel::kAvx2 }) {
+                    if (level == SimdLevel::kAvx2 && GetBestSimdLevel() != SimdLevel::kAvx2) {
+                        continue;
+                    }
+                    options.level = level;
+                    double ms{ TimeMedianMs([&] { chain = GenerateMipChain(image.data(), size, size, 4, 1, options); }) };
+                    if (level == SimdLevel::kScalar) {
+                        scalar_ms = ms;
+                        reference = chain;
+                    }
+                    else if (chain != reference) {
+                        std::cout << "ERROR [AVX2 MIPS DIFFER FROM SCALAR]" << std::endl;
+                        result = 1;
+                    }
+                    std::cout << GetSimdLevelName(level) << " " << ms << " ms (" << scalar_ms / ms << "x), ";
+                }
+                options.level = GetBestSimdLevel();
+                options.jobs = &jobs;
+                double threaded_ms{ TimeMedianMs([&] { chain = GenerateMipChain(image.data(), size, size, 4, 1, options); }) };
+                std::cout << max_threads << " threads " << threaded_ms << " ms" << std::endl;
+            }
+        }
+        // The GL thread's share with CPU mips: every level uploaded, nothing filtered
+        double chain_upload_ms{ TimeMedianMs([&] {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+            int width{ size };
+            for (size_t level{}; level < chain.size(); ++level) {
+                width = std::max(1, width / 2);
+                glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level + 1), GL_RGBA8, width, width, 0, GL_RGBA, GL_UNSIGNED_BYTE, chain[level].data());
+            }
+            glFinish();
+        }) };
+        std::cout << "    GL thread: " << chain_upload_ms << " ms uploading the CPU chain vs " << gl_ms
+            << " ms uploading level 0 + glGenerateMipmap" << std::endl;
+
+        std::cout << "    16 bit channels";
+        for (MipFilter filter : { MipFilter::kBox, MipFilter::kLanczos }) {
+            MipOptions options;
+            options.filter = filter;
+            options.srgb = true;
+            options.level = SimdLevel::kScalar;
+            double scalar_ms{ TimeMedianMs([&] { chain = GenerateMipChain(image16.data(), size, size, 4, 2, options); }) };
+            options.level = GetBestSimdLevel();
+            double simd_ms{ TimeMedianMs([&] { chain = GenerateMipChain(image16.data(), size, size, 4, 2, options); }) };
+            std::cout << (filter == MipFilter::kBox ? ": " : "; ") << GetMipFilterName(filter) << " sRGB scalar " << scalar_ms << " ms, "
+                << GetSimdLevelName(options.level) << " " << simd_ms << " ms (" << scalar_ms / simd_ms << "x)";
+        }
+        std::cout << std::endl;
+
+        // A black and white checkerboard looks 50% bright, which is sRGB 188; averaging the stored values gives 128
+        const int checker_size{ 256 };
+        std::vector<unsigned char> checker(static_cast<size_t>(checker_size) * checker_size * 4);
+        for (size_t i{}; i < checker.size(); ++i) {
+            size_t texel{ i / 4 };
+            bool white{ (texel % checker_size + texel / checker_size) % 2 == 1 };
+            checker[i] = static_cast<unsigned char>(i % 4 == 3 || white ? 255 : 0);
+        }
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, checker_size, checker_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, checker.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        std::vector<unsigned char> gl_level(checker.size() / 4);
+        glGetTexImage(GL_TEXTURE_2D, 1, GL_RGBA, GL_UNSIGNED_BYTE, gl_level.data());
+        MipOptions options;
+        std::vector<unsigned char> linear_level(gl_level.size()), srgb_level(gl_level.size());
+        GenerateMipLevel(checker.data(), checker_size, checker_size, 4, 1, options, linear_level.data());
+        options.srgb = true;
+        GenerateMipLevel(checker.data(), checker_size, checker_size, 4, 1, options, srgb_level.data());
+        std::cout << "    Checkerboard level 1: glGenerateMipmap " << static_cast<int>(gl_level[0]) << ", CPU box linear "
+            << static_cast<int>(linear_level[0]) << ", CPU box sRGB " << static_cast<int>(srgb_level[0]) << " (ideal 188)" << std::endl;
+        glDeleteTextures(1, &texture);
+    }
+    glfwTerminate();
+    return result;
+}
+
+// Hidden window whose core context of at least the given version is current on this thread; nullptr on failure
+GLFWwindow* CreateBenchmarkContext(int major, int minor) {
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window{ glfwCreateWindow(64, 64, "Benchmark", nullptr, nullptr) };
+    if (!window) {
+        std::cout << "ERROR [BENCHMARK GL CONTEXT CREATION FAILED]" << std::endl;
+        glfwTerminate();
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
+        std::cout << "ERROR [BENCHMARK GLAD INIT FAILED]" << std::endl;
+        glfwTerminate();
+        return nullptr;
+    }
+    return window;
+}
+
+// @return: median milliseconds of kBenchmarkRepeats calls of body, after one warm-up call
+template <typename Body>
+double TimeMedianMs(Body&& body) {
+    body();
+    std::vector<double> times(kBenchmarkRepeats);
+    for (double& time : times) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    std::nth_element(times.begin(), times.begin() + kBenchmarkRepeats / 2, times.end());
+    return times[kBenchmarkRepeats / 2];
+}
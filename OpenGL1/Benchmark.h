@@ -0,0 +1,17 @@
+/*
+CPU benchmarks for the renderer's hot loops, run with --bench <name> instead of opening a window
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstddef>
+
+// Objects processed per benchmark iteration when no count is given on the command line
+const size_t kDefaultBenchmarkCount{ 1000000 };
+
+// Run the named benchmark over object_count objects and print the results
+// @return: process exit code; non-zero for unknown names or failed result checks
+int RunBenchmark(const char* name, size_t object_count);
+
+#endif // !BENCHMARK_H
@@ -0,0 +1,674 @@
+/*
+BC1/BC3/BC4/BC5 block encoder and decoder
+*/
+
+#include "BlockCompression.h"
+#include "JobSystem.h"
+
+// Only for the internal format enums; nothing here calls GL
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// S3TC belongs to EXT_texture_compression_s3tc, which a core profile loader need not define
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Color channels of the 16 texels of a block, row-major, as floats for the index kernels
+// All values are whole numbers, so error sums stay exact in floats whatever the summation order
+struct ColorBlock {
+    alignas(32) float r[16];
+    alignas(32) float g[16];
+    alignas(32) float b[16];
+};
+
+// Pick the nearest of the 4 palette colors for each texel of block
+// @return: sum of squared errors over the block
+using ColorIndexKernel = int (*)(const ColorBlock& block, const float (&palette)[4][3], uint8_t* indices);
+// Sum of squared errors of 16 values against each of count 8 entry palettes, every value taking its nearest entry
+using AlphaErrorKernel = void (*)(const uint8_t* values, const uint8_t* palettes, int count, int* errors);
+
+// Kernels of one SimdLevel
+struct BlockKernels {
+    ColorIndexKernel color;
+    AlphaErrorKernel alpha;
+};
+
+// Scalar reference kernels
+static int SelectColorIndicesScalar(const ColorBlock& block, const float (&palette)[4][3], uint8_t* indices);
+static void ComputeAlphaErrorsScalar(const uint8_t* values, const uint8_t* palettes, int count, int* errors);
+#ifdef SIMD_SSE2
+// 4 texels, or one palette, per iteration
+static int SelectColorIndicesSse2(const ColorBlock& block, const float (&palette)[4][3], uint8_t* indices);
+static void ComputeAlphaErrorsSse2(const uint8_t* values, const uint8_t* palettes, int count, int* errors);
+#endif
+#ifdef SIMD_AVX2
+// 8 texels, or two palettes, per iteration
+SIMD_TARGET_AVX2 static int SelectColorIndicesAvx2(const ColorBlock& block, const float (&palette)[4][3], uint8_t* indices);
+SIMD_TARGET_AVX2 static void ComputeAlphaErrorsAvx2(const uint8_t* values, const uint8_t* palettes, int count, int* errors);
+#endif
+// @return: kernels of level, falling back to narrower ones the build lacks
+static BlockKernels GetBlockKernels(SimdLevel level);
+
+// Encode the 16 texels (RGBA) of one block in format
+static void EncodeBlock(const uint8_t (&texels)[16][4], BlockFormat format, BlockQuality quality, const BlockKernels& kernels, uint8_t* out);
+// BC1 color block: 565 endpoints c0 > c1 (4 color mode) and 2 bit indices
+static void EncodeColorBlock(const ColorBlock& block, BlockQuality quality, const BlockKernels& kernels, uint8_t* out);
+// Quantize the endpoints, pick indices and write the block to out; @return: sum of squared errors
+static int EncodeColorEndpoints(const ColorBlock& block, const float (&end0)[3], const float (&end1)[3],
+    const BlockKernels& kernels, uint8_t* out, uint8_t* indices);
+// BC4 block: 8 bit endpoints and 3 bit indices
+static void EncodeAlphaBlock(const uint8_t* values, BlockQuality quality, const BlockKernels& kernels, uint8_t* out);
+// Palette a BC4 block with endpoints r0, r1 decodes to: 8 interpolated entries if r0 > r1, else 6 and 0, 255
+static void MakeAlphaPalette(int r0, int r1, uint8_t* palette);
+// Palette of a BC1 block; four_color for c0 > c1 and always in BC3, else the 3 color + black mode
+static void MakeColorPalette(uint16_t c0, uint16_t c1, bool four_color, int (&palette)[4][3]);
+static uint16_t QuantizeColor565(const float (&rgb)[3]);
+static void ExpandColor565(uint16_t color, int (&rgb)[3]);
+// Decode a BC1 color block into the RGB of texels
+static void DecodeColorBlock(const uint8_t* block, bool four_color, uint8_t (&texels)[16][4]);
+// Decode a BC4 block into channel of texels
+static void DecodeAlphaBlock(const uint8_t* block, uint8_t (&texels)[16][4], int channel);
+
+// Block rows per compression job
+static const size_t kBlockRowsPerJob{ 2 };
+// Largest number of endpoint pairs the quality mode tries for a BC4 block
+static const int kMaxAlphaCandidates{ 32 };
+// Power iterations to find the principal axis of a block's colors
+static const int kPrincipalAxisIterations{ 8 };
+// Least squares endpoint refinements of the quality mode
+static const int kColorRefinements{ 2 };
+
+// @return: GL internal format of format, e.g. GL_COMPRESSED_RED_RGTC1 for BC4
+unsigned int GetBlockFormatGL(BlockFormat format) {
+    switch (format) {
+        case BlockFormat::kBC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::kBC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::kBC4: return GL_COMPRESSED_RED_RGTC1;
+        case BlockFormat::kBC5: return GL_COMPRESSED_RG_RGTC2;
+    }
+    return 0;
+}
+
+// @return: whether gl_format is the internal format of a BlockFormat, which is then stored in format
+bool FindBlockFormat(unsigned int gl_format, BlockFormat* format) {
+    for (BlockFormat candidate : { BlockFormat::kBC1, BlockFormat::kBC3, BlockFormat::kBC4, BlockFormat::kBC5 }) {
+        if (GetBlockFormatGL(candidate) == gl_format) {
+            *format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// @return: short name of format for reports
+const char* GetBlockFormatName(BlockFormat format) {
+    switch (format) {
+        case BlockFormat::kBC1: return "BC1";
+        case BlockFormat::kBC3: return "BC3";
+        case BlockFormat::kBC4: return "BC4";
+        case BlockFormat::kBC5: return "BC5";
+    }
+    return "unknown";
+}
+
+// @return: bytes of one 4x4 block
+size_t GetBlockBytes(BlockFormat format) {
+    return (format == BlockFormat::kBC1 || format == BlockFormat::kBC4) ? 8 : 16;
+}
+
+// @return: bytes of a width x height image in format; partial blocks at the edges count as whole
+size_t GetCompressedSize(BlockFormat format, int width, int height) {
+    return static_cast<size_t>((width + 3) / 4) * static_cast<size_t>((height + 3) / 4) * GetBlockBytes(format);
+}
+
+// Compress a width x height RGBA8 image with tightly packed rows into out (GetCompressedSize bytes)
+void CompressImage(const unsigned char* rgba, int width, int height, BlockFormat format, BlockQuality quality,
+    unsigned char* out, JobSystem* jobs, SimdLevel level) {
+    const int blocks_x{ (width + 3) / 4 };
+    const int blocks_y{ (height + 3) / 4 };
+    const size_t block_bytes{ GetBlockBytes(format) };
+    const BlockKernels kernels{ GetBlockKernels(level) };
+    auto compress_rows = [&](size_t begin, size_t end) {
+        uint8_t texels[16][4];
+        for (size_t block_y{ begin }; block_y < end; ++block_y) {
+            for (int block_x{}; block_x < blocks_x; ++block_x) {
+                // Texels past the edge repeat the last row and column, so they add no new colors
+                for (int i{}; i < 16; ++i) {
+                    int x{ std::min(block_x * 4 + i % 4, width - 1) };
+                    int y{ std::min(static_cast<int>(block_y) * 4 + i / 4, height - 1) };
+                    memcpy(texels[i], rgba + (static_cast<size_t>(y) * width + x) * 4, 4);
+                }
+                EncodeBlock(texels, format, quality, kernels, out + (block_y * blocks_x + block_x) * block_bytes);
+            }
+        }
+    };
+    if (jobs) {
+        jobs->ParallelFor(static_cast<size_t>(blocks_y), compress_rows, kBlockRowsPerJob);
+    }
+    else {
+        compress_rows(0, static_cast<size_t>(blocks_y));
+    }
+}
+
+// Decode blocks back to a width x height RGBA8 image, as a GPU would sample them
+void DecompressImage(const unsigned char* blocks, int width, int height, BlockFormat format, unsigned char* rgba) {
+    const int blocks_x{ (width + 3) / 4 };
+    const int blocks_y{ (height + 3) / 4 };
+    const size_t block_bytes{ GetBlockBytes(format) };
+    for (int block_y{}; block_y < blocks_y; ++block_y) {
+        for (int block_x{}; block_x < blocks_x; ++block_x) {
+            const uint8_t* block{ blocks + (static_cast<size_t>(block_y) * blocks_x + block_x) * block_bytes };
+            uint8_t texels[16][4]{};
+            for (auto& texel : texels) {
+                texel[3] = 255;
+            }
+            switch (format) {
+                case BlockFormat::kBC1: DecodeColorBlock(block, false, texels); break;
+                case BlockFormat::kBC3: DecodeAlphaBlock(block, texels, 3); DecodeColorBlock(block + 8, true, texels); break;
+                case BlockFormat::kBC4: DecodeAlphaBlock(block, texels, 0); break;
+                case BlockFormat::kBC5: DecodeAlphaBlock(block, texels, 0); DecodeAlphaBlock(block + 8, texels, 1); break;
+            }
+            for (int i{}; i < 16; ++i) {
+                int x{ block_x * 4 + i % 4 };
+                int y{ block_y * 4 + i / 4 };
+                if (x < width && y < height) {
+                    memcpy(rgba + (static_cast<size_t>(y) * width + x) * 4, texels[i], 4);
+                }
+            }
+        }
+    }
+}
+
+/* Non-member helper implementation */
+
+// @return: kernels of level, falling back to narrower ones the build lacks
+BlockKernels GetBlockKernels(SimdLevel level) {
+#ifdef SIMD_AVX2
+    if (level == SimdLevel::kAvx2) {
+        return BlockKernels{ SelectColorIndicesAvx2, ComputeAlphaErrorsAvx2 };
+    }
+#endif
+#ifdef SIMD_SSE2
+    if (level != SimdLevel::kScalar) {
+        return BlockKernels{ SelectColorIndicesSse2, ComputeAlphaErrorsSse2 };
+    }
+#endif
+    return BlockKernels{ SelectColorIndicesScalar, ComputeAlphaErrorsScalar };
+}
+
+// Encode the 16 texels (RGBA) of one block in format
+void EncodeBlock(const uint8_t (&texels)[16][4], BlockFormat format, BlockQuality quality, const BlockKernels& kernels, uint8_t* out) {
+    uint8_t values[16];
+    auto encode_channel = [&](int channel, uint8_t* block) {
+        for (int i{}; i < 16; ++i) {
+            values[i] = texels[i][channel];
+        }
+        EncodeAlphaBlock(values, quality, kernels, block);
+    };
+    auto encode_color = [&](uint8_t* block) {
+        ColorBlock colors;
+        for (int i{}; i < 16; ++i) {
+            colors.r[i] = texels[i][0];
+            colors.g[i] = texels[i][1];
+            colors.b[i] = texels[i][2];
+        }
+        EncodeColorBlock(colors, quality, kernels, block);
+    };
+    switch (format) {
+        case BlockFormat::kBC1: encode_color(out); break;
+        case BlockFormat::kBC3: encode_channel(3, out); encode_color(out + 8); break;
+        case BlockFormat::kBC4: encode_channel(0, out); break;
+        case BlockFormat::kBC5: encode_channel(0, out); encode_channel(1, out + 8); break;
+    }
+}
+
+// BC1 color block: 565 endpoints c0 > c1 (4 color mode) and 2 bit indices
+// Fast: the bounding box, inset by 1/16 against the outliers quantization makes of the corners, on the
+// diagonal the red/green and blue/green covariance points along. Quality: also the extent of the colors
+// along their principal axis, then least squares endpoints for the indices found, keeping whatever is best
+void EncodeColorBlock(const ColorBlock& block, BlockQuality quality, const BlockKernels& kernels, uint8_t* out) {
+    const float* channels[3]{ block.r, block.g, block.b };
+    float low[3]{ 255.f, 255.f, 255.f }, high[3]{}, mean[3]{};
+    for (int c{}; c < 3; ++c) {
+        for (int i{}; i < 16; ++i) {
+            low[c] = std::min(low[c], channels[c][i]);
+            high[c] = std::max(high[c], channels[c][i]);
+            mean[c] += channels[c][i];
+        }
+        mean[c] /= 16.f;
+    }
+    // Covariance, upper triangle: rr, rg, rb, gg, gb, bb
+    float covariance[6]{};
+    for (int i{}; i < 16; ++i) {
+        float d[3]{ block.r[i] - mean[0], block.g[i] - mean[1], block.b[i] - mean[2] };
+        covariance[0] += d[0] * d[0];
+        covariance[1] += d[0] * d[1];
+        covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1];
+        covariance[4] += d[1] * d[2];
+        covariance[5] += d[2] * d[2];
+    }
+
+    float end0[3], end1[3];
+    for (int c{}; c < 3; ++c) {
+        float inset{ (high[c] - low[c]) / 16.f };
+        end0[c] = high[c] - inset;
+        end1[c] = low[c] + inset;
+    }
+    if (covariance[1] < 0.f) {
+        std::swap(end0[0], end1[0]);
+    }
+    if (covariance[4] < 0.f) {
+        std::swap(end0[2], end1[2]);
+    }
+    uint8_t indices[16];
+    int best_error{ EncodeColorEndpoints(block, end0, end1, kernels, out, indices) };
+    if (quality == BlockQuality::kFast || best_error == 0) {
+        return;
+    }
+
+    // Power iteration from the covariance column with the largest variance
+    const float matrix[3][3]{
+        { covariance[0], covariance[1], covariance[2] },
+        { covariance[1], covariance[3], covariance[4] },
+        { covariance[2], covariance[4], covariance[5] } };
+    int largest{ covariance[0] >= covariance[3] ? (covariance[0] >= covariance[5] ? 0 : 2) : (covariance[3] >= covariance[5] ? 1 : 2) };
+    float axis[3]{ matrix[0][largest], matrix[1][largest], matrix[2][largest] };
+    for (int iteration{}; iteration < kPrincipalAxisIterations; ++iteration) {
+        float next[3];
+        for (int c{}; c < 3; ++c) {
+            next[c] = matrix[c][0] * axis[0] + matrix[c][1] * axis[1] + matrix[c][2] * axis[2];
+        }
+        float scale{ std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2]))) };
+        if (scale <= 0.f) {
+            break;
+        }
+        for (int c{}; c < 3; ++c) {
+            axis[c] = next[c] / scale;
+        }
+    }
+    float length2{ axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] };
+    if (length2 > 0.f) {
+        float t_min{}, t_max{};
+        for (int i{}; i < 16; ++i) {
+            float t{ ((block.r[i] - mean[0]) * axis[0] + (block.g[i] - mean[1]) * axis[1] + (block.b[i] - mean[2]) * axis[2]) / length2 };
+            t_min = std::min(t_min, t);
+            t_max = std::max(t_max, t);
+        }
+        for (int c{}; c < 3; ++c) {
+            end0[c] = std::min(255.f, std::max(0.f, mean[c] + t_max * axis[c]));
+            end1[c] = std::min(255.f, std::max(0.f, mean[c] + t_min * axis[c]));
+        }
+        uint8_t candidate[8], candidate_indices[16];
+        int error{ EncodeColorEndpoints(block, end0, end1, kernels, candidate, candidate_indices) };
+        if (error < best_error) {
+            best_error = error;
+            memcpy(out, candidate, sizeof(candidate));
+            memcpy(indices, candidate_indices, sizeof(indices));
+        }
+    }
+
+    // Texel i is (1 - t) * end0 + t * end1 for the t of its index; solve for the endpoints
+    const float kIndexWeights[4]{ 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+    for (int refinement{}; refinement < kColorRefinements && best_error > 0; ++refinement) {
+        float aa{}, ab{}, bb{}, ax[3]{}, bx[3]{};
+        for (int i{}; i < 16; ++i) {
+            float t{ kIndexWeights[indices[i]] };
+            aa += (1.f - t) * (1.f - t);
+            ab += (1.f - t) * t;
+            bb += t * t;
+            for (int c{}; c < 3; ++c) {
+                ax[c] += (1.f - t) * channels[c][i];
+                bx[c] += t * channels[c][i];
+            }
+        }
+        float determinant{ aa * bb - ab * ab };
+        if (std::fabs(determinant) < 1e-6f) {
+            break;
+        }
+        for (int c{}; c < 3; ++c) {
+            end0[c] = std::min(255.f, std::max(0.f, (bb * ax[c] - ab * bx[c]) / determinant));
+            end1[c] = std::min(255.f, std::max(0.f, (aa * bx[c] - ab * ax[c]) / determinant));
+        }
+        uint8_t candidate[8], candidate_indices[16];
+        int error{ EncodeColorEndpoints(block, end0, end1, kernels, candidate, candidate_indices) };
+        if (error >= best_error) {
+            break;
+        }
+        best_error = error;
+        memcpy(out, candidate, sizeof(candidate));
+        memcpy(indices, candidate_indices, sizeof(indices));
+    }
+}
+
+// Quantize the endpoints, pick indices and write the block to out; @return: sum of squared errors
+// Endpoints are ordered c0 > c1 for the 4 color mode; equal ones leave every index at c0
+int EncodeColorEndpoints(const ColorBlock& block, const float (&end0)[3], const float (&end1)[3],
+    const BlockKernels& kernels, uint8_t* out, uint8_t* indices) {
+    uint16_t c0{ QuantizeColor565(end0) };
+    uint16_t c1{ QuantizeColor565(end1) };
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    int palette[4][3];
+    MakeColorPalette(c0, c1, c0 != c1, palette);
+    float palette_f[4][3];
+    for (int k{}; k < 4; ++k) {
+        for (int c{}; c < 3; ++c) {
+            palette_f[k][c] = static_cast<float>(c0 != c1 ? palette[k][c] : palette[0][c]);
+        }
+    }
+    int error{ kernels.color(block, palette_f, indices) };
+    uint32_t bits{};
+    for (int i{}; i < 16; ++i) {
+        bits |= static_cast<uint32_t>(indices[i]) << (2 * i);
+    }
+    out[0] = static_cast<uint8_t>(c0);
+    out[1] = static_cast<uint8_t>(c0 >> 8);
+    out[2] = static_cast<uint8_t>(c1);
+    out[3] = static_cast<uint8_t>(c1 >> 8);
+    for (int i{}; i < 4; ++i) {
+        out[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    return error;
+}
+
+// BC4 block: 8 bit endpoints and 3 bit indices
+// Fast: the range of the values. Quality: endpoints a few steps inside and around the range in the
+// 8 entry mode, and around the range of the values other than 0 and 255 in the 6 entry mode
+void EncodeAlphaBlock(const uint8_t* values, BlockQuality quality, const BlockKernels& kernels, uint8_t* out) {
+    int low{ 255 }, high{}, inner_low{ 255 }, inner_high{};
+    for (int i{}; i < 16; ++i) {
+        low = std::min(low, static_cast<int>(values[i]));
+        high = std::max(high, static_cast<int>(values[i]));
+        if (values[i] != 0 && values[i] != 255) {
+            inner_low = std::min(inner_low, static_cast<int>(values[i]));
+            inner_high = std::max(inner_high, static_cast<int>(values[i]));
+        }
+    }
+    uint8_t endpoints[kMaxAlphaCandidates][2];
+    int count{};
+    auto add = [&](int r0, int r1) {
+        endpoints[count][0] = static_cast<uint8_t>(std::min(255, std::max(0, r0)));
+        endpoints[count][1] = static_cast<uint8_t>(std::min(255, std::max(0, r1)));
+        ++count;
+    };
+    add(high, low);
+    if (quality == BlockQuality::kQuality && high > low) {
+        for (int shrink_high{ -1 }; shrink_high <= 3; ++shrink_high) {
+            for (int shrink_low{ -1 }; shrink_low <= 3; ++shrink_low) {
+                if ((shrink_high != 0 || shrink_low != 0) && high - shrink_high > low + shrink_low) {
+                    add(high - shrink_high, low + shrink_low);
+                }
+            }
+        }
+        // r0 <= r1 selects the 6 entry mode
+        if (inner_low <= inner_high && (low == 0 || high == 255)) {
+            for (int shrink{}; shrink <= 1; ++shrink) {
+                add(inner_low + shrink, inner_high - shrink);
+                add(inner_low, inner_high - shrink);
+            }
+        }
+    }
+
+    uint8_t palettes[kMaxAlphaCandidates][8];
+    int errors[kMaxAlphaCandidates];
+    for (int candidate{}; candidate < count; ++candidate) {
+        MakeAlphaPalette(endpoints[candidate][0], endpoints[candidate][1], palettes[candidate]);
+    }
+    kernels.alpha(values, palettes[0], count, errors);
+    int best{ static_cast<int>(std::min_element(errors, errors + count) - errors) };
+
+    uint64_t bits{};
+    for (int i{}; i < 16; ++i) {
+        int best_index{}, best_distance{ 256 };
+        for (int k{}; k < 8; ++k) {
+            int distance{ std::abs(static_cast<int>(values[i]) - palettes[best][k]) };
+            if (distance < best_distance) {
+                best_distance = distance;
+                best_index = k;
+            }
+        }
+        bits |= static_cast<uint64_t>(best_index) << (3 * i);
+    }
+    out[0] = endpoints[best][0];
+    out[1] = endpoints[best][1];
+    for (int i{}; i < 6; ++i) {
+        out[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+// Palette a BC4 block with endpoints r0, r1 decodes to: 8 interpolated entries if r0 > r1, else 6 and 0, 255
+void MakeAlphaPalette(int r0, int r1, uint8_t* palette) {
+    palette[0] = static_cast<uint8_t>(r0);
+    palette[1] = static_cast<uint8_t>(r1);
+    if (r0 > r1) {
+        for (int i{ 1 }; i <= 6; ++i) {
+            palette[1 + i] = static_cast<uint8_t>(((7 - i) * r0 + i * r1 + 3) / 7);
+        }
+    }
+    else {
+        for (int i{ 1 }; i <= 4; ++i) {
+            palette[1 + i] = static_cast<uint8_t>(((5 - i) * r0 + i * r1 + 2) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// Palette of a BC1 block; four_color for c0 > c1 and always in BC3, else the 3 color + black mode
+void MakeColorPalette(uint16_t c0, uint16_t c1, bool four_color, int (&palette)[4][3]) {
+    ExpandColor565(c0, palette[0]);
+    ExpandColor565(c1, palette[1]);
+    for (int c{}; c < 3; ++c) {
+        if (four_color) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+        }
+        else {
+            palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+            palette[3][c] = 0;
+        }
+    }
+}
+
+uint16_t QuantizeColor565(const float (&rgb)[3]) {
+    int r{ static_cast<int>(rgb[0] * (31.f / 255.f) + 0.5f) };
+    int g{ static_cast<int>(rgb[1] * (63.f / 255.f) + 0.5f) };
+    int b{ static_cast<int>(rgb[2] * (31.f / 255.f) + 0.5f) };
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void ExpandColor565(uint16_t color, int (&rgb)[3]) {
+    int r{ (color >> 11) & 31 }, g{ (color >> 5) & 63 }, b{ color & 31 };
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Decode a BC1 color block into the RGB of texels
+void DecodeColorBlock(const uint8_t* block, bool four_color, uint8_t (&texels)[16][4]) {
+    uint16_t c0{ static_cast<uint16_t>(block[0] | (block[1] << 8)) };
+    uint16_t c1{ static_cast<uint16_t>(block[2] | (block[3] << 8)) };
+    int palette[4][3];
+    MakeColorPalette(c0, c1, four_color || c0 > c1, palette);
+    uint32_t bits{ static_cast<uint32_t>(block[4]) | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24) };
+    for (int i{}; i < 16; ++i) {
+        const int* color{ palette[(bits >> (2 * i)) & 3] };
+        for (int c{}; c < 3; ++c) {
+            texels[i][c] = static_cast<uint8_t>(color[c]);
+        }
+    }
+}
+
+// Decode a BC4 block into channel of texels
+void DecodeAlphaBlock(const uint8_t* block, uint8_t (&texels)[16][4], int channel) {
+    uint8_t palette[8];
+    MakeAlphaPalette(block[0], block[1], palette);
+    uint64_t bits{};
+    for (int i{}; i < 6; ++i) {
+        bits |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+    }
+    for (int i{}; i < 16; ++i) {
+        texels[i][channel] = palette[(bits >> (3 * i)) & 7];
+    }
+}
+
+// Ties go to the lower index, as in the SIMD kernels
+int SelectColorIndicesScalar(const ColorBlock& block, const float (&palette)[4][3], uint8_t* indices) {
+    float error{};
+    for (int i{}; i < 16; ++i) {
+        float best{};
+        for (int k{}; k < 4; ++k) {
+            float dr{ block.r[i] - palette[k][0] }, dg{ block.g[i] - palette[k][1] }, db{ block.b[i] - palette[k][2] };
+            float distance{ dr * dr + dg * dg + db * db };
+            if (k == 0 || distance < best) {
+                best = distance;
+                indices[i] = static_cast<uint8_t>(k);
+            }
+        }
+        error += best;
+    }
+    return static_cast<int>(error);
+}
+
+void ComputeAlphaErrorsScalar(const uint8_t* values, const uint8_t* palettes, int count, int* errors) {
+    for (int candidate{}; candidate < count; ++candidate) {
+        const uint8_t* palette{ palettes + candidate * 8 };
+        int error{};
+        for (int i{}; i < 16; ++i) {
+            int best{ 255 };
+            for (int k{}; k < 8; ++k) {
+                best = std::min(best, std::abs(static_cast<int>(values[i]) - palette[k]));
+            }
+            error += best * best;
+        }
+        errors[candidate] = error;
+    }
+}
+
+#ifdef SIMD_SSE2
+int SelectColorIndicesSse2(const ColorBlock& block, const float (&palette)[4][3], uint8_t* indices) {
+    __m128 total{ _mm_setzero_ps() };
+    for (int i{}; i < 16; i += 4) {
+        __m128 r{ _mm_load_ps(block.r + i) }, g{ _mm_load_ps(block.g + i) }, b{ _mm_load_ps(block.b + i) };
+        __m128 best{};
+        __m128i index{ _mm_setzero_si128() };
+        for (int k{}; k < 4; ++k) {
+            __m128 dr{ _mm_sub_ps(r, _mm_set1_ps(palette[k][0])) };
+            __m128 dg{ _mm_sub_ps(g, _mm_set1_ps(palette[k][1])) };
+            __m128 db{ _mm_sub_ps(b, _mm_set1_ps(palette[k][2])) };
+            __m128 distance{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db)) };
+            if (k == 0) {
+                best = distance;
+                continue;
+            }
+            __m128i closer{ _mm_castps_si128(_mm_cmplt_ps(distance, best)) };
+            best = _mm_min_ps(distance, best);
+            index = _mm_or_si128(_mm_andnot_si128(closer, index), _mm_and_si128(closer, _mm_set1_epi32(k)));
+        }
+        total = _mm_add_ps(total, best);
+        // Indices are 0-3, so the low byte of each lane holds them
+        index = _mm_packs_epi32(index, index);
+        index = _mm_packus_epi16(index, index);
+        int packed{ _mm_cvtsi128_si32(index) };
+        memcpy(indices + i, &packed, 4);
+    }
+    total = _mm_add_ps(total, _mm_movehl_ps(total, total));
+    total = _mm_add_ss(total, _mm_shuffle_ps(total, total, _MM_SHUFFLE(1, 1, 1, 1)));
+    return static_cast<int>(_mm_cvtss_f32(total));
+}
+
+// @return: sum of squared errors of the 16 values against one 8 entry palette
+static inline int ComputeAlphaErrorSse2(__m128i values, const uint8_t* palette) {
+    __m128i best{ _mm_set1_epi8(-1) };
+    for (int k{}; k < 8; ++k) {
+        __m128i entry{ _mm_set1_epi8(static_cast<char>(palette[k])) };
+        // |a - b| of unsigned bytes: one of the saturating differences is 0
+        __m128i distance{ _mm_or_si128(_mm_subs_epu8(values, entry), _mm_subs_epu8(entry, values)) };
+        best = _mm_min_epu8(best, distance);
+    }
+    __m128i zero{ _mm_setzero_si128() };
+    __m128i low{ _mm_unpacklo_epi8(best, zero) }, high{ _mm_unpackhi_epi8(best, zero) };
+    __m128i sum{ _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)) };
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+void ComputeAlphaErrorsSse2(const uint8_t* values, const uint8_t* palettes, int count, int* errors) {
+    __m128i row{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(values)) };
+    for (int candidate{}; candidate < count; ++candidate) {
+        errors[candidate] = ComputeAlphaErrorSse2(row, palettes + candidate * 8);
+    }
+}
+#endif // SIMD_SSE2
+
+#ifdef SIMD_AVX2
+SIMD_TARGET_AVX2 int SelectColorIndicesAvx2(const ColorBlock& block, const float (&palette)[4][3], uint8_t* indices) {
+    __m256 total{ _mm256_setzero_ps() };
+    for (int i{}; i < 16; i += 8) {
+        __m256 r{ _mm256_load_ps(block.r + i) }, g{ _mm256_load_ps(block.g + i) }, b{ _mm256_load_ps(block.b + i) };
+        __m256 best{};
+        __m256i index{ _mm256_setzero_si256() };
+        for (int k{}; k < 4; ++k) {
+            __m256 dr{ _mm256_sub_ps(r, _mm256_set1_ps(palette[k][0])) };
+            __m256 dg{ _mm256_sub_ps(g, _mm256_set1_ps(palette[k][1])) };
+            __m256 db{ _mm256_sub_ps(b, _mm256_set1_ps(palette[k][2])) };
+            __m256 distance{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dr, dr), _mm256_mul_ps(dg, dg)), _mm256_mul_ps(db, db)) };
+            if (k == 0) {
+                best = distance;
+                continue;
+            }
+            __m256 closer{ _mm256_cmp_ps(distance, best, _CMP_LT_OQ) };
+            best = _mm256_min_ps(distance, best);
+            index = _mm256_blendv_epi8(index, _mm256_set1_epi32(k), _mm256_castps_si256(closer));
+        }
+        total = _mm256_add_ps(total, best);
+        // Gather the low byte of each lane into the first 8 bytes
+        __m128i packed{ _mm_packs_epi32(_mm256_castsi256_si128(index), _mm256_extracti128_si256(index, 1)) };
+        packed = _mm_packus_epi16(packed, packed);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(indices + i), packed);
+    }
+    __m128 sum{ _mm_add_ps(_mm256_castps256_ps128(total), _mm256_extractf128_ps(total, 1)) };
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+    return static_cast<int>(_mm_cvtss_f32(sum));
+}
+
+// Two palettes at once, one per 128 bit lane; an odd last one goes through the SSE2 kernel
+SIMD_TARGET_AVX2 void ComputeAlphaErrorsAvx2(const uint8_t* values, const uint8_t* palettes, int count, int* errors) {
+    __m128i row{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(values)) };
+    __m256i rows{ _mm256_broadcastsi128_si256(row) };
+    __m256i zero{ _mm256_setzero_si256() };
+    int candidate{};
+    for (; candidate + 2 <= count; candidate += 2) {
+        const uint8_t* first{ palettes + candidate * 8 };
+        const uint8_t* second{ first + 8 };
+        __m256i best{ _mm256_set1_epi8(-1) };
+        for (int k{}; k < 8; ++k) {
+            __m256i entry{ _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi8(static_cast<char>(first[k]))),
+                _mm_set1_epi8(static_cast<char>(second[k])), 1) };
+            __m256i distance{ _mm256_or_si256(_mm256_subs_epu8(rows, entry), _mm256_subs_epu8(entry, rows)) };
+            best = _mm256_min_epu8(best, distance);
+        }
+        __m256i low{ _mm256_unpacklo_epi8(best, zero) }, high{ _mm256_unpackhi_epi8(best, zero) };
+        __m256i sum{ _mm256_add_epi32(_mm256_madd_epi16(low, low), _mm256_madd_epi16(high, high)) };
+        sum = _mm256_add_epi32(sum, _mm256_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm256_add_epi32(sum, _mm256_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        errors[candidate] = _mm_cvtsi128_si32(_mm256_castsi256_si128(sum));
+        errors[candidate + 1] = _mm_cvtsi128_si32(_mm256_extracti128_si256(sum, 1));
+    }
+    if (candidate < count) {
+        errors[candidate] = ComputeAlphaErrorSse2(row, palettes + candidate * 8);
+    }
+}
+#endif // SIMD_AVX2
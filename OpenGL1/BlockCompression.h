@@ -0,0 +1,53 @@
+/*
+CPU encoder for the 4x4 block compressed texture formats GL can sample directly:
+    BC1 (S3TC DXT1): RGB, 8 bytes per block, 1/6 of RGB8 and 1/8 of RGBA8
+    BC3 (S3TC DXT5): RGBA, a BC4 style alpha block + a BC1 color block, 16 bytes per block
+    BC4 (RGTC1): one channel (red), 8 bytes per block
+    BC5 (RGTC2): two channels (red, green), two BC4 blocks, e.g. for normal maps
+RGTC is core since GL 3.0; S3TC needs EXT_texture_compression_s3tc (IsBlockFormatSupported in
+TextureUpload.h, which also holds the GL side of uploading; this file makes no GL calls).
+
+Every block picks its endpoints and then the palette index of each of its 16 texels. The fast
+mode takes the endpoints from the bounding box of the texels; the quality mode fits them along
+the principal axis, refines them by least squares and searches the neighbouring endpoints. Index
+selection, which dominates both, has SSE2 and AVX2 kernels chosen like the culling kernels, and
+rows of blocks are spread over a JobSystem when one is given.
+*/
+
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include "Simd.h"
+
+#include <cstddef>
+
+class JobSystem;
+
+enum class BlockFormat { kBC1, kBC3, kBC4, kBC5 };
+
+// How hard the encoder searches for endpoints
+enum class BlockQuality {
+    kFast,   // bounding box endpoints, one index pass
+    kQuality // principal axis + least squares refinement for colors, endpoint search for BC4 blocks
+};
+
+// @return: GL internal format of format, e.g. GL_COMPRESSED_RED_RGTC1 for BC4
+unsigned int GetBlockFormatGL(BlockFormat format);
+// @return: whether gl_format is the internal format of a BlockFormat, which is then stored in format
+bool FindBlockFormat(unsigned int gl_format, BlockFormat* format);
+// @return: short name of format for reports
+const char* GetBlockFormatName(BlockFormat format);
+// @return: bytes of one 4x4 block
+size_t GetBlockBytes(BlockFormat format);
+// @return: bytes of a width x height image in format; partial blocks at the edges count as whole
+size_t GetCompressedSize(BlockFormat format, int width, int height);
+
+// Compress a width x height RGBA8 image with tightly packed rows into out (GetCompressedSize bytes)
+// BC1 ignores alpha, BC4 reads red, BC5 red and green. Edge blocks repeat the last row and column
+void CompressImage(const unsigned char* rgba, int width, int height, BlockFormat format, BlockQuality quality,
+    unsigned char* out, JobSystem* jobs = nullptr, SimdLevel level = GetBestSimdLevel());
+// Decode blocks back to a width x height RGBA8 image, as a GPU would sample them
+// Channels a format does not store come back as 0 (green, blue) and 255 (alpha)
+void DecompressImage(const unsigned char* blocks, int width, int height, BlockFormat format, unsigned char* rgba);
+
+#endif // !BLOCK_COMPRESSION_H
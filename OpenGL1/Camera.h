@@ -61,6 +61,8 @@ public:
 
     // @return: field of view in degrees
     double GetZoom() const { return fov_; }
+    // @return: camera position in world space
+    glm::vec3 GetPosition() const { return camera_pos_; }
     // @return: view matrix based on mouse input
     glm::mat4 GetViewTransform() const;
     
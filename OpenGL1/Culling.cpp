@@ -0,0 +1,380 @@
+/*
+Batch frustum culling over structure-of-arrays bounding volumes
+*/
+
+#include "Culling.h"
+#include "JobSystem.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+
+// Kernel function pointers for CullRange, or nullptr where the build has no such kernel
+#ifdef SIMD_SSE2
+#define CULLING_SSE2_KERNEL(kernel) kernel
+#else
+#define CULLING_SSE2_KERNEL(kernel) nullptr
+#endif
+#ifdef SIMD_AVX2
+#define CULLING_AVX2_KERNEL(kernel) kernel
+#else
+#define CULLING_AVX2_KERNEL(kernel) nullptr
+#endif
+
+// Scalar reference kernels; also handle the tail the SIMD kernels leave over
+// @return: number of indices in [begin, end) written to out
+static size_t CullSpheresScalar(const Frustum& frustum, const BoundingSpheres& spheres, size_t begin, size_t end, uint32_t* out);
+static size_t CullBoxesScalar(const Frustum& frustum, const BoundingBoxes& boxes, size_t begin, size_t end, uint32_t* out);
+
+#ifdef SIMD_SSE2
+// 4 objects per iteration over [begin, end), end - begin a multiple of 4
+static size_t CullSpheresSse2(const Frustum& frustum, const BoundingSpheres& spheres, size_t begin, size_t end, uint32_t* out);
+static size_t CullBoxesSse2(const Frustum& frustum, const BoundingBoxes& boxes, size_t begin, size_t end, uint32_t* out);
+#endif
+#ifdef SIMD_AVX2
+// 8 objects per iteration over [begin, end), end - begin a multiple of 8
+SIMD_TARGET_AVX2 static size_t CullSpheresAvx2(const Frustum& frustum, const BoundingSpheres& spheres, size_t begin, size_t end, uint32_t* out);
+SIMD_TARGET_AVX2 static size_t CullBoxesAvx2(const Frustum& frustum, const BoundingBoxes& boxes, size_t begin, size_t end, uint32_t* out);
+#endif
+// Culls [begin, end) and writes the visible indices to out; @return: number written
+template <typename Volumes>
+using CullKernel = size_t (*)(const Frustum& frustum, const Volumes& volumes, size_t begin, size_t end, uint32_t* out);
+// Cull [begin, end) with the kernels of level, the SIMD part first and the tail scalar
+// The SIMD kernels store a full vector of indices per iteration, but never past out + (end - begin)
+template <typename Volumes>
+static size_t CullRange(const Frustum& frustum, const Volumes& volumes, size_t begin, size_t end, uint32_t* out,
+    SimdLevel level, CullKernel<Volumes> scalar, CullKernel<Volumes> sse2, CullKernel<Volumes> avx2);
+// Split the volumes into jobs that cull in place, then pack the results together
+template <typename Range>
+static size_t CullParallel(size_t count, std::vector<uint32_t>& visible, JobSystem& jobs, Range range);
+
+// Objects per culling job; a multiple of 8 so every job but the last runs whole SIMD iterations
+static const size_t kCullJobSize{ 8192 };
+
+/* BoundingSpheres / BoundingBoxes implementation */
+
+void BoundingSpheres::Add(const glm::vec3& center, float r) {
+    x.push_back(center.x);
+    y.push_back(center.y);
+    z.push_back(center.z);
+    radius.push_back(r);
+}
+
+void BoundingSpheres::Clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+}
+
+void BoundingBoxes::Add(const glm::vec3& min, const glm::vec3& max) {
+    glm::vec3 center{ (min + max) * 0.5f };
+    glm::vec3 extent{ (max - min) * 0.5f };
+    center_x.push_back(center.x);
+    center_y.push_back(center.y);
+    center_z.push_back(center.z);
+    extent_x.push_back(extent.x);
+    extent_y.push_back(extent.y);
+    extent_z.push_back(extent.z);
+}
+
+void BoundingBoxes::Clear() {
+    center_x.clear();
+    center_y.clear();
+    center_z.clear();
+    extent_x.clear();
+    extent_y.clear();
+    extent_z.clear();
+}
+
+/* Culling entry points */
+
+// Write the indices of the spheres intersecting the frustum to visible, in ascending order
+size_t CullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible, SimdLevel level) {
+    visible.resize(spheres.Size());
+    visible.resize(CullRange<BoundingSpheres>(frustum, spheres, 0, spheres.Size(), visible.data(), level,
+        CullSpheresScalar, CULLING_SSE2_KERNEL(CullSpheresSse2), CULLING_AVX2_KERNEL(CullSpheresAvx2)));
+    return visible.size();
+}
+
+// Write the indices of the boxes intersecting the frustum to visible, in ascending order
+size_t CullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& visible, SimdLevel level) {
+    visible.resize(boxes.Size());
+    visible.resize(CullRange<BoundingBoxes>(frustum, boxes, 0, boxes.Size(), visible.data(), level,
+        CullBoxesScalar, CULLING_SSE2_KERNEL(CullBoxesSse2), CULLING_AVX2_KERNEL(CullBoxesAvx2)));
+    return visible.size();
+}
+
+// Same, with the work split across jobs
+size_t CullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible, JobSystem& jobs) {
+    SimdLevel level{ GetBestSimdLevel() };
+    return CullParallel(spheres.Size(), visible, jobs, [&](size_t begin, size_t end, uint32_t* out) {
+        return CullRange<BoundingSpheres>(frustum, spheres, begin, end, out, level,
+            CullSpheresScalar, CULLING_SSE2_KERNEL(CullSpheresSse2), CULLING_AVX2_KERNEL(CullSpheresAvx2));
+    });
+}
+
+size_t CullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& visible, JobSystem& jobs) {
+    SimdLevel level{ GetBestSimdLevel() };
+    return CullParallel(boxes.Size(), visible, jobs, [&](size_t begin, size_t end, uint32_t* out) {
+        return CullRange<BoundingBoxes>(frustum, boxes, begin, end, out, level,
+            CullBoxesScalar, CULLING_SSE2_KERNEL(CullBoxesSse2), CULLING_AVX2_KERNEL(CullBoxesAvx2));
+    });
+}
+
+/* Non-member helper implementation */
+
+// Cull [begin, end) with the kernels of level, the SIMD part first and the tail scalar
+template <typename Volumes>
+size_t CullRange(const Frustum& frustum, const Volumes& volumes, size_t begin, size_t end, uint32_t* out,
+    SimdLevel level, CullKernel<Volumes> scalar, CullKernel<Volumes> sse2, CullKernel<Volumes> avx2) {
+    size_t written{};
+    size_t done{ begin };
+    if (level == SimdLevel::kAvx2 && avx2) {
+        done = begin + ((end - begin) & ~size_t{ 7 });
+        written = avx2(frustum, volumes, begin, done, out);
+    }
+    else if (level == SimdLevel::kSse2 && sse2) {
+        done = begin + ((end - begin) & ~size_t{ 3 });
+        written = sse2(frustum, volumes, begin, done, out);
+    }
+    return written + scalar(frustum, volumes, done, end, out + written);
+}
+
+// Split the volumes into jobs that cull in place, then pack the results together
+template <typename Range>
+size_t CullParallel(size_t count, std::vector<uint32_t>& visible, JobSystem& jobs, Range range) {
+    visible.resize(count);
+    size_t job_count{ (count + kCullJobSize - 1) / kCullJobSize };
+    // Every job writes its survivors to the front of its own slice of visible
+    std::vector<size_t> job_visible(job_count);
+    jobs.ParallelFor(job_count, [&](size_t first_job, size_t last_job) {
+        for (size_t job{ first_job }; job < last_job; ++job) {
+            size_t begin{ job * kCullJobSize };
+            size_t end{ std::min(count, begin + kCullJobSize) };
+            job_visible[job] = range(begin, end, visible.data() + begin);
+        }
+    }, 1);
+
+    size_t written{};
+    for (size_t job{}; job < job_count; ++job) {
+        memmove(visible.data() + written, visible.data() + job * kCullJobSize, job_visible[job] * sizeof(uint32_t));
+        written += job_visible[job];
+    }
+    visible.resize(written);
+    return written;
+}
+
+// Sphere is outside if it is entirely behind any plane: dot(n, c) + w < -r
+size_t CullSpheresScalar(const Frustum& frustum, const BoundingSpheres& spheres, size_t begin, size_t end, uint32_t* out) {
+    size_t written{};
+    for (size_t i{ begin }; i < end; ++i) {
+        bool inside{ true };
+        for (const glm::vec4& plane : frustum.planes) {
+            float d{ plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w };
+            inside = inside && d >= -spheres.radius[i];
+        }
+        out[written] = static_cast<uint32_t>(i);
+        written += inside;
+    }
+    return written;
+}
+
+// Box is outside if its most positive corner along the plane normal is behind the plane:
+// dot(n, c) + w + dot(|n|, e) < 0
+size_t CullBoxesScalar(const Frustum& frustum, const BoundingBoxes& boxes, size_t begin, size_t end, uint32_t* out) {
+    size_t written{};
+    for (size_t i{ begin }; i < end; ++i) {
+        bool inside{ true };
+        for (const glm::vec4& plane : frustum.planes) {
+            float d{ plane.x * boxes.center_x[i] + plane.y * boxes.center_y[i] + plane.z * boxes.center_z[i] + plane.w };
+            float r{ std::fabs(plane.x) * boxes.extent_x[i] + std::fabs(plane.y) * boxes.extent_y[i] + std::fabs(plane.z) * boxes.extent_z[i] };
+            inside = inside && d + r >= 0.f;
+        }
+        out[written] = static_cast<uint32_t>(i);
+        written += inside;
+    }
+    return written;
+}
+
+#ifdef SIMD_SSE2
+// Lane indices of the set bits of each 4 bit mask, packed to the front
+alignas(16) static const std::array<std::array<int32_t, 4>, 16> kCompact4{ [] {
+    std::array<std::array<int32_t, 4>, 16> table{};
+    for (int mask{}; mask < 16; ++mask) {
+        int n{};
+        for (int lane{}; lane < 4; ++lane) {
+            if (mask & (1 << lane)) { table[mask][n++] = lane; }
+        }
+    }
+    return table;
+}() };
+
+size_t CullSpheresSse2(const Frustum& frustum, const BoundingSpheres& spheres, size_t begin, size_t end, uint32_t* out) {
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p{}; p < 6; ++p) {
+        px[p] = _mm_set1_ps(frustum.planes[p].x);
+        py[p] = _mm_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+    const __m128 zero{ _mm_setzero_ps() };
+
+    size_t written{};
+    for (size_t i{ begin }; i < end; i += 4) {
+        __m128 x{ _mm_loadu_ps(&spheres.x[i]) };
+        __m128 y{ _mm_loadu_ps(&spheres.y[i]) };
+        __m128 z{ _mm_loadu_ps(&spheres.z[i]) };
+        __m128 neg_r{ _mm_sub_ps(zero, _mm_loadu_ps(&spheres.radius[i])) };
+
+        __m128 inside{ _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+        for (int p{}; p < 6; ++p) {
+            __m128 d{ _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)), _mm_mul_ps(pz[p], z)), pw[p]) };
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, neg_r));
+        }
+
+        int mask{ _mm_movemask_ps(inside) };
+        __m128i lanes{ _mm_load_si128(reinterpret_cast<const __m128i*>(kCompact4[mask].data())) };
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), _mm_add_epi32(lanes, _mm_set1_epi32(static_cast<int>(i))));
+        written += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+    }
+    return written;
+}
+
+size_t CullBoxesSse2(const Frustum& frustum, const BoundingBoxes& boxes, size_t begin, size_t end, uint32_t* out) {
+    __m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+    for (int p{}; p < 6; ++p) {
+        px[p] = _mm_set1_ps(frustum.planes[p].x);
+        py[p] = _mm_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm_set1_ps(frustum.planes[p].w);
+        ax[p] = _mm_set1_ps(std::fabs(frustum.planes[p].x));
+        ay[p] = _mm_set1_ps(std::fabs(frustum.planes[p].y));
+        az[p] = _mm_set1_ps(std::fabs(frustum.planes[p].z));
+    }
+    const __m128 zero{ _mm_setzero_ps() };
+
+    size_t written{};
+    for (size_t i{ begin }; i < end; i += 4) {
+        __m128 cx{ _mm_loadu_ps(&boxes.center_x[i]) };
+        __m128 cy{ _mm_loadu_ps(&boxes.center_y[i]) };
+        __m128 cz{ _mm_loadu_ps(&boxes.center_z[i]) };
+        __m128 ex{ _mm_loadu_ps(&boxes.extent_x[i]) };
+        __m128 ey{ _mm_loadu_ps(&boxes.extent_y[i]) };
+        __m128 ez{ _mm_loadu_ps(&boxes.extent_z[i]) };
+
+        __m128 inside{ _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+        for (int p{}; p < 6; ++p) {
+            __m128 d{ _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)), _mm_mul_ps(pz[p], cz)), pw[p]) };
+            __m128 r{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez)) };
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+        }
+
+        int mask{ _mm_movemask_ps(inside) };
+        __m128i lanes{ _mm_load_si128(reinterpret_cast<const __m128i*>(kCompact4[mask].data())) };
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), _mm_add_epi32(lanes, _mm_set1_epi32(static_cast<int>(i))));
+        written += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+    }
+    return written;
+}
+#endif // SIMD_SSE2
+
+#ifdef SIMD_AVX2
+// Lane indices of the set bits of each 8 bit mask, one per byte, packed to the front; and the bit counts
+static const std::array<uint64_t, 256> kCompact8{ [] {
+    std::array<uint64_t, 256> table{};
+    for (int mask{}; mask < 256; ++mask) {
+        int n{};
+        for (int lane{}; lane < 8; ++lane) {
+            if (mask & (1 << lane)) { table[mask] |= uint64_t(lane) << (8 * n++); }
+        }
+    }
+    return table;
+}() };
+static const std::array<uint8_t, 256> kPopCount8{ [] {
+    std::array<uint8_t, 256> table{};
+    for (int mask{}; mask < 256; ++mask) {
+        for (int bits{ mask }; bits; bits &= bits - 1) { ++table[mask]; }
+    }
+    return table;
+}() };
+
+// Expand the packed lane bytes of mask and store base + lane for all 8 lanes
+SIMD_TARGET_AVX2 static inline void StoreCompact8(int mask, size_t base, uint32_t* out) {
+    __m256i lanes{ _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&kCompact8[mask]))) };
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(base))));
+}
+
+SIMD_TARGET_AVX2 size_t CullSpheresAvx2(const Frustum& frustum, const BoundingSpheres& spheres, size_t begin, size_t end, uint32_t* out) {
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (int p{}; p < 6; ++p) {
+        px[p] = _mm256_set1_ps(frustum.planes[p].x);
+        py[p] = _mm256_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+    const __m256 zero{ _mm256_setzero_ps() };
+
+    size_t written{};
+    for (size_t i{ begin }; i < end; i += 8) {
+        __m256 x{ _mm256_loadu_ps(&spheres.x[i]) };
+        __m256 y{ _mm256_loadu_ps(&spheres.y[i]) };
+        __m256 z{ _mm256_loadu_ps(&spheres.z[i]) };
+        __m256 neg_r{ _mm256_sub_ps(zero, _mm256_loadu_ps(&spheres.radius[i])) };
+
+        __m256 inside{ _mm256_castsi256_ps(_mm256_set1_epi32(-1)) };
+        for (int p{}; p < 6; ++p) {
+            __m256 d{ _mm256_fmadd_ps(px[p], x, _mm256_fmadd_ps(py[p], y, _mm256_fmadd_ps(pz[p], z, pw[p]))) };
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, neg_r, _CMP_GE_OQ));
+            // Stop once all 8 lanes are outside, which spatially ordered objects do in whole blocks
+            if (_mm256_testz_ps(inside, inside)) {
+                break;
+            }
+        }
+
+        int mask{ _mm256_movemask_ps(inside) };
+        StoreCompact8(mask, i, out + written);
+        written += kPopCount8[mask];
+    }
+    return written;
+}
+
+SIMD_TARGET_AVX2 size_t CullBoxesAvx2(const Frustum& frustum, const BoundingBoxes& boxes, size_t begin, size_t end, uint32_t* out) {
+    __m256 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+    for (int p{}; p < 6; ++p) {
+        px[p] = _mm256_set1_ps(frustum.planes[p].x);
+        py[p] = _mm256_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+        ax[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].x));
+        ay[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].y));
+        az[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].z));
+    }
+    const __m256 zero{ _mm256_setzero_ps() };
+
+    size_t written{};
+    for (size_t i{ begin }; i < end; i += 8) {
+        __m256 cx{ _mm256_loadu_ps(&boxes.center_x[i]) };
+        __m256 cy{ _mm256_loadu_ps(&boxes.center_y[i]) };
+        __m256 cz{ _mm256_loadu_ps(&boxes.center_z[i]) };
+        __m256 ex{ _mm256_loadu_ps(&boxes.extent_x[i]) };
+        __m256 ey{ _mm256_loadu_ps(&boxes.extent_y[i]) };
+        __m256 ez{ _mm256_loadu_ps(&boxes.extent_z[i]) };
+
+        __m256 inside{ _mm256_castsi256_ps(_mm256_set1_epi32(-1)) };
+        for (int p{}; p < 6; ++p) {
+            __m256 d{ _mm256_fmadd_ps(px[p], cx, _mm256_fmadd_ps(py[p], cy, _mm256_fmadd_ps(pz[p], cz, pw[p]))) };
+            __m256 r{ _mm256_fmadd_ps(ax[p], ex, _mm256_fmadd_ps(ay[p], ey, _mm256_mul_ps(az[p], ez))) };
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+            if (_mm256_testz_ps(inside, inside)) {
+                break;
+            }
+        }
+
+        int mask{ _mm256_movemask_ps(inside) };
+        StoreCompact8(mask, i, out + written);
+        written += kPopCount8[mask];
+    }
+    return written;
+}
+#endif // SIMD_AVX2
@@ -0,0 +1,156 @@
+/*
+Per-draw records indexed by draw ID
+*/
+
+#include "DrawData.h"
+#include "GLState.h"
+#include "StreamBuffer.h"
+#include "VertexLayout.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+// @return: greatest common divisor of a and b
+static size_t GreatestCommonDivisor(size_t a, size_t b);
+
+/* DrawDataBlock implementation */
+
+// Needs a current GL context
+DrawDataBlock::DrawDataBlock() : id_buffer_{}, capacity_{}, range_size_{}, alignment_{}, source_{ DrawIdSource::kVertexAttrib }, range_count_{} {
+    if (GLAD_GL_ARB_shader_draw_parameters) {
+        source_ = DrawIdSource::kDrawParameters;
+    }
+    else if (GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_base_instance) {
+        source_ = DrawIdSource::kBaseInstance;
+    }
+
+    // Ranges start where the previous one ends, so each must be a whole number of alignment units
+    int max_block_size{}, alignment{};
+    glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &max_block_size);
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment_ = static_cast<size_t>(std::max(alignment, 1));
+    size_t step{ alignment_ / GreatestCommonDivisor(sizeof(DrawRecord), alignment_) };
+    capacity_ = std::max(step, static_cast<size_t>(max_block_size) / sizeof(DrawRecord) / step * step);
+    range_size_ = capacity_ * sizeof(DrawRecord);
+
+    counts_.resize(capacity_);
+    index_offsets_.assign(capacity_, nullptr);
+
+    std::vector<unsigned int> ids(capacity_);
+    for (size_t i{}; i < ids.size(); ++i) {
+        ids[i] = static_cast<unsigned int>(i);
+    }
+    glGenBuffers(1, &id_buffer_);
+    GLState::GetInstance().BindBuffer(GL_ARRAY_BUFFER, id_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(unsigned int), ids.data(), GL_STATIC_DRAW);
+}
+
+DrawDataBlock::~DrawDataBlock() {
+    glDeleteBuffers(1, &id_buffer_);
+}
+
+// @return: defines the vertex shader needs to declare the block and read the draw ID
+std::vector<std::string> DrawDataBlock::GetDefines() const {
+    std::vector<std::string> defines{ "DRAW_RECORD_COUNT " + std::to_string(capacity_) };
+    if (source_ == DrawIdSource::kDrawParameters) {
+        defines.push_back("DRAW_ID_BUILTIN");
+    }
+    return defines;
+}
+
+// Set up the draw ID attribute of the bound VAO
+// Integer attribute, so glVertexAttribIPointer rather than VertexLayout's float path
+void DrawDataBlock::SetupVertexArray() const {
+    GLState::GetInstance().BindBuffer(GL_ARRAY_BUFFER, id_buffer_);
+    glVertexAttribIPointer(kDrawIdAttrib, 1, GL_UNSIGNED_INT, sizeof(unsigned int), nullptr);
+    glVertexAttribDivisor(kDrawIdAttrib, 1);
+    if (source_ == DrawIdSource::kBaseInstance) {
+        glEnableVertexAttribArray(kDrawIdAttrib);
+    }
+    else {
+        // Disabled arrays read the current value, which kVertexAttrib sets per draw
+        glDisableVertexAttribArray(kDrawIdAttrib);
+    }
+}
+
+// @return: stream bytes a frame of count records takes, for sizing the stream buffer
+// Includes the padding StreamBuffer may insert to align the first range's buffer offset
+size_t DrawDataBlock::GetStreamBytes(size_t count) const {
+    return GetRangeBytes(count) + alignment_ - 1;
+}
+
+// Reserve count records in stream; the last range is padded to a full block
+// A bound range must be at least as large as the block, even if the last draws only read part of it
+DrawRecord* DrawDataBlock::Allocate(StreamBuffer& stream, size_t count, size_t* offset) {
+    if (count == 0) {
+        return nullptr;
+    }
+    // The first range starts at an aligned buffer offset and range_size_ is a multiple of the
+    // alignment, so every range Draw binds is aligned too
+    return static_cast<DrawRecord*>(stream.Allocate(GetRangeBytes(count), alignment_, offset));
+}
+
+// @return: bytes of the whole ranges count records fill
+size_t DrawDataBlock::GetRangeBytes(size_t count) const {
+    size_t ranges{ (count + capacity_ - 1) / capacity_ };
+    return ranges * range_size_;
+}
+
+// Draw count indexed draws of index_count indices from the bound VAO; draw i reads record i at offset
+size_t DrawDataBlock::Draw(const StreamBuffer& stream, size_t offset, size_t count, int index_count) {
+    GLState& gl_state{ GLState::GetInstance() };
+    size_t draw_calls{};
+    range_count_ = 0;
+    for (size_t first{}; first < count; first += capacity_) {
+        size_t range_draws{ std::min(capacity_, count - first) };
+        gl_state.BindBufferRange(GL_UNIFORM_BUFFER, kDrawDataBinding, stream.GetId(),
+            static_cast<ptrdiff_t>(offset + first * sizeof(DrawRecord)), static_cast<ptrdiff_t>(range_size_));
+        ++range_count_;
+
+        switch (source_) {
+        case DrawIdSource::kDrawParameters:
+            // gl_DrawIDARB counts the draws of one multi-draw from 0
+            std::fill(counts_.begin(), counts_.begin() + range_draws, index_count);
+            glMultiDrawElements(GL_TRIANGLES, counts_.data(), GL_UNSIGNED_INT, index_offsets_.data(), static_cast<GLsizei>(range_draws));
+            ++draw_calls;
+            break;
+        case DrawIdSource::kBaseInstance:
+            for (size_t i{}; i < range_draws; ++i) {
+                glDrawElementsInstancedBaseInstance(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, nullptr, 1, static_cast<GLuint>(i));
+            }
+            draw_calls += range_draws;
+            break;
+        case DrawIdSource::kVertexAttrib:
+            for (size_t i{}; i < range_draws; ++i) {
+                glVertexAttribI1ui(kDrawIdAttrib, static_cast<GLuint>(i));
+                glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, nullptr);
+            }
+            draw_calls += range_draws;
+            break;
+        }
+    }
+    return draw_calls;
+}
+
+// @return: short name of a draw ID source for the stats output
+const char* GetDrawIdSourceName(DrawIdSource source) {
+    switch (source) {
+    case DrawIdSource::kDrawParameters: return "gl_DrawIDARB + glMultiDrawElements";
+    case DrawIdSource::kBaseInstance: return "id attribute + base instance";
+    case DrawIdSource::kVertexAttrib: return "id attribute value per draw";
+    }
+    return "unknown";
+}
+
+/* Non-member helper implementation */
+
+// @return: greatest common divisor of a and b
+size_t GreatestCommonDivisor(size_t a, size_t b) {
+    while (b != 0) {
+        size_t remainder{ a % b };
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
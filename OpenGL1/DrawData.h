@@ -0,0 +1,95 @@
+/*
+Per-draw records (model matrix + material) for many objects, written into one uniform buffer
+range per batch instead of uploaded with one glUniform call per draw.
+Layout mirrors the std140 DrawData block in draw_data.glsl, which vertex shaders include first.
+
+Each draw finds its record through a draw ID, taken from the best source the driver has:
+    gl_DrawIDARB (ARB_shader_draw_parameters): a whole batch is one glMultiDrawElements
+    base instance (GL 4.2 / ARB_base_instance): an attribute with divisor 1 reads entry
+        baseinstance of a static 0..N-1 buffer; one glDrawElementsInstancedBaseInstance per draw
+    otherwise: the same attribute with its array disabled; its current value is set before each
+        draw with glVertexAttribI1ui, which is vertex state and not a program uniform
+A uniform block holds at most GL_MAX_UNIFORM_BLOCK_SIZE bytes (16 KB or more), so the records
+are split into ranges of GetCapacity() records, each bound with glBindBufferRange before its draws.
+*/
+
+#ifndef DRAW_DATA_H
+#define DRAW_DATA_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class StreamBuffer;
+
+// Uniform buffer binding point the DrawData block is attached to; FrameData has 0
+const unsigned int kDrawDataBinding{ 1 };
+// Name of the block, for Shader::HasUniformBlock and Shader::BindUniformBlock; constexpr so it can be hashed at compile time
+constexpr const char* kDrawDataBlockName{ "DrawData" };
+
+// std140: an array of structs has each element padded to 16 bytes, which these already are
+struct DrawRecord {
+    glm::mat4 model;
+    // rgb: tint, a: how much texture2 shows through
+    glm::vec4 material;
+};
+
+static_assert(sizeof(DrawRecord) == 64 + 16, "DrawRecord must match the std140 block layout");
+
+// Where the vertex shader takes the index of its record from
+enum class DrawIdSource {
+    kDrawParameters, // gl_DrawIDARB of a glMultiDrawElements
+    kBaseInstance,   // id attribute with divisor 1, offset by the draw's base instance
+    kVertexAttrib    // id attribute's current value, set per draw
+};
+
+class DrawDataBlock {
+    // 0..capacity_-1, read through kDrawIdAttrib in the base instance mode
+    unsigned int id_buffer_;
+    // Records per bound range; ranges follow each other, so range_size_ is a multiple of the UBO offset alignment
+    size_t capacity_;
+    size_t range_size_;
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    size_t alignment_;
+    DrawIdSource source_;
+    // glMultiDrawElements arguments for a full range, all draws of the same index count
+    std::vector<int> counts_;
+    std::vector<const void*> index_offsets_;
+    // Ranges bound by the last Draw
+    size_t range_count_;
+
+    // @return: bytes of the whole ranges count records fill
+    size_t GetRangeBytes(size_t count) const;
+public:
+    // Needs a current GL context
+    DrawDataBlock();
+    ~DrawDataBlock();
+    DrawDataBlock(const DrawDataBlock&) = delete;
+    DrawDataBlock& operator=(const DrawDataBlock&) = delete;
+
+    // @return: defines the vertex shader needs to declare the block and read the draw ID
+    std::vector<std::string> GetDefines() const;
+    // Set up the draw ID attribute of the bound VAO; the VAO must not be used for other instanced draws
+    void SetupVertexArray() const;
+
+    // @return: stream bytes a frame of count records takes, alignment padding included, for sizing the stream buffer
+    size_t GetStreamBytes(size_t count) const;
+    // Reserve count records in stream; the last range is padded to a full block
+    // @return: CPU write pointer, or nullptr if the region is full; *offset receives the buffer offset
+    DrawRecord* Allocate(StreamBuffer& stream, size_t count, size_t* offset);
+    // Draw count indexed draws of index_count indices from the bound VAO; draw i reads record i at offset
+    // Records must have been flushed; the program must have the block bound to kDrawDataBinding
+    // @return: number of GL draw calls issued
+    size_t Draw(const StreamBuffer& stream, size_t offset, size_t count, int index_count);
+
+    size_t GetCapacity() const { return capacity_; }
+    DrawIdSource GetSource() const { return source_; }
+    size_t GetRangeCount() const { return range_count_; }
+};
+
+// @return: short name of a draw ID source for the stats output
+const char* GetDrawIdSourceName(DrawIdSource source);
+
+#endif // !DRAW_DATA_H
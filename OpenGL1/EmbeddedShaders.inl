@@ -0,0 +1,187 @@
+// Generated by embed_shaders.py from the shader sources next to it; do not edit
+// Sorted by path, so ShaderSources can binary search it
+static const EmbeddedShader kEmbeddedShaders[]{
+    { "cull.comp", 2343,
+        "#version 430 core\n"
+        "// GPU-driven culling: tests every object's bounding sphere against the frustum, animates the\n"
+        "// survivors and appends their model matrices to the instance buffer of their mesh.\n"
+        "// The instance count of each mesh's indirect draw command is bumped atomically, so the\n"
+        "// command buffer is ready for glMultiDrawElementsIndirect without a CPU round trip\n"
+        "layout (local_size_x = 64) in;\n"
+        "\n"
+        "#include \"frame_data.glsl\"\n"
+        "\n"
+        "// Same layout as CullObject in GpuCuller.h\n"
+        "struct CullObject {\n"
+        "    vec4 position_radius; // xyz: world position, w: bounding sphere radius\n"
+        "    vec4 axis_speed;      // xyz: spin axis, w: angular speed in radians per second\n"
+        "    uint mesh;            // index into the command buffer\n"
+        "    uint pad0, pad1, pad2;\n"
+        "};\n"
+        "\n"
+        "// Same layout as DrawElementsIndirectCommand in GpuCuller.h\n"
+        "struct DrawCommand {\n"
+        "    uint count;\n"
+        "    uint instance_count;\n"
+        "    uint first_index;\n"
+        "    int base_vertex;\n"
+        "    uint base_instance;\n"
+        "};\n"
+        "\n"
+        "layout (std430, binding = 0) readonly buffer Objects { CullObject objects[]; };\n"
+        "layout (std430, binding = 1) writeonly buffer Instances { mat4 instances[]; };\n"
+        "layout (std430, binding = 2) buffer Commands { DrawCommand commands[]; };\n"
+        "\n"
+        "uniform int object_count;\n"
+        "\n"
+        "// Rotation of angle radians around axis, as glm::rotate builds it\n"
+        "mat4 AxisAngle(vec3 axis, float angle) {\n"
+        "    vec3 a = normalize(axis);\n"
+        "    float c = cos(angle);\n"
+        "    float s = sin(angle);\n"
+        "    vec3 t = (1.0 - c) * a;\n"
+        "    return mat4(\n"
+        "        vec4(c + t.x * a.x, t.x * a.y + s * a.z, t.x * a.z - s * a.y, 0.0),\n"
+        "        vec4(t.y * a.x - s * a.z, c + t.y * a.y, t.y * a.z + s * a.x, 0.0),\n"
+        "        vec4(t.z * a.x + s * a.y, t.z * a.y - s * a.x, c + t.z * a.z, 0.0),\n"
+        "        vec4(0.0, 0.0, 0.0, 1.0));\n"
+        "}\n"
+        "\n"
+        "void main() {\n"
+        "    uint id = gl_GlobalInvocationID.x;\n"
+        "    if (id >= uint(object_count)) {\n"
+        "        return;\n"
+        "    }\n"
+        "    CullObject object = objects[id];\n"
+        "    vec3 center = object.position_radius.xyz;\n"
+        "    float radius = object.position_radius.w;\n"
+        "\n"
+        "    for (int i = 0; i < 6; ++i) {\n"
+        "        if (dot(frustum_planes[i].xyz, center) + frustum_planes[i].w < -radius) {\n"
+        "            return;\n"
+        "        }\n"
+        "    }\n"
+        "\n"
+        "    mat4 model = AxisAngle(object.axis_speed.xyz, time * object.axis_speed.w);\n"
+        "    model[3] = vec4(center, 1.0);\n"
+        "\n"
+        "    uint slot = atomicAdd(commands[object.mesh].instance_count, 1u);\n"
+        "    instances[commands[object.mesh].base_instance + slot] = model;\n"
+        "}\n" },
+    { "draw_data.glsl", 784,
+        "#pragma once\n"
+        "// Per-draw records, same layout as DrawData.h; include before any declaration, as it may enable an extension\n"
+        "// DrawDataBlock::GetDefines supplies DRAW_RECORD_COUNT, and DRAW_ID_BUILTIN if the driver has gl_DrawIDARB\n"
+        "#ifndef DRAW_RECORD_COUNT\n"
+        "#define DRAW_RECORD_COUNT 204 // 16 KB, the smallest GL_MAX_UNIFORM_BLOCK_SIZE\n"
+        "#endif\n"
+        "\n"
+        "// DRAW_ID: index of this draw's record\n"
+        "#ifdef DRAW_ID_BUILTIN\n"
+        "#extension GL_ARB_shader_draw_parameters : require\n"
+        "#define DRAW_ID gl_DrawIDARB\n"
+        "#else\n"
+        "layout (location = 7) in uint a_draw_id; // kDrawIdAttrib\n"
+        "#define DRAW_ID int(a_draw_id)\n"
+        "#endif\n"
+        "\n"
+        "struct DrawRecord {\n"
+        "    mat4 model;\n"
+        "    vec4 material; // rgb: tint, a: how much texture2 shows through\n"
+        "};\n"
+        "\n"
+        "layout (std140) uniform DrawData {\n"
+        "    DrawRecord draw_records[DRAW_RECORD_COUNT];\n"
+        "};\n" },
+    { "fallback.frag", 200,
+        "#version 330 core\n"
+        "out vec4 frag_color;\n"
+        "\n"
+        "// Drawn with shader0.vert while the real fragment shader is still compiling; flat grey, no textures\n"
+        "void main() {\n"
+        "    frag_color = vec4(0.6, 0.6, 0.6, 1.0);\n"
+        "}\n" },
+    { "frame_data.glsl", 248,
+        "#pragma once\n"
+        "// Filled once per frame and shared by every program; same layout as FrameData.h\n"
+        "layout (std140) uniform FrameData {\n"
+        "    mat4 view;\n"
+        "    mat4 proj;\n"
+        "    mat4 view_proj;\n"
+        "    vec4 camera_pos;\n"
+        "    vec4 frustum_planes[6];\n"
+        "    float time;\n"
+        "};\n" },
+    { "shader0.frag", 774,
+        "#version 330 core\n"
+        "out vec4 frag_color;\n"
+        "\n"
+        "in vec2 tex_coord; // texture coordinates\n"
+        "#ifdef DRAW_DATA\n"
+        "flat in vec4 material; // This draw's record from the DrawData block; rgb: tint, a: texture2 mix\n"
+        "#endif\n"
+        "\n"
+        "//fragment shader is the one that actually sets pixels to corresponding color from texture\n"
+        "uniform sampler2D texture1;\n"
+        "uniform sampler2D texture2;\n"
+        "\n"
+        "// How much of texture2 shows through; a compile-time constant, override with a define\n"
+        "#ifndef FACE_MIX\n"
+        "#define FACE_MIX 0.2\n"
+        "#endif\n"
+        "\n"
+        "void main() {\n"
+        "#ifdef DRAW_DATA\n"
+        "    vec4 color = mix(texture(texture1, tex_coord), texture(texture2, tex_coord), material.a);\n"
+        "    frag_color = vec4(color.rgb * material.rgb, color.a);\n"
+        "#else\n"
+        "    frag_color = mix(texture(texture1, tex_coord), texture(texture2, tex_coord), FACE_MIX);\n"
+        "#endif\n"
+        "}" },
+    { "shader0.vert", 1598,
+        "#version 330 core\n"
+        "#ifdef DRAW_DATA\n"
+        "#include \"draw_data.glsl\"\n"
+        "#endif\n"
+        "layout (location = 0) in vec3 a_pos; // position var has attr position 0; may be quantized to [-1, 1]\n"
+        "layout (location = 1) in vec2 a_tex_coord; // texture coordinates in pos 1\n"
+        "layout (location = 2) in mat4 a_model; // per-instance model matrix; takes up locations 2-5\n"
+        "\n"
+        "out vec2 tex_coord; // Pipe texture coordinates to fragment shader\n"
+        "#ifdef DRAW_DATA\n"
+        "flat out vec4 material; // Per-draw material for the fragment shader\n"
+        "#endif\n"
+        "\n"
+        "#include \"frame_data.glsl\"\n"
+        "\n"
+        "// Variant defines (see ShaderVariantCache):\n"
+        "// INSTANCED: take the model matrix from a_model instead of the uniform\n"
+        "// QUANTIZED_POSITIONS: a_pos is normalized and needs position_scale/position_bias\n"
+        "// DRAW_DATA: take the model matrix and material from this draw's record in the DrawData block\n"
+        "#if !defined(INSTANCED) && !defined(DRAW_DATA)\n"
+        "uniform mat4 model;\n"
+        "#endif\n"
+        "#ifdef QUANTIZED_POSITIONS\n"
+        "// Undo position quantization: local position = a_pos * position_scale + position_bias\n"
+        "uniform vec3 position_scale;\n"
+        "uniform vec3 position_bias;\n"
+        "#endif\n"
+        "\n"
+        "void main() {\n"
+        "#if defined(INSTANCED)\n"
+        "    mat4 model_transform = a_model;\n"
+        "#elif defined(DRAW_DATA)\n"
+        "    mat4 model_transform = draw_records[DRAW_ID].model;\n"
+        "    material = draw_records[DRAW_ID].material;\n"
+        "#else\n"
+        "    mat4 model_transform = model;\n"
+        "#endif\n"
+        "#ifdef QUANTIZED_POSITIONS\n"
+        "    vec3 local_pos = a_pos * position_scale + position_bias;\n"
+        "#else\n"
+        "    vec3 local_pos = a_pos;\n"
+        "#endif\n"
+        "    gl_Position = view_proj * model_transform * vec4(local_pos, 1.0); // transform closest to vector is applied first\n"
+        "\ttex_coord = a_tex_coord;\n"
+        "}\n" },
+};
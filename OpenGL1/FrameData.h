@@ -0,0 +1,31 @@
+/*
+Per-frame values shared by every shader program through one uniform buffer.
+Layout mirrors the std140 FrameData block in frame_data.glsl, which every shader includes
+*/
+
+#ifndef FRAME_DATA_H
+#define FRAME_DATA_H
+
+#include <glm/glm.hpp>
+
+// Uniform buffer binding point the FrameData block is attached to in every program
+const unsigned int kFrameDataBinding{ 0 };
+
+// std140: mat4 and vec4 members are 16 byte aligned and the block size is padded to 16 bytes,
+// so every member here is either a full vec4 or packed into one
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::mat4 view_proj;
+    // xyz: camera world position, w: unused
+    glm::vec4 camera_pos;
+    // World space frustum planes (left, right, bottom, top, near, far), see Frustum.h
+    glm::vec4 frustum_planes[6];
+    // seconds since glfwInit
+    float time;
+    float padding[3];
+};
+
+static_assert(sizeof(FrameData) == 3 * 64 + 16 + 6 * 16 + 16, "FrameData must match the std140 block layout");
+
+#endif // !FRAME_DATA_H
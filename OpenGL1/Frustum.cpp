@@ -0,0 +1,39 @@
+/*
+View frustum planes extracted from a view-projection matrix
+*/
+
+#include "Frustum.h"
+
+// @return: true if the sphere is at least partially inside every plane
+bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& plane : planes) {
+        if (glm::dot(glm::vec3{ plane }, center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// @return: world space frustum of the view-projection matrix
+// Each plane is the 4th row of the matrix plus or minus one of the other rows. glm is column-major,
+// so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+Frustum ExtractFrustum(const glm::mat4& view_proj) {
+    auto row = [&view_proj](int i) {
+        return glm::vec4{ view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i] };
+    };
+    glm::vec4 x{ row(0) }, y{ row(1) }, z{ row(2) }, w{ row(3) };
+
+    Frustum frustum;
+    frustum.planes[0] = w + x; // left
+    frustum.planes[1] = w - x; // right
+    frustum.planes[2] = w + y; // bottom
+    frustum.planes[3] = w - y; // top
+    frustum.planes[4] = w + z; // near (GL clip space z in [-w, w])
+    frustum.planes[5] = w - z; // far
+
+    // Normalize so plane distances are in world units and sphere radii can be compared directly
+    for (glm::vec4& plane : frustum.planes) {
+        plane = plane / glm::length(glm::vec3{ plane });
+    }
+    return frustum;
+}
@@ -0,0 +1,23 @@
+/*
+View frustum planes extracted from a view-projection matrix
+(Gribb & Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix")
+*/
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+struct Frustum {
+    // left, right, bottom, top, near, far; xyz = inward normal (normalized), w = distance
+    // A point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+    glm::vec4 planes[6];
+
+    // @return: true if the sphere is at least partially inside every plane
+    bool IntersectsSphere(const glm::vec3& center, float radius) const;
+};
+
+// @return: world space frustum of the view-projection matrix
+Frustum ExtractFrustum(const glm::mat4& view_proj);
+
+#endif // !FRUSTUM_H
@@ -0,0 +1,207 @@
+/*
+Shadow copy of the GL binding state so redundant binds never reach the driver
+*/
+
+#include "GLState.h"
+
+#include <glad/glad.h>
+
+// @return: shadow slot of a GL target, or -1 for targets that are not tracked
+static int TextureSlotOf(unsigned int target);
+static int BufferSlotOf(unsigned int target);
+static int CapSlotOf(unsigned int cap);
+
+/* GLState implementation */
+
+GLState::GLState() : counters_{}, uniform_counters_{} {
+    Invalidate();
+}
+
+// @return: Singleton GLState reference
+GLState& GLState::GetInstance() {
+    static GLState s;
+    return s;
+}
+
+// @return: true and counts the call if it must be issued; false and counts a skip otherwise
+bool GLState::Change(unsigned int& shadow, unsigned int value) {
+    if (shadow == value) {
+        ++counters_.skipped;
+        return false;
+    }
+    shadow = value;
+    ++counters_.issued;
+    return true;
+}
+
+void GLState::UseProgram(unsigned int program) {
+    if (Change(program_, program)) {
+        glUseProgram(program);
+    }
+}
+
+void GLState::BindVertexArray(unsigned int vao) {
+    if (Change(vertex_array_, vao)) {
+        glBindVertexArray(vao);
+        // The element array binding is part of the VAO, so it is whatever the new VAO recorded
+        buffers_[kElementArrayBuffer] = kUnknown;
+    }
+}
+
+// unit: GL_TEXTURE0 + n
+void GLState::ActiveTexture(unsigned int unit) {
+    if (Change(active_texture_, unit)) {
+        glActiveTexture(unit);
+    }
+}
+
+// Bind to the currently active unit
+void GLState::BindTexture(unsigned int target, unsigned int texture) {
+    int slot{ TextureSlotOf(target) };
+    unsigned int unit_index{ active_texture_ - GL_TEXTURE0 };
+    if (slot < 0 || active_texture_ == kUnknown || unit_index >= static_cast<unsigned int>(kMaxTrackedTextureUnits)) {
+        ++counters_.issued;
+        glBindTexture(target, texture);
+        return;
+    }
+    if (Change(textures_[unit_index][slot], texture)) {
+        glBindTexture(target, texture);
+    }
+}
+
+// Select unit (GL_TEXTURE0 + n) and bind there; skips both calls if already bound
+void GLState::BindTextureUnit(unsigned int unit, unsigned int target, unsigned int texture) {
+    int slot{ TextureSlotOf(target) };
+    unsigned int unit_index{ unit - GL_TEXTURE0 };
+    if (slot >= 0 && unit_index < static_cast<unsigned int>(kMaxTrackedTextureUnits) && textures_[unit_index][slot] == texture) {
+        // Already bound; no need to even switch the active unit
+        ++counters_.skipped;
+        return;
+    }
+    ActiveTexture(unit);
+    BindTexture(target, texture);
+}
+
+// Select unit and bind there, always leaving unit active so glTex* calls that follow edit texture
+void GLState::BindTextureForEdit(unsigned int unit, unsigned int target, unsigned int texture) {
+    ActiveTexture(unit);
+    BindTexture(target, texture);
+}
+
+void GLState::BindBuffer(unsigned int target, unsigned int buffer) {
+    int slot{ BufferSlotOf(target) };
+    if (slot < 0) {
+        ++counters_.issued;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (Change(buffers_[slot], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+// Indexed bindings are not shadowed, but they also change the generic binding of target
+void GLState::BindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, ptrdiff_t offset, ptrdiff_t size) {
+    ++counters_.issued;
+    glBindBufferRange(target, index, buffer, offset, size);
+    int slot{ BufferSlotOf(target) };
+    if (slot >= 0) {
+        buffers_[slot] = buffer;
+    }
+}
+
+void GLState::Enable(unsigned int cap) {
+    int slot{ CapSlotOf(cap) };
+    if (slot < 0) {
+        ++counters_.issued;
+        glEnable(cap);
+        return;
+    }
+    if (Change(caps_[slot], 1)) {
+        glEnable(cap);
+    }
+}
+
+void GLState::Disable(unsigned int cap) {
+    int slot{ CapSlotOf(cap) };
+    if (slot < 0) {
+        ++counters_.issued;
+        glDisable(cap);
+        return;
+    }
+    if (Change(caps_[slot], 0)) {
+        glDisable(cap);
+    }
+}
+
+// GL silently unbinds deleted objects; call these after deleting so the shadow matches
+void GLState::OnProgramDeleted(unsigned int program) {
+    // A deleted program stays in use until another one is installed, so only forget it
+    if (program_ == program) { program_ = kUnknown; }
+}
+void GLState::OnVertexArrayDeleted(unsigned int vao) {
+    if (vertex_array_ == vao) {
+        vertex_array_ = 0;
+        buffers_[kElementArrayBuffer] = kUnknown;
+    }
+}
+void GLState::OnTextureDeleted(unsigned int texture) {
+    for (auto& unit : textures_) {
+        for (unsigned int& bound : unit) {
+            if (bound == texture) { bound = 0; }
+        }
+    }
+}
+void GLState::OnBufferDeleted(unsigned int buffer) {
+    for (unsigned int& bound : buffers_) {
+        if (bound == buffer) { bound = 0; }
+    }
+}
+
+// Forget everything; the next bind of each kind is always issued
+void GLState::Invalidate() {
+    program_ = kUnknown;
+    vertex_array_ = kUnknown;
+    active_texture_ = kUnknown;
+    for (auto& unit : textures_) {
+        for (unsigned int& bound : unit) { bound = kUnknown; }
+    }
+    for (unsigned int& bound : buffers_) { bound = kUnknown; }
+    for (unsigned int& cap : caps_) { cap = kUnknown; }
+}
+
+/* Non-member helper implementation */
+
+int TextureSlotOf(unsigned int target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return GLState::kTexture2D;
+        case GL_TEXTURE_2D_ARRAY: return GLState::kTexture2DArray;
+        case GL_TEXTURE_CUBE_MAP: return GLState::kTextureCubeMap;
+        case GL_TEXTURE_3D: return GLState::kTexture3D;
+        default: return -1;
+    }
+}
+
+int BufferSlotOf(unsigned int target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return GLState::kArrayBuffer;
+        case GL_ELEMENT_ARRAY_BUFFER: return GLState::kElementArrayBuffer;
+        case GL_UNIFORM_BUFFER: return GLState::kUniformBuffer;
+        case GL_SHADER_STORAGE_BUFFER: return GLState::kShaderStorageBuffer;
+        case GL_DRAW_INDIRECT_BUFFER: return GLState::kDrawIndirectBuffer;
+        case GL_PIXEL_UNPACK_BUFFER: return GLState::kPixelUnpackBuffer;
+        case GL_COPY_READ_BUFFER: return GLState::kCopyReadBuffer;
+        case GL_COPY_WRITE_BUFFER: return GLState::kCopyWriteBuffer;
+        default: return -1;
+    }
+}
+
+int CapSlotOf(unsigned int cap) {
+    switch (cap) {
+        case GL_DEPTH_TEST: return GLState::kDepthTest;
+        case GL_BLEND: return GLState::kBlend;
+        case GL_CULL_FACE: return GLState::kCullFace;
+        case GL_SCISSOR_TEST: return GLState::kScissorTest;
+        default: return -1;
+    }
+}
@@ -0,0 +1,88 @@
+/*
+Shadow copy of the GL binding state so redundant binds never reach the driver.
+All program, VAO, texture, buffer and capability changes should go through here;
+anything that bypasses it must call Invalidate() afterwards.
+*/
+
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <cstddef>
+
+// Texture units tracked; GL 3.3 guarantees at least 16 combined
+const int kMaxTrackedTextureUnits{ 32 };
+
+// Per-frame call counts
+struct GLStateCounters {
+    size_t issued;
+    size_t skipped;
+};
+
+/* GLState class
+* Like Camera, there is one GL context per program, so treat it as a Singleton
+*/
+class GLState {
+public:
+    // Texture targets and buffer targets tracked; others go straight to GL
+    enum TextureSlot { kTexture2D, kTexture2DArray, kTextureCubeMap, kTexture3D, kTextureSlotCount };
+    enum BufferSlot { kArrayBuffer, kElementArrayBuffer, kUniformBuffer, kShaderStorageBuffer, kDrawIndirectBuffer,
+        kPixelUnpackBuffer, kCopyReadBuffer, kCopyWriteBuffer, kBufferSlotCount };
+    // Capabilities tracked by Enable/Disable
+    enum CapSlot { kDepthTest, kBlend, kCullFace, kScissorTest, kCapSlotCount };
+private:
+    // kUnknown means the value is not known and the next bind must be issued
+    static const unsigned int kUnknown{ ~0u };
+
+    unsigned int program_;
+    unsigned int vertex_array_;
+    // GL_TEXTURE0 + n
+    unsigned int active_texture_;
+    unsigned int textures_[kMaxTrackedTextureUnits][kTextureSlotCount];
+    unsigned int buffers_[kBufferSlotCount];
+    // 0 = disabled, 1 = enabled, kUnknown
+    unsigned int caps_[kCapSlotCount];
+
+    GLStateCounters counters_;
+    // Uniform uploads, filtered by the per-program value shadows in Shader
+    GLStateCounters uniform_counters_;
+
+    GLState();
+    // @return: true and counts the call if it must be issued; false and counts a skip otherwise
+    bool Change(unsigned int& shadow, unsigned int value);
+public:
+    // @return: Singleton GLState reference
+    static GLState& GetInstance();
+
+    void UseProgram(unsigned int program);
+    void BindVertexArray(unsigned int vao);
+    // unit: GL_TEXTURE0 + n
+    void ActiveTexture(unsigned int unit);
+    // Bind to the currently active unit
+    void BindTexture(unsigned int target, unsigned int texture);
+    // Select unit (GL_TEXTURE0 + n) and bind there; skips both calls if already bound
+    void BindTextureUnit(unsigned int unit, unsigned int target, unsigned int texture);
+    // Select unit and bind there, always leaving unit active so glTex* calls that follow edit texture
+    void BindTextureForEdit(unsigned int unit, unsigned int target, unsigned int texture);
+    void BindBuffer(unsigned int target, unsigned int buffer);
+    // Indexed bindings are not shadowed, but they also change the generic binding of target
+    void BindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, ptrdiff_t offset, ptrdiff_t size);
+    void Enable(unsigned int cap);
+    void Disable(unsigned int cap);
+
+    // GL silently unbinds deleted objects; call these after deleting so the shadow matches
+    void OnProgramDeleted(unsigned int program);
+    void OnVertexArrayDeleted(unsigned int vao);
+    void OnTextureDeleted(unsigned int texture);
+    void OnBufferDeleted(unsigned int buffer);
+    // Forget everything; the next bind of each kind is always issued
+    void Invalidate();
+
+    /* Counters */
+    const GLStateCounters& GetCounters() const { return counters_; }
+    const GLStateCounters& GetUniformCounters() const { return uniform_counters_; }
+    // Count one uniform set; issued: the value changed and reached GL
+    void CountUniform(bool issued) { ++(issued ? uniform_counters_.issued : uniform_counters_.skipped); }
+    void ResetCounters() { counters_ = GLStateCounters{}; uniform_counters_ = GLStateCounters{}; }
+};
+
+#endif // !GL_STATE_H
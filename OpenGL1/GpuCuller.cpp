@@ -0,0 +1,177 @@
+/*
+GPU-driven frustum culling with a CPU fallback
+*/
+
+#include "GpuCuller.h"
+#include "FrameData.h"
+#include "GLState.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "VertexLayout.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// Must match local_size_x in cull.comp
+static const unsigned int kCullGroupSize{ 64 };
+// Shader storage binding points used by cull.comp
+static const unsigned int kObjectBinding{ 0 };
+static const unsigned int kInstanceBinding{ 1 };
+static const unsigned int kCommandBinding{ 2 };
+
+// @return: model transform of an object at time, built the same way as in cull.comp
+static glm::mat4 ComputeObjectTransform(const CullObject& object, float time);
+
+/* GpuCuller implementation */
+
+// objects: every object to cull; meshes: indexed by CullObject::mesh
+GpuCuller::GpuCuller(std::vector<CullObject> objects, const std::vector<IndirectMesh>& meshes, ProgramCache* program_cache) :
+    objects_{ std::move(objects) },
+    commands_(meshes.size()),
+    gpu_driven_{ GLAD_GL_VERSION_4_3 != 0 },
+    object_buffer_{},
+    instance_buffer_{},
+    command_buffer_{},
+    cpu_counts_(meshes.size()) {
+    std::stable_sort(objects_.begin(), objects_.end(), [](const CullObject& a, const CullObject& b) { return a.mesh < b.mesh; });
+
+    // Each mesh's instances start right after the previous mesh's, so a command never
+    // writes past its own range even if every object survives
+    unsigned int base_instance{};
+    for (size_t m{}; m < meshes.size(); ++m) {
+        DrawElementsIndirectCommand& command{ commands_[m] };
+        command.count = meshes[m].index_count;
+        command.instance_count = 0;
+        command.first_index = meshes[m].first_index;
+        command.base_vertex = meshes[m].base_vertex;
+        command.base_instance = base_instance;
+        base_instance += static_cast<unsigned int>(std::count_if(objects_.begin(), objects_.end(),
+            [m](const CullObject& object) { return object.mesh == m; }));
+    }
+
+    if (!gpu_driven_) {
+        cpu_instances_.resize(objects_.size());
+        return;
+    }
+
+    cull_program_ = std::make_unique<Shader>("cull.comp", program_cache);
+    std::cout << "Program cull.comp: " << cull_program_->GetBuildMs() << " ms, "
+        << (cull_program_->IsFromCache() ? "binary cache" : "compiled") << std::endl;
+    cull_program_->BindUniformBlock("FrameData", kFrameDataBinding);
+
+    GLState& gl_state{ GLState::GetInstance() };
+    glGenBuffers(1, &object_buffer_);
+    glGenBuffers(1, &instance_buffer_);
+    glGenBuffers(1, &command_buffer_);
+    gl_state.BindBuffer(GL_SHADER_STORAGE_BUFFER, object_buffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, objects_.size() * sizeof(CullObject), objects_.data(), GL_STATIC_DRAW);
+    // Written and read only by the GPU
+    gl_state.BindBuffer(GL_SHADER_STORAGE_BUFFER, instance_buffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, objects_.size() * sizeof(glm::mat4), nullptr, GL_DYNAMIC_COPY);
+    gl_state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands_.size() * sizeof(DrawElementsIndirectCommand), commands_.data(), GL_DYNAMIC_DRAW);
+}
+
+GpuCuller::~GpuCuller() {
+    if (!gpu_driven_) {
+        return;
+    }
+    unsigned int buffers[]{ object_buffer_, instance_buffer_, command_buffer_ };
+    glDeleteBuffers(3, buffers);
+    for (unsigned int buffer : buffers) {
+        GLState::GetInstance().OnBufferDeleted(buffer);
+    }
+}
+
+// Cull every object against the frustum and animate the survivors to time
+void GpuCuller::Cull(const Frustum& frustum, float time) {
+    if (!gpu_driven_) {
+        std::fill(cpu_counts_.begin(), cpu_counts_.end(), 0);
+        for (const CullObject& object : objects_) {
+            if (!frustum.IntersectsSphere(glm::vec3{ object.position_radius }, object.position_radius.w)) {
+                continue;
+            }
+            const DrawElementsIndirectCommand& command{ commands_[object.mesh] };
+            cpu_instances_[command.base_instance + cpu_counts_[object.mesh]++] = ComputeObjectTransform(object, time);
+        }
+        return;
+    }
+
+    // Zero the instance counts; the compute shader increments them as objects survive
+    GLState& gl_state{ GLState::GetInstance() };
+    gl_state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands_.size() * sizeof(DrawElementsIndirectCommand), commands_.data());
+
+    gl_state.BindBufferRange(GL_SHADER_STORAGE_BUFFER, kObjectBinding, object_buffer_, 0, objects_.size() * sizeof(CullObject));
+    gl_state.BindBufferRange(GL_SHADER_STORAGE_BUFFER, kInstanceBinding, instance_buffer_, 0, objects_.size() * sizeof(glm::mat4));
+    gl_state.BindBufferRange(GL_SHADER_STORAGE_BUFFER, kCommandBinding, command_buffer_, 0, commands_.size() * sizeof(DrawElementsIndirectCommand));
+
+    cull_program_->Use();
+    cull_program_->SetInt("object_count", static_cast<int>(objects_.size()));
+    glDispatchCompute((static_cast<unsigned int>(objects_.size()) + kCullGroupSize - 1) / kCullGroupSize, 1, 1);
+
+    // The draw reads the commands and the transforms the dispatch just wrote; the next Cull's
+    // glBufferSubData and GetVisibleCount's read back must also wait for the atomic counts
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+// Draw the survivors of the last Cull with the VAO and program that are bound
+void GpuCuller::Draw(StreamBuffer& stream, const VertexLayout& instance_layout) {
+    GLState& gl_state{ GLState::GetInstance() };
+    if (gpu_driven_) {
+        // base_instance offsets the instance attributes, so one binding at 0 covers every mesh
+        gl_state.BindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+        instance_layout.Apply();
+        gl_state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(commands_.size()), 0);
+        return;
+    }
+
+    // GL 3.3 has no base instance, so each mesh gets its own range in the stream buffer
+    for (size_t m{}; m < commands_.size(); ++m) {
+        unsigned int count{ cpu_counts_[m] };
+        if (count == 0) {
+            continue;
+        }
+        size_t instance_offset;
+        void* instances{ stream.Allocate(count * sizeof(glm::mat4), sizeof(glm::vec4), &instance_offset) };
+        if (!instances) {
+            // Out of stream space for this frame; drop the rest rather than overwrite in-flight data
+            break;
+        }
+        memcpy(instances, &cpu_instances_[commands_[m].base_instance], count * sizeof(glm::mat4));
+        stream.Flush();
+
+        gl_state.BindBuffer(GL_ARRAY_BUFFER, stream.GetId());
+        instance_layout.Apply(instance_offset);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, commands_[m].count, GL_UNSIGNED_INT,
+            reinterpret_cast<void*>(commands_[m].first_index * sizeof(unsigned int)), count, commands_[m].base_vertex);
+    }
+}
+
+// @return: objects that survived the last Cull; reads the GPU counts back, so it stalls
+size_t GpuCuller::GetVisibleCount() const {
+    size_t visible{};
+    if (!gpu_driven_) {
+        for (unsigned int count : cpu_counts_) { visible += count; }
+        return visible;
+    }
+
+    std::vector<DrawElementsIndirectCommand> commands(commands_.size());
+    GLState::GetInstance().BindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+    glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+    for (const DrawElementsIndirectCommand& command : commands) { visible += command.instance_count; }
+    return visible;
+}
+
+/* Non-member helper implementation */
+
+// @return: model transform of an object at time, built the same way as in cull.comp
+glm::mat4 ComputeObjectTransform(const CullObject& object, float time) {
+    glm::mat4 model{ glm::translate(glm::mat4{ 1.f }, glm::vec3{ object.position_radius }) };
+    return glm::rotate(model, time * object.axis_speed.w, glm::vec3{ object.axis_speed });
+}
@@ -0,0 +1,96 @@
+/*
+GPU-driven culling: object bounds and animation parameters live in a shader storage buffer,
+a compute shader (cull.comp) tests them against the frustum, writes the survivors' model
+matrices and bumps the instance counts of the indirect draw commands, and one
+glMultiDrawElementsIndirect draws everything. The CPU never touches individual objects.
+
+Without GL 4.3 the same culling runs on the CPU and the survivors are drawn with one
+instanced draw per mesh, their transforms streamed through a StreamBuffer.
+*/
+
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include "Frustum.h"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+class ProgramCache;
+class Shader;
+class StreamBuffer;
+class VertexLayout;
+
+// std430 layout of one object in the object buffer; must match cull.comp
+struct CullObject {
+    // xyz: world position, w: bounding sphere radius
+    glm::vec4 position_radius;
+    // xyz: spin axis, w: angular speed in radians per second
+    glm::vec4 axis_speed;
+    // Which IndirectMesh to draw the object with
+    unsigned int mesh;
+    unsigned int padding[3];
+};
+
+static_assert(sizeof(CullObject) == 48, "CullObject must match the std430 layout in cull.comp");
+
+// Layout fixed by glMultiDrawElementsIndirect; must match cull.comp
+struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instance_count;
+    unsigned int first_index;
+    int base_vertex;
+    unsigned int base_instance;
+};
+
+// A mesh inside the element buffer of the VAO bound when drawing
+struct IndirectMesh {
+    unsigned int index_count;
+    unsigned int first_index;
+    int base_vertex;
+};
+
+class GpuCuller {
+    // Sorted by mesh, so each mesh owns a contiguous range of instance slots
+    std::vector<CullObject> objects_;
+    // Per-mesh commands with instance_count 0; uploaded at the start of every cull
+    std::vector<DrawElementsIndirectCommand> commands_;
+    bool gpu_driven_;
+
+    /* GL 4.3 path */
+    std::unique_ptr<Shader> cull_program_;
+    unsigned int object_buffer_;
+    // One mat4 per object, read back as instance attributes
+    unsigned int instance_buffer_;
+    unsigned int command_buffer_;
+
+    /* CPU fallback */
+    // Survivors of the last cull, grouped by mesh; commands_[m].base_instance indexes into it
+    std::vector<glm::mat4> cpu_instances_;
+    std::vector<unsigned int> cpu_counts_;
+public:
+    // objects: every object to cull; meshes: indexed by CullObject::mesh
+    // program_cache: optional binary cache for the culling program
+    GpuCuller(std::vector<CullObject> objects, const std::vector<IndirectMesh>& meshes, ProgramCache* program_cache = nullptr);
+    ~GpuCuller();
+    GpuCuller(const GpuCuller&) = delete;
+    GpuCuller& operator=(const GpuCuller&) = delete;
+
+    // Cull every object against the frustum and animate the survivors to time
+    // The GPU path reads both from the FrameData block, which must already be bound
+    void Cull(const Frustum& frustum, float time);
+    // Draw the survivors of the last Cull with the VAO and program that are bound
+    // The fallback streams its transforms through stream; both paths use instance_layout
+    void Draw(StreamBuffer& stream, const VertexLayout& instance_layout);
+
+    // @return: objects that survived the last Cull; reads the GPU counts back, so it stalls
+    size_t GetVisibleCount() const;
+    size_t GetObjectCount() const { return objects_.size(); }
+    // @return: draw calls issued per Draw
+    size_t GetDrawCallCount() const { return gpu_driven_ ? 1 : commands_.size(); }
+    bool IsGpuDriven() const { return gpu_driven_; }
+};
+
+#endif // !GPU_CULLER_H
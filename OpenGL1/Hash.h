@@ -0,0 +1,37 @@
+/*
+64 bit FNV-1a, the content hash behind the program binary cache, the SPIR-V library and baked
+textures, and the hash of the renderer's lookup tables. Keys can be continued piece by piece, so a
+source split over several files hashes the same as the concatenated text. A 32 bit constexpr
+variant hashes uniform names at compile time.
+*/
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Key every hash starts from (FNV-1a offset basis)
+const uint64_t kHashSeed{ 14695981039346656037ull };
+
+// @return: hash continued over size bytes of data
+inline uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes{ static_cast<const unsigned char*>(data) };
+    for (size_t i{}; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Key every 32 bit hash starts from
+const uint32_t kHashSeed32{ 2166136261u };
+
+// @return: 32 bit hash continued over the characters of the null terminated text
+constexpr uint32_t HashString32(uint32_t hash, const char* text) {
+    for (; *text; ++text) {
+        hash = (hash ^ static_cast<unsigned char>(*text)) * 16777619u;
+    }
+    return hash;
+}
+
+#endif // !HASH_H
@@ -0,0 +1,198 @@
+/*
+Work-stealing job system
+*/
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+// Which JobSystem the current thread works for, and its deque there
+struct WorkerIdentity {
+    const JobSystem* owner;
+    size_t index;
+};
+static thread_local WorkerIdentity tls_worker{ nullptr, 0 };
+
+/* JobSystem implementation */
+
+// thread_count: total threads including the calling one; 0 picks one per hardware thread
+JobSystem::JobSystem(size_t thread_count) : queued_{}, stopping_{ false } {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i{}; i < thread_count; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    tls_worker = WorkerIdentity{ this, 0 };
+    for (size_t i{ 1 }; i < thread_count; ++i) {
+        threads_.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+}
+
+// Jobs that never became ready are dropped
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock{ sleep_mutex_ };
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) { thread.join(); }
+    if (tls_worker.owner == this) {
+        tls_worker = WorkerIdentity{ nullptr, 0 };
+    }
+}
+
+// Run task once every job in dependencies has finished
+JobHandle JobSystem::Schedule(std::function<void()> task, std::initializer_list<JobHandle> dependencies) {
+    return Schedule(std::move(task), std::vector<JobHandle>(dependencies));
+}
+
+JobHandle JobSystem::Schedule(std::function<void()> task, const std::vector<JobHandle>& dependencies) {
+    JobHandle job{ std::make_shared<Job>(std::move(task)) };
+    for (const JobHandle& dependency : dependencies) {
+        if (!dependency) {
+            continue;
+        }
+        // Register under the dependency's lock so it cannot finish between the check and the push
+        std::lock_guard<std::mutex> lock{ dependency->mutex_ };
+        if (!dependency->done_) {
+            ++job->unfinished_dependencies_;
+            dependency->continuations_.push_back(job);
+        }
+    }
+    // Drop the setup reference; whoever brings the count to 0 makes the job ready
+    if (--job->unfinished_dependencies_ == 0) {
+        Enqueue(job);
+    }
+    return job;
+}
+
+// Run jobs on this thread until job has finished
+void JobSystem::Wait(const JobHandle& job) {
+    size_t self{ CurrentWorker() };
+    while (!job->IsDone()) {
+        JobHandle next{ FindJob(self) };
+        if (next) {
+            Execute(next);
+        }
+        else {
+            // The remaining work is running elsewhere
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Split [0, count) into chunks and call body(begin, end) for each, in parallel
+JobHandle JobSystem::ScheduleParallelFor(size_t count, std::function<void(size_t, size_t)> body,
+    size_t min_chunk, std::initializer_list<JobHandle> dependencies) {
+    // Shared rather than copied into every chunk
+    auto shared_body = std::make_shared<std::function<void(size_t, size_t)>>(std::move(body));
+    size_t chunk{ GetChunkSize(count, min_chunk) };
+    std::vector<JobHandle> chunks;
+    for (size_t begin{}; begin < count; begin += chunk) {
+        size_t end{ std::min(count, begin + chunk) };
+        chunks.push_back(Schedule([shared_body, begin, end] { (*shared_body)(begin, end); }, dependencies));
+    }
+    if (chunks.empty()) {
+        return Schedule([] {}, dependencies);
+    }
+    return Schedule([] {}, chunks);
+}
+
+// ScheduleParallelFor and Wait
+void JobSystem::ParallelFor(size_t count, std::function<void(size_t, size_t)> body, size_t min_chunk) {
+    if (count <= min_chunk || workers_.size() == 1) {
+        // Not worth the scheduling overhead
+        if (count > 0) { body(0, count); }
+        return;
+    }
+    Wait(ScheduleParallelFor(count, std::move(body), min_chunk));
+}
+
+// @return: chunk length ScheduleParallelFor uses for count items
+size_t JobSystem::GetChunkSize(size_t count, size_t min_chunk) const {
+    size_t target_chunks{ workers_.size() * 4 };
+    return std::max<size_t>({ 1, min_chunk, (count + target_chunks - 1) / target_chunks });
+}
+
+// Make a job runnable on the calling thread's deque (worker 0's for outside threads)
+void JobSystem::Enqueue(JobHandle job) {
+    Worker& worker{ *workers_[CurrentWorker()] };
+    {
+        std::lock_guard<std::mutex> lock{ worker.mutex };
+        worker.jobs.push_back(std::move(job));
+    }
+    ++queued_;
+    // Taking the lock orders the increment against a worker checking queued_ before it sleeps
+    { std::lock_guard<std::mutex> lock{ sleep_mutex_ }; }
+    wake_.notify_one();
+}
+
+// Pop own work, else steal; @return: a ready job or nullptr
+JobHandle JobSystem::FindJob(size_t self) {
+    if (queued_ == 0) {
+        return nullptr;
+    }
+    // Newest own job first: its data is most likely still in cache
+    {
+        Worker& own{ *workers_[self] };
+        std::lock_guard<std::mutex> lock{ own.mutex };
+        if (!own.jobs.empty()) {
+            JobHandle job{ std::move(own.jobs.back()) };
+            own.jobs.pop_back();
+            --queued_;
+            return job;
+        }
+    }
+    // Oldest job of someone else: usually the biggest piece of work they have left
+    for (size_t offset{ 1 }; offset < workers_.size(); ++offset) {
+        Worker& victim{ *workers_[(self + offset) % workers_.size()] };
+        std::lock_guard<std::mutex> lock{ victim.mutex };
+        if (!victim.jobs.empty()) {
+            JobHandle job{ std::move(victim.jobs.front()) };
+            victim.jobs.pop_front();
+            --queued_;
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+// Run job and release the jobs that were waiting on it
+void JobSystem::Execute(const JobHandle& job) {
+    job->task_();
+    job->task_ = nullptr; // free the captures now rather than when the last handle goes
+
+    std::vector<JobHandle> continuations;
+    {
+        std::lock_guard<std::mutex> lock{ job->mutex_ };
+        job->done_.store(true, std::memory_order_release);
+        continuations.swap(job->continuations_);
+    }
+    for (JobHandle& continuation : continuations) {
+        if (--continuation->unfinished_dependencies_ == 0) {
+            Enqueue(std::move(continuation));
+        }
+    }
+}
+
+void JobSystem::WorkerLoop(size_t self) {
+    tls_worker = WorkerIdentity{ this, self };
+    while (true) {
+        JobHandle job{ FindJob(self) };
+        if (job) {
+            Execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock{ sleep_mutex_ };
+        wake_.wait(lock, [this] { return queued_ > 0 || stopping_; });
+        if (stopping_) {
+            return;
+        }
+    }
+}
+
+// @return: index of the calling thread in workers_, or 0 if it is not one of ours
+size_t JobSystem::CurrentWorker() const {
+    return tls_worker.owner == this ? tls_worker.index : 0;
+}
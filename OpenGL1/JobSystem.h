@@ -0,0 +1,97 @@
+/*
+Work-stealing job system.
+Every thread owns a deque of ready jobs: it pushes and pops its own at the back, and idle
+threads steal from the front of the others', so large jobs spread out while recently
+spawned (cache warm) work stays local. The thread that created the JobSystem is worker 0
+and runs jobs while it waits, so a JobSystem of 1 thread runs everything inline.
+Jobs can depend on other jobs; a job becomes ready once all of its dependencies have finished,
+which is also how continuations are expressed.
+*/
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// One unit of work; only reachable through JobHandle
+class Job {
+    friend class JobSystem;
+
+    std::function<void()> task_;
+    // Dependencies still running, +1 while the job is being set up
+    std::atomic<int> unfinished_dependencies_;
+    std::atomic<bool> done_;
+    // Guards continuations_ against done_ changing underneath
+    std::mutex mutex_;
+    // Jobs that depend on this one
+    std::vector<std::shared_ptr<Job>> continuations_;
+public:
+    explicit Job(std::function<void()> task) : task_{ std::move(task) }, unfinished_dependencies_{ 1 }, done_{ false } {}
+
+    bool IsDone() const { return done_.load(std::memory_order_acquire); }
+};
+
+using JobHandle = std::shared_ptr<Job>;
+
+class JobSystem {
+    // One per thread, worker 0 being the creating thread
+    struct Worker {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    // Jobs sitting in any deque; sleeping workers wake when it goes up
+    std::atomic<size_t> queued_;
+    std::atomic<bool> stopping_;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+
+    // Make a job runnable on the calling thread's deque (worker 0's for outside threads)
+    void Enqueue(JobHandle job);
+    // Pop own work, else steal; @return: a ready job or nullptr
+    JobHandle FindJob(size_t self);
+    // Run job and release the jobs that were waiting on it
+    void Execute(const JobHandle& job);
+    void WorkerLoop(size_t self);
+    // @return: index of the calling thread in workers_, or 0 if it is not one of ours
+    size_t CurrentWorker() const;
+public:
+    // thread_count: total threads including the calling one; 0 picks one per hardware thread
+    explicit JobSystem(size_t thread_count = 0);
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    size_t GetThreadCount() const { return workers_.size(); }
+
+    // Run task once every job in dependencies has finished
+    JobHandle Schedule(std::function<void()> task, std::initializer_list<JobHandle> dependencies = {});
+    JobHandle Schedule(std::function<void()> task, const std::vector<JobHandle>& dependencies);
+    // Run jobs on this thread until job has finished
+    void Wait(const JobHandle& job);
+
+    // Split [0, count) into chunks and call body(begin, end) for each, in parallel
+    // Chunks are at least min_chunk long and about 4 per thread, so stealing can even out the load
+    // @return: job that finishes after the last chunk
+    JobHandle ScheduleParallelFor(size_t count, std::function<void(size_t, size_t)> body,
+        size_t min_chunk = 64, std::initializer_list<JobHandle> dependencies = {});
+    // ScheduleParallelFor and Wait
+    void ParallelFor(size_t count, std::function<void(size_t, size_t)> body, size_t min_chunk = 64);
+    // @return: chunk length ScheduleParallelFor uses for count items
+    size_t GetChunkSize(size_t count, size_t min_chunk) const;
+};
+
+#endif // !JOB_SYSTEM_H
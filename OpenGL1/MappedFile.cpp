@@ -0,0 +1,91 @@
+/*
+Read-only file mapping: MapViewOfFile on Windows, mmap elsewhere
+*/
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* MappedFile implementation */
+
+// Map path; IsValid is false if it cannot be opened
+MappedFile::MappedFile(const char* path) :
+    data_{ nullptr },
+    size_{},
+    mapping_{ nullptr } {
+    // Empty files cannot be mapped; point them at an empty string instead
+    static const char kEmpty[]{ "" };
+#ifdef _WIN32
+    mapping_handle_ = nullptr;
+    HANDLE file{ CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    LARGE_INTEGER size{};
+    GetFileSizeEx(file, &size);
+    if (size.QuadPart == 0) {
+        data_ = kEmpty;
+        CloseHandle(file);
+        return;
+    }
+    mapping_handle_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The mapping keeps the file open
+    CloseHandle(file);
+    if (!mapping_handle_) {
+        return;
+    }
+    mapping_ = MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0);
+    if (!mapping_) {
+        CloseHandle(mapping_handle_);
+        mapping_handle_ = nullptr;
+        return;
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+#else
+    int file{ open(path, O_RDONLY | O_CLOEXEC) };
+    if (file < 0) {
+        return;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0) {
+        close(file);
+        return;
+    }
+    if (info.st_size == 0) {
+        data_ = kEmpty;
+        close(file);
+        return;
+    }
+    void* mapping{ mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0) };
+    // The mapping keeps the file open
+    close(file);
+    if (mapping == MAP_FAILED) {
+        return;
+    }
+    mapping_ = mapping;
+    size_ = static_cast<size_t>(info.st_size);
+#endif
+    data_ = static_cast<const char*>(mapping_);
+}
+
+MappedFile::~MappedFile() {
+    if (!mapping_) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(mapping_);
+    CloseHandle(mapping_handle_);
+#else
+    munmap(mapping_, size_);
+#endif
+}
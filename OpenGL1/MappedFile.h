@@ -0,0 +1,31 @@
+/*
+Read-only memory mapping of a whole file. Shader overrides and baked textures are read through
+it, so their bytes go from the page cache to glShaderSource or glTexImage2D without a copy.
+*/
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+class MappedFile {
+    const char* data_;
+    size_t size_;
+    // Mapping to release, null for empty files
+    void* mapping_;
+#ifdef _WIN32
+    void* mapping_handle_;
+#endif
+public:
+    // Map path; IsValid is false if it cannot be opened
+    explicit MappedFile(const char* path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool IsValid() const { return data_ != nullptr; }
+    const char* GetData() const { return data_; }
+    size_t GetSize() const { return size_; }
+};
+
+#endif // !MAPPED_FILE_H
@@ -0,0 +1,218 @@
+/*
+Mesh building utilities: welds duplicate vertices into an indexed mesh and
+reorders it for the post-transform vertex cache and vertex fetch locality.
+*/
+
+#include "Mesh.h"
+#include "Hash.h"
+
+#include <cstring>
+
+/* MeshBuilder implementation */
+
+// FNV-1a over the vertex bytes; MeshVertex is tightly packed floats so there is no padding to skip
+size_t MeshBuilder::VertexHash::operator()(const MeshVertex& v) const {
+    return static_cast<size_t>(HashBytes(kHashSeed, &v, sizeof(MeshVertex)));
+}
+
+bool MeshBuilder::VertexEqual::operator()(const MeshVertex& a, const MeshVertex& b) const {
+    return memcmp(&a, &b, sizeof(MeshVertex)) == 0;
+}
+
+// Append one corner of a triangle; duplicates reuse the existing index
+void MeshBuilder::AddVertex(const MeshVertex& vertex) {
+    // Adding 0 turns -0.f into +0.f so both compare equal bitwise
+    MeshVertex key{ vertex.position + glm::vec3{ 0.f }, vertex.tex_coord + glm::vec2{ 0.f }, vertex.normal + glm::vec3{ 0.f } };
+    ++input_vertices_;
+
+    auto found = vertex_lookup_.find(key);
+    if (found != vertex_lookup_.end()) {
+        mesh_.indices.push_back(found->second);
+        return;
+    }
+    unsigned int index{ static_cast<unsigned int>(mesh_.vertices.size()) };
+    mesh_.vertices.push_back(key);
+    vertex_lookup_.emplace(key, index);
+    mesh_.indices.push_back(index);
+}
+
+// Append a non-indexed triangle list of interleaved floats (3 position + 2 tex coord per vertex)
+// Normals are not part of the input, so each vertex gets the flat normal of its triangle
+void MeshBuilder::AddTriangles(const float* data, size_t vertex_count) {
+    for (size_t i{}; i + 3 <= vertex_count; i += 3, data += 15) {
+        glm::vec3 corners[3];
+        for (int c{}; c < 3; ++c) {
+            corners[c] = glm::vec3{ data[c * 5], data[c * 5 + 1], data[c * 5 + 2] };
+        }
+        glm::vec3 normal{ glm::normalize(glm::cross(corners[1] - corners[0], corners[2] - corners[0])) };
+        for (int c{}; c < 3; ++c) {
+            AddVertex(MeshVertex{ corners[c], glm::vec2{ data[c * 5 + 3], data[c * 5 + 4] }, normal });
+        }
+    }
+}
+
+// @return: welded mesh, optionally reordered for the vertex cache and vertex fetch
+Mesh MeshBuilder::Build(bool optimize, MeshBuildReport* report) const {
+    Mesh mesh{ mesh_ };
+    CacheStats before{ AnalyzeVertexCache(mesh.indices, mesh.vertices.size()) };
+
+    if (optimize) {
+        OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+        // Fetch order must be fixed up after triangle order, since it follows first use
+        OptimizeVertexFetch(mesh);
+    }
+
+    if (report) {
+        report->input_vertices = input_vertices_;
+        report->unique_vertices = mesh.vertices.size();
+        report->triangles = mesh.indices.size() / 3;
+        report->before = before;
+        report->after = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+    }
+    return mesh;
+}
+
+/* Standalone passes */
+
+// @return: cache efficiency of indices when run through a FIFO cache of cache_size entries
+CacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertex_count, int cache_size) {
+    // FIFO matches what most hardware does; a vertex entering the cache gets the current timestamp
+    // and stays resident until cache_size newer vertices have been transformed
+    std::vector<size_t> cached_at(vertex_count, 0);
+    size_t time{ static_cast<size_t>(cache_size) + 1 };
+    size_t misses{};
+    size_t used_vertices{};
+    std::vector<bool> used(vertex_count, false);
+
+    for (unsigned int index : indices) {
+        if (time - cached_at[index] > static_cast<size_t>(cache_size)) {
+            cached_at[index] = time++;
+            ++misses;
+        }
+        if (!used[index]) {
+            used[index] = true;
+            ++used_vertices;
+        }
+    }
+
+    CacheStats stats{};
+    if (!indices.empty()) {
+        stats.acmr = static_cast<float>(misses) / (indices.size() / 3);
+        stats.atvr = static_cast<float>(misses) / used_vertices;
+    }
+    return stats;
+}
+
+// Reorder triangles in place so consecutive triangles reuse recently transformed vertices (Tipsify)
+// Fans around one vertex at a time and picks the next fan vertex among the ones just emitted,
+// preferring those that are still in the cache and have few live triangles left
+void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertex_count, int cache_size) {
+    size_t triangle_count{ indices.size() / 3 };
+    if (triangle_count == 0) { return; }
+
+    // Vertex -> triangle adjacency in CSR form
+    std::vector<unsigned int> adjacency_offset(vertex_count + 1, 0);
+    for (unsigned int index : indices) { ++adjacency_offset[index + 1]; }
+    for (size_t v{}; v < vertex_count; ++v) { adjacency_offset[v + 1] += adjacency_offset[v]; }
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> fill{ adjacency_offset.begin(), adjacency_offset.end() - 1 };
+        for (size_t i{}; i < indices.size(); ++i) {
+            adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+    }
+
+    // Triangles not yet emitted that still use each vertex
+    std::vector<int> live_triangles(vertex_count);
+    for (size_t v{}; v < vertex_count; ++v) {
+        live_triangles[v] = adjacency_offset[v + 1] - adjacency_offset[v];
+    }
+
+    std::vector<size_t> cached_at(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    // Vertices of recently emitted triangles; fallback when a fan runs into a dead end
+    std::vector<unsigned int> dead_end_stack;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    size_t time{ static_cast<size_t>(cache_size) + 1 };
+    size_t cursor{ 1 };
+    long long fan_vertex{ 0 };
+    std::vector<unsigned int> candidates;
+
+    while (fan_vertex >= 0) {
+        candidates.clear();
+        unsigned int f{ static_cast<unsigned int>(fan_vertex) };
+
+        // Emit every remaining triangle around the fan vertex
+        for (unsigned int a{ adjacency_offset[f] }; a < adjacency_offset[f + 1]; ++a) {
+            unsigned int t{ adjacency[a] };
+            if (emitted[t]) { continue; }
+            for (int corner{}; corner < 3; ++corner) {
+                unsigned int v{ indices[t * 3 + corner] };
+                output.push_back(v);
+                dead_end_stack.push_back(v);
+                candidates.push_back(v);
+                --live_triangles[v];
+                if (time - cached_at[v] > static_cast<size_t>(cache_size)) {
+                    cached_at[v] = time++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        // Next fan: the candidate that will still be cached after its remaining triangles are emitted,
+        // and among those the one that entered the cache earliest
+        fan_vertex = -1;
+        long long best_priority{ -1 };
+        for (unsigned int v : candidates) {
+            if (live_triangles[v] <= 0) { continue; }
+            long long priority{};
+            if (time - cached_at[v] + 2 * live_triangles[v] <= static_cast<size_t>(cache_size)) {
+                priority = static_cast<long long>(time - cached_at[v]);
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                fan_vertex = v;
+            }
+        }
+
+        // Dead end: try recently used vertices first, then scan forward for any vertex with work left
+        if (fan_vertex < 0) {
+            while (!dead_end_stack.empty()) {
+                unsigned int v{ dead_end_stack.back() };
+                dead_end_stack.pop_back();
+                if (live_triangles[v] > 0) {
+                    fan_vertex = v;
+                    break;
+                }
+            }
+        }
+        while (fan_vertex < 0 && cursor < vertex_count) {
+            if (live_triangles[cursor] > 0) {
+                fan_vertex = static_cast<long long>(cursor);
+            }
+            ++cursor;
+        }
+    }
+
+    indices.swap(output);
+}
+
+// Renumber vertices in order of first use so the vertex fetch reads memory mostly sequentially
+void OptimizeVertexFetch(Mesh& mesh) {
+    const unsigned int kUnassigned{ ~0u };
+    std::vector<unsigned int> remap(mesh.vertices.size(), kUnassigned);
+    std::vector<MeshVertex> reordered;
+    reordered.reserve(mesh.vertices.size());
+
+    for (unsigned int& index : mesh.indices) {
+        if (remap[index] == kUnassigned) {
+            remap[index] = static_cast<unsigned int>(reordered.size());
+            reordered.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    // Vertices no triangle references are dropped
+    mesh.vertices.swap(reordered);
+}
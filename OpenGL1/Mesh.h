@@ -0,0 +1,89 @@
+/*
+Mesh building utilities: welds duplicate vertices into an indexed mesh and
+reorders it for the post-transform vertex cache and vertex fetch locality.
+Triangle ordering follows "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+(Sander, Nehab, Barczak 2007), aka Tipsify
+*/
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+// Simulated post-transform cache size used for reordering and reporting.
+// Small enough to be conservative for any GPU made in the last decade
+const int kVertexCacheSize{ 16 };
+
+// One full precision vertex; see VertexLayout.h for the packed GPU formats
+struct MeshVertex {
+    glm::vec3 position;
+    glm::vec2 tex_coord;
+    glm::vec3 normal;
+};
+
+// Indexed triangle list
+struct Mesh {
+    std::vector<MeshVertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+// Post-transform vertex cache efficiency of an index buffer
+struct CacheStats {
+    // Average cache miss ratio: vertex shader invocations per triangle (0.5 best, 3 worst)
+    float acmr;
+    // Average transformed vertex ratio: vertex shader invocations per unique vertex (1 best)
+    float atvr;
+};
+
+// What Build() did to the mesh
+struct MeshBuildReport {
+    size_t input_vertices;
+    size_t unique_vertices;
+    size_t triangles;
+    // Cache efficiency of the welded mesh in submission order, and after reordering
+    CacheStats before;
+    CacheStats after;
+};
+
+class MeshBuilder {
+    // Hash of the raw vertex bits so identical vertices land in the same bucket
+    struct VertexHash {
+        size_t operator()(const MeshVertex& v) const;
+    };
+    struct VertexEqual {
+        bool operator()(const MeshVertex& a, const MeshVertex& b) const;
+    };
+
+    Mesh mesh_;
+    // Unique vertex -> its index in mesh_.vertices
+    std::unordered_map<MeshVertex, unsigned int, VertexHash, VertexEqual> vertex_lookup_;
+    // Number of vertices passed to AddVertex, including duplicates
+    size_t input_vertices_;
+public:
+    MeshBuilder() : input_vertices_{} {}
+
+    // Append one corner of a triangle; duplicates reuse the existing index
+    void AddVertex(const MeshVertex& vertex);
+    // Append a non-indexed triangle list of interleaved floats (3 position + 2 tex coord per vertex)
+    // Normals are not part of the input, so each vertex gets the flat normal of its triangle
+    void AddTriangles(const float* data, size_t vertex_count);
+
+    // @return: welded mesh, optionally reordered for the vertex cache and vertex fetch
+    // Fills report if non-null
+    Mesh Build(bool optimize = true, MeshBuildReport* report = nullptr) const;
+};
+
+/* Standalone passes, usable on any indexed triangle list */
+
+// @return: cache efficiency of indices when run through a FIFO cache of cache_size entries
+CacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertex_count, int cache_size = kVertexCacheSize);
+// Reorder triangles in place so consecutive triangles reuse recently transformed vertices (Tipsify)
+void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertex_count, int cache_size = kVertexCacheSize);
+// Renumber vertices in order of first use so the vertex fetch reads memory mostly sequentially
+void OptimizeVertexFetch(Mesh& mesh);
+
+#endif // !MESH_H
@@ -0,0 +1,491 @@
+/*
+Separable CPU mip filtering in linear space
+*/
+
+#include "MipGenerator.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Taps of a 2:1 filter: texel x of the next level is the sum of weights[k] * texel 2x + first + k
+struct MipTaps {
+    int first;
+    int count;
+    float weights[12];
+};
+
+// Conversions between RGBA texels of one channel size and linear RGBA floats, and the two filter passes
+// to_linear / from_linear are the sRGB tables, or nullptr for channels stored linearly
+struct MipKernels {
+    void (*load8)(const uint8_t* texels, int count, const float* to_linear, float* out);
+    void (*load16)(const uint16_t* texels, int count, const float* to_linear, float* out);
+    void (*store8)(const float* texels, int count, const uint8_t* from_linear, uint8_t* out);
+    void (*store16)(const float* texels, int count, const uint16_t* from_linear, uint16_t* out);
+    // out = sum of weights[k] * rows[k] over floats floats
+    void (*filter_rows)(const float* const* rows, const float* weights, int taps, int floats, float* out);
+    // out texel x = sum of taps.weights[k] * row texel clamp(2x + taps.first + k) for x in [0, next_width)
+    void (*filter_row)(const float* row, int width, const MipTaps& taps, int next_width, float* out);
+};
+
+// Scalar reference kernels
+static void LoadTexels8Scalar(const uint8_t* texels, int count, const float* to_linear, float* out);
+static void LoadTexels16Scalar(const uint16_t* texels, int count, const float* to_linear, float* out);
+static void StoreTexels8Scalar(const float* texels, int count, const uint8_t* from_linear, uint8_t* out);
+static void StoreTexels16Scalar(const float* texels, int count, const uint16_t* from_linear, uint16_t* out);
+static void FilterRowsScalar(const float* const* rows, const float* weights, int taps, int floats, float* out);
+static void FilterRowScalar(const float* row, int width, const MipTaps& taps, int next_width, float* out);
+#ifdef SIMD_AVX2
+// 2 texels, or 8 floats, per iteration
+SIMD_TARGET_AVX2 static void LoadTexels8Avx2(const uint8_t* texels, int count, const float* to_linear, float* out);
+SIMD_TARGET_AVX2 static void LoadTexels16Avx2(const uint16_t* texels, int count, const float* to_linear, float* out);
+SIMD_TARGET_AVX2 static void StoreTexels8Avx2(const float* texels, int count, const uint8_t* from_linear, uint8_t* out);
+SIMD_TARGET_AVX2 static void StoreTexels16Avx2(const float* texels, int count, const uint16_t* from_linear, uint16_t* out);
+SIMD_TARGET_AVX2 static void FilterRowsAvx2(const float* const* rows, const float* weights, int taps, int floats, float* out);
+SIMD_TARGET_AVX2 static void FilterRowAvx2(const float* row, int width, const MipTaps& taps, int next_width, float* out);
+#endif
+// Texels [begin, end) of FilterRowScalar; the AVX2 kernel leaves it the edges, where taps clamp
+static void FilterTexels(const float* row, int width, const MipTaps& taps, int begin, int end, float* out);
+// @return: kernels of level, scalar where the build has no AVX2
+static MipKernels GetMipKernels(SimdLevel level);
+// @return: normalized taps of filter
+static MipTaps MakeMipTaps(MipFilter filter);
+// Filter rows [begin, end) of the next level
+static void FilterLevelRows(const void* pixels, int width, int height, int components, int channel_bytes, const MipOptions& options,
+    const MipKernels& kernels, const MipTaps& taps, int next_width, int begin, int end, void* next);
+
+// sRGB transfer functions on [0, 1]
+static float SrgbToLinear(float value);
+static float LinearToSrgb(float value);
+// Decode tables of 256 and 65536 entries, and encode tables indexed by round(sqrt(linear) * 65535),
+// which spends the entries where sRGB is steepest, near black. The encode tables have spare entries
+// at the end, so the AVX2 kernels can gather 32 bits from the last one
+static const float* GetSrgb8ToLinear();
+static const float* GetSrgb16ToLinear();
+static const uint8_t* GetLinearToSrgb8();
+static const uint16_t* GetLinearToSrgb16();
+
+// Rows of the next level filtered together, sharing the conversion of the source rows they read
+static const int kMipRowsPerBand{ 8 };
+// Rows of the next level per job
+static const size_t kMipRowsPerJob{ 16 };
+// Radius of the windowed sinc filters, in texels of the next level
+static const float kSincRadius{ 3.f };
+// Kaiser window shape; higher trades sharpness for less ringing
+static const float kKaiserAlpha{ 4.f };
+static const int kSrgbEncodeEntries{ 65536 };
+
+// @return: short name of filter for reports
+const char* GetMipFilterName(MipFilter filter) {
+    switch (filter) {
+        case MipFilter::kBox: return "box";
+        case MipFilter::kKaiser: return "Kaiser";
+        case MipFilter::kLanczos: return "Lanczos";
+    }
+    return "unknown";
+}
+
+// Write the next mip level of a width x height image, max(1, width / 2) x max(1, height / 2), to next
+void GenerateMipLevel(const void* pixels, int width, int height, int components, int channel_bytes,
+    const MipOptions& options, void* next) {
+    const MipKernels kernels{ GetMipKernels(options.level) };
+    const MipTaps taps{ MakeMipTaps(options.filter) };
+    const int next_width{ std::max(1, width / 2) };
+    const int next_height{ std::max(1, height / 2) };
+    auto filter_rows = [&](size_t begin, size_t end) {
+        FilterLevelRows(pixels, width, height, components, channel_bytes, options, kernels, taps, next_width,
+            static_cast<int>(begin), static_cast<int>(end), next);
+    };
+    if (options.jobs) {
+        options.jobs->ParallelFor(static_cast<size_t>(next_height), filter_rows, kMipRowsPerJob);
+    }
+    else {
+        filter_rows(0, static_cast<size_t>(next_height));
+    }
+}
+
+// @return: every level after the first, down to 1x1, each laid out like pixels
+std::vector<std::vector<unsigned char>> GenerateMipChain(const void* pixels, int width, int height, int components,
+    int channel_bytes, const MipOptions& options) {
+    std::vector<std::vector<unsigned char>> chain;
+    const void* level{ pixels };
+    while (width > 1 || height > 1) {
+        int next_width{ std::max(1, width / 2) };
+        int next_height{ std::max(1, height / 2) };
+        chain.emplace_back(static_cast<size_t>(next_width) * next_height * components * channel_bytes);
+        GenerateMipLevel(level, width, height, components, channel_bytes, options, chain.back().data());
+        level = chain.back().data();
+        width = next_width;
+        height = next_height;
+    }
+    return chain;
+}
+
+/* Non-member helper implementation */
+
+// @return: kernels of level, scalar where the build has no AVX2
+MipKernels GetMipKernels(SimdLevel level) {
+#ifdef SIMD_AVX2
+    if (level == SimdLevel::kAvx2) {
+        return MipKernels{ LoadTexels8Avx2, LoadTexels16Avx2, StoreTexels8Avx2, StoreTexels16Avx2, FilterRowsAvx2, FilterRowAvx2 };
+    }
+#endif
+    return MipKernels{ LoadTexels8Scalar, LoadTexels16Scalar, StoreTexels8Scalar, StoreTexels16Scalar, FilterRowsScalar, FilterRowScalar };
+}
+
+// @return: normalized taps of filter
+// The box covers texels 2x and 2x + 1; the sinc filters are centered between them, at 2x + 1 in texel edge
+// coordinates, and reach kSincRadius texels of the next level (twice as many of this one) each side
+MipTaps MakeMipTaps(MipFilter filter) {
+    MipTaps taps{};
+    if (filter == MipFilter::kBox) {
+        taps.first = 0;
+        taps.count = 2;
+        taps.weights[0] = taps.weights[1] = 0.5f;
+        return taps;
+    }
+    const double kPi{ 3.14159265358979323846 };
+    auto sinc = [kPi](double x) { return x == 0. ? 1. : std::sin(kPi * x) / (kPi * x); };
+    // Modified Bessel function of the first kind, order 0
+    auto bessel_i0 = [](double x) {
+        double sum{ 1. }, term{ 1. };
+        for (int k{ 1 }; k < 32; ++k) {
+            term *= (x / (2. * k)) * (x / (2. * k));
+            sum += term;
+        }
+        return sum;
+    };
+    taps.count = static_cast<int>(4.f * kSincRadius);
+    taps.first = 1 - taps.count / 2;
+    double sum{};
+    double weights[12];
+    for (int k{}; k < taps.count; ++k) {
+        // Distance of texel center 2x + first + k + 0.5 from 2x + 1, in texels of the next level
+        double t{ (taps.first + k - 0.5) / 2. };
+        double window{};
+        if (filter == MipFilter::kLanczos) {
+            window = sinc(t / kSincRadius);
+        }
+        else {
+            double r{ t / kSincRadius };
+            window = bessel_i0(kKaiserAlpha * std::sqrt(std::max(0., 1. - r * r))) / bessel_i0(kKaiserAlpha);
+        }
+        weights[k] = sinc(t) * window;
+        sum += weights[k];
+    }
+    for (int k{}; k < taps.count; ++k) {
+        taps.weights[k] = static_cast<float>(weights[k] / sum);
+    }
+    return taps;
+}
+
+// Filter rows [begin, end) of the next level
+// Works in bands of kMipRowsPerBand rows: the source rows a band reads are converted to linear RGBA once,
+// then each row is filtered vertically into one full width row and that horizontally into the output
+void FilterLevelRows(const void* pixels, int width, int height, int components, int channel_bytes, const MipOptions& options,
+    const MipKernels& kernels, const MipTaps& taps, int next_width, int begin, int end, void* next) {
+    const float* to_linear{ !options.srgb ? nullptr : channel_bytes == 1 ? GetSrgb8ToLinear() : GetSrgb16ToLinear() };
+    const uint8_t* from_linear8{ options.srgb && channel_bytes == 1 ? GetLinearToSrgb8() : nullptr };
+    const uint16_t* from_linear16{ options.srgb && channel_bytes == 2 ? GetLinearToSrgb16() : nullptr };
+    // Channel of each component in the RGBA the kernels work on; grey + alpha keeps alpha in A, so it stays linear
+    static const int kLanes[4][4]{ { 0 }, { 0, 3 }, { 0, 1, 2 }, { 0, 1, 2, 3 } };
+    const int* lanes{ kLanes[components - 1] };
+    const size_t row_bytes{ static_cast<size_t>(width) * components * channel_bytes };
+    const size_t next_row_bytes{ static_cast<size_t>(next_width) * components * channel_bytes };
+
+    const int max_rows{ 2 * kMipRowsPerBand + taps.count };
+    std::vector<float> source(static_cast<size_t>(max_rows) * width * 4);
+    std::vector<float> filtered(static_cast<size_t>(width) * 4), output(static_cast<size_t>(next_width) * 4);
+    // RGBA texels of one channel size, for rows with fewer components
+    std::vector<uint16_t> expanded(static_cast<size_t>(std::max(width, next_width)) * 4);
+    const float* rows[12];
+
+    for (int band{ begin }; band < end; band += kMipRowsPerBand) {
+        int band_end{ std::min(end, band + kMipRowsPerBand) };
+        int first_row{ std::max(0, 2 * band + taps.first) };
+        int last_row{ std::min(height - 1, 2 * (band_end - 1) + taps.first + taps.count - 1) };
+        for (int y{ first_row }; y <= last_row; ++y) {
+            const unsigned char* row{ static_cast<const unsigned char*>(pixels) + y * row_bytes };
+            float* converted{ source.data() + static_cast<size_t>(y - first_row) * width * 4 };
+            if (components != 4) {
+                std::fill(expanded.begin(), expanded.end(), uint16_t{});
+                uint8_t* expanded8{ reinterpret_cast<uint8_t*>(expanded.data()) };
+                for (int x{}; x < width; ++x) {
+                    for (int c{}; c < components; ++c) {
+                        if (channel_bytes == 1) {
+                            expanded8[x * 4 + lanes[c]] = row[x * components + c];
+                        }
+                        else {
+                            memcpy(&expanded[x * 4 + lanes[c]], row + (x * components + c) * 2, 2);
+                        }
+                    }
+                }
+                row = reinterpret_cast<const unsigned char*>(expanded.data());
+            }
+            if (channel_bytes == 1) {
+                kernels.load8(row, width, to_linear, converted);
+            }
+            else {
+                kernels.load16(reinterpret_cast<const uint16_t*>(row), width, to_linear, converted);
+            }
+        }
+
+        for (int y{ band }; y < band_end; ++y) {
+            for (int k{}; k < taps.count; ++k) {
+                int source_row{ std::min(last_row, std::max(first_row, 2 * y + taps.first + k)) };
+                rows[k] = source.data() + static_cast<size_t>(source_row - first_row) * width * 4;
+            }
+            kernels.filter_rows(rows, taps.weights, taps.count, width * 4, filtered.data());
+            kernels.filter_row(filtered.data(), width, taps, next_width, output.data());
+
+            unsigned char* next_row{ static_cast<unsigned char*>(next) + y * next_row_bytes };
+            unsigned char* stored{ components == 4 ? next_row : reinterpret_cast<unsigned char*>(expanded.data()) };
+            if (channel_bytes == 1) {
+                kernels.store8(output.data(), next_width, from_linear8, stored);
+            }
+            else {
+                kernels.store16(output.data(), next_width, from_linear16, reinterpret_cast<uint16_t*>(stored));
+            }
+            if (components != 4) {
+                for (int x{}; x < next_width; ++x) {
+                    for (int c{}; c < components; ++c) {
+                        memcpy(next_row + (x * components + c) * channel_bytes, stored + (x * 4 + lanes[c]) * channel_bytes, channel_bytes);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// sRGB transfer functions on [0, 1]
+float SrgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float LinearToSrgb(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+}
+
+const float* GetSrgb8ToLinear() {
+    static const std::vector<float> table{ [] {
+        std::vector<float> values(256);
+        for (int i{}; i < 256; ++i) {
+            values[i] = SrgbToLinear(i / 255.f);
+        }
+        return values;
+    }() };
+    return table.data();
+}
+
+const float* GetSrgb16ToLinear() {
+    static const std::vector<float> table{ [] {
+        std::vector<float> values(65536);
+        for (int i{}; i < 65536; ++i) {
+            values[i] = SrgbToLinear(i / 65535.f);
+        }
+        return values;
+    }() };
+    return table.data();
+}
+
+const uint8_t* GetLinearToSrgb8() {
+    static const std::vector<uint8_t> table{ [] {
+        std::vector<uint8_t> values(kSrgbEncodeEntries + 3);
+        for (int i{}; i < kSrgbEncodeEntries; ++i) {
+            float linear{ static_cast<float>(i) / (kSrgbEncodeEntries - 1) };
+            values[i] = static_cast<uint8_t>(LinearToSrgb(linear * linear) * 255.f + 0.5f);
+        }
+        return values;
+    }() };
+    return table.data();
+}
+
+const uint16_t* GetLinearToSrgb16() {
+    static const std::vector<uint16_t> table{ [] {
+        std::vector<uint16_t> values(kSrgbEncodeEntries + 1);
+        for (int i{}; i < kSrgbEncodeEntries; ++i) {
+            float linear{ static_cast<float>(i) / (kSrgbEncodeEntries - 1) };
+            values[i] = static_cast<uint16_t>(LinearToSrgb(linear * linear) * 65535.f + 0.5f);
+        }
+        return values;
+    }() };
+    return table.data();
+}
+
+// Alpha (the fourth float of each texel) never goes through the sRGB tables
+void LoadTexels8Scalar(const uint8_t* texels, int count, const float* to_linear, float* out) {
+    for (int i{}; i < count * 4; ++i) {
+        out[i] = to_linear && i % 4 != 3 ? to_linear[texels[i]] : texels[i] * (1.f / 255.f);
+    }
+}
+
+void LoadTexels16Scalar(const uint16_t* texels, int count, const float* to_linear, float* out) {
+    for (int i{}; i < count * 4; ++i) {
+        out[i] = to_linear && i % 4 != 3 ? to_linear[texels[i]] : texels[i] * (1.f / 65535.f);
+    }
+}
+
+// Filters with negative lobes overshoot, so values are clamped to [0, 1] first
+void StoreTexels8Scalar(const float* texels, int count, const uint8_t* from_linear, uint8_t* out) {
+    for (int i{}; i < count * 4; ++i) {
+        float value{ std::min(1.f, std::max(0.f, texels[i])) };
+        if (from_linear && i % 4 != 3) {
+            out[i] = from_linear[static_cast<int>(std::sqrt(value) * (kSrgbEncodeEntries - 1) + 0.5f)];
+        }
+        else {
+            out[i] = static_cast<uint8_t>(static_cast<int>(value * 255.f + 0.5f));
+        }
+    }
+}
+
+void StoreTexels16Scalar(const float* texels, int count, const uint16_t* from_linear, uint16_t* out) {
+    for (int i{}; i < count * 4; ++i) {
+        float value{ std::min(1.f, std::max(0.f, texels[i])) };
+        if (from_linear && i % 4 != 3) {
+            out[i] = from_linear[static_cast<int>(std::sqrt(value) * (kSrgbEncodeEntries - 1) + 0.5f)];
+        }
+        else {
+            out[i] = static_cast<uint16_t>(static_cast<int>(value * 65535.f + 0.5f));
+        }
+    }
+}
+
+void FilterRowsScalar(const float* const* rows, const float* weights, int taps, int floats, float* out) {
+    for (int i{}; i < floats; ++i) {
+        float sum{ weights[0] * rows[0][i] };
+        for (int k{ 1 }; k < taps; ++k) {
+            sum = sum + weights[k] * rows[k][i];
+        }
+        out[i] = sum;
+    }
+}
+
+void FilterRowScalar(const float* row, int width, const MipTaps& taps, int next_width, float* out) {
+    FilterTexels(row, width, taps, 0, next_width, out);
+}
+
+// Texels [begin, end) of FilterRowScalar
+void FilterTexels(const float* row, int width, const MipTaps& taps, int begin, int end, float* out) {
+    for (int x{ begin }; x < end; ++x) {
+        for (int c{}; c < 4; ++c) {
+            float sum{};
+            for (int k{}; k < taps.count; ++k) {
+                int source{ std::min(width - 1, std::max(0, 2 * x + taps.first + k)) };
+                float term{ taps.weights[k] * row[source * 4 + c] };
+                sum = k == 0 ? term : sum + term;
+            }
+            out[x * 4 + c] = sum;
+        }
+    }
+}
+
+#ifdef SIMD_AVX2
+// Lanes 3 and 7 hold alpha
+static const int kAlphaLanes{ 0x88 };
+
+SIMD_TARGET_AVX2 void LoadTexels8Avx2(const uint8_t* texels, int count, const float* to_linear, float* out) {
+    const __m256 scale{ _mm256_set1_ps(1.f / 255.f) };
+    int i{};
+    for (; i + 2 <= count; i += 2) {
+        __m256i values{ _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(texels + i * 4))) };
+        __m256 linear{ _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale) };
+        if (to_linear) {
+            linear = _mm256_blend_ps(_mm256_i32gather_ps(to_linear, values, 4), linear, kAlphaLanes);
+        }
+        _mm256_storeu_ps(out + i * 4, linear);
+    }
+    LoadTexels8Scalar(texels + i * 4, count - i, to_linear, out + i * 4);
+}
+
+SIMD_TARGET_AVX2 void LoadTexels16Avx2(const uint16_t* texels, int count, const float* to_linear, float* out) {
+    const __m256 scale{ _mm256_set1_ps(1.f / 65535.f) };
+    int i{};
+    for (; i + 2 <= count; i += 2) {
+        __m256i values{ _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(texels + i * 4))) };
+        __m256 linear{ _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale) };
+        if (to_linear) {
+            linear = _mm256_blend_ps(_mm256_i32gather_ps(to_linear, values, 4), linear, kAlphaLanes);
+        }
+        _mm256_storeu_ps(out + i * 4, linear);
+    }
+    LoadTexels16Scalar(texels + i * 4, count - i, to_linear, out + i * 4);
+}
+
+// Quantize 8 floats to 0..max, through the encode table (entries of entry_bytes, gathered 32 bits at a time) for color lanes
+SIMD_TARGET_AVX2 static inline __m256i QuantizeAvx2(__m256 values, float max, const void* from_linear, int entry_bytes) {
+    values = _mm256_min_ps(_mm256_set1_ps(1.f), _mm256_max_ps(values, _mm256_setzero_ps()));
+    __m256i quantized{ _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(values, _mm256_set1_ps(max)), _mm256_set1_ps(0.5f))) };
+    if (!from_linear) {
+        return quantized;
+    }
+    __m256i index{ _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sqrt_ps(values),
+        _mm256_set1_ps(static_cast<float>(kSrgbEncodeEntries - 1))), _mm256_set1_ps(0.5f))) };
+    __m256i encoded{ entry_bytes == 1
+        ? _mm256_and_si256(_mm256_i32gather_epi32(static_cast<const int*>(from_linear), index, 1), _mm256_set1_epi32(0xFF))
+        : _mm256_and_si256(_mm256_i32gather_epi32(static_cast<const int*>(from_linear), index, 2), _mm256_set1_epi32(0xFFFF)) };
+    return _mm256_blend_epi32(encoded, quantized, kAlphaLanes);
+}
+
+SIMD_TARGET_AVX2 void StoreTexels8Avx2(const float* texels, int count, const uint8_t* from_linear, uint8_t* out) {
+    int i{};
+    for (; i + 2 <= count; i += 2) {
+        __m256i values{ QuantizeAvx2(_mm256_loadu_ps(texels + i * 4), 255.f, from_linear, 1) };
+        // Each 128 bit lane packs its 4 values into its low 4 bytes
+        values = _mm256_packus_epi16(_mm256_packus_epi32(values, values), values);
+        int low{ _mm_cvtsi128_si32(_mm256_castsi256_si128(values)) };
+        int high{ _mm_cvtsi128_si32(_mm256_extracti128_si256(values, 1)) };
+        memcpy(out + i * 4, &low, 4);
+        memcpy(out + i * 4 + 4, &high, 4);
+    }
+    StoreTexels8Scalar(texels + i * 4, count - i, from_linear, out + i * 4);
+}
+
+SIMD_TARGET_AVX2 void StoreTexels16Avx2(const float* texels, int count, const uint16_t* from_linear, uint16_t* out) {
+    int i{};
+    for (; i + 2 <= count; i += 2) {
+        __m256i values{ QuantizeAvx2(_mm256_loadu_ps(texels + i * 4), 65535.f, from_linear, 2) };
+        values = _mm256_packus_epi32(values, values);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i * 4), _mm256_castsi256_si128(values));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i * 4 + 4), _mm256_extracti128_si256(values, 1));
+    }
+    StoreTexels16Scalar(texels + i * 4, count - i, from_linear, out + i * 4);
+}
+
+SIMD_TARGET_AVX2 void FilterRowsAvx2(const float* const* rows, const float* weights, int taps, int floats, float* out) {
+    int i{};
+    for (; i + 8 <= floats; i += 8) {
+        __m256 sum{ _mm256_mul_ps(_mm256_set1_ps(weights[0]), _mm256_loadu_ps(rows[0] + i)) };
+        for (int k{ 1 }; k < taps; ++k) {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i)));
+        }
+        _mm256_storeu_ps(out + i, sum);
+    }
+    const float* tails[12];
+    for (int k{}; k < taps; ++k) {
+        tails[k] = rows[k] + i;
+    }
+    FilterRowsScalar(tails, weights, taps, floats - i, out + i);
+}
+
+// Texels x and x + 1 per iteration, each tap one 128 bit load per texel; the edges, where taps clamp, are scalar
+SIMD_TARGET_AVX2 void FilterRowAvx2(const float* row, int width, const MipTaps& taps, int next_width, float* out) {
+    // Interior: 2x + first >= 0 and 2(x + 1) + first + count - 1 <= width - 1
+    int begin{ std::min(next_width, std::max(0, (1 - taps.first) / 2)) };
+    int end{ begin };
+    for (int x{ begin }; x + 1 < next_width && 2 * (x + 1) + taps.first + taps.count - 1 <= width - 1; x += 2) {
+        const float* source{ row + (2 * x + taps.first) * 4 };
+        __m256 sum{};
+        for (int k{}; k < taps.count; ++k) {
+            __m256 texels{ _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(source + k * 4)), _mm_loadu_ps(source + k * 4 + 8), 1) };
+            __m256 term{ _mm256_mul_ps(_mm256_set1_ps(taps.weights[k]), texels) };
+            sum = k == 0 ? term : _mm256_add_ps(sum, term);
+        }
+        _mm256_storeu_ps(out + x * 4, sum);
+        end = x + 2;
+    }
+    FilterTexels(row, width, taps, 0, begin, out);
+    FilterTexels(row, width, taps, end, next_width, out);
+}
+#endif // SIMD_AVX2
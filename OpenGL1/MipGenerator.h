@@ -0,0 +1,53 @@
+/*
+CPU mip chain generation, so mips can be built off the GL thread (on the streamer's decode
+threads, or once by the baker) instead of by glGenerateMipmap, whose filter and speed are up to
+the driver.
+
+Each level is filtered from the one above it, separably: every output row is a weighted sum of
+source rows, then every output texel a weighted sum of texels of that row. Filters:
+    box      2x2 average, what glGenerateMipmap does on most drivers
+    Kaiser   Kaiser windowed sinc over 3 texels of the smaller level each side; sharper, little ringing
+    Lanczos  Lanczos-3; sharpest, rings a little on hard edges
+sRGB encoded color is decoded to linear light before filtering and encoded again afterwards,
+so a black and white checkerboard averages to sRGB 188 rather than a too dark 128. Alpha is
+always filtered as stored.
+
+Texels are filtered as linear RGBA floats. The conversions to and from 8 and 16 bit channels
+and both filter passes have AVX2 kernels, picked like the culling kernels, which write the same
+bytes as the scalar ones. Rows of a level are spread over a JobSystem when one is given.
+*/
+
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include "Simd.h"
+
+#include <vector>
+
+class JobSystem;
+
+enum class MipFilter { kBox, kKaiser, kLanczos };
+
+// How levels are filtered
+struct MipOptions {
+    MipFilter filter{ MipFilter::kBox };
+    // The color channels are sRGB encoded, as in photos and most color textures; false for data
+    // such as normal maps. Alpha, and the second channel of grey + alpha images, is always linear
+    bool srgb{};
+    // Spreads the rows of each level over its threads; may be nullptr
+    JobSystem* jobs{};
+    SimdLevel level{ GetBestSimdLevel() };
+};
+
+// @return: short name of filter for reports
+const char* GetMipFilterName(MipFilter filter);
+// Write the next mip level of a width x height image, max(1, width / 2) x max(1, height / 2), to next
+// Texels have components (1-4) channels of channel_bytes (1 or 2) each, rows tightly packed;
+// next is laid out the same way. Odd last rows and columns are clamped at the edge
+void GenerateMipLevel(const void* pixels, int width, int height, int components, int channel_bytes,
+    const MipOptions& options, void* next);
+// @return: every level after the first, down to 1x1, each laid out like pixels
+std::vector<std::vector<unsigned char>> GenerateMipChain(const void* pixels, int width, int height, int components,
+    int channel_bytes, const MipOptions& options);
+
+#endif // !MIP_GENERATOR_H
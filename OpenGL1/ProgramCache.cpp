@@ -0,0 +1,149 @@
+/*
+On-disk cache of linked program binaries
+*/
+
+#include "ProgramCache.h"
+#include "Hash.h"
+
+#include <glad/glad.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// File layout: header, then length bytes of binary
+struct ProgramBinaryHeader {
+    uint32_t magic;
+    // GL binary format token from glGetProgramBinary
+    uint32_t format;
+    // Full key, so two keys sharing a file name can never load each other's binary
+    uint64_t key;
+    uint32_t length;
+    uint32_t padding;
+};
+
+// "PBC1"
+static const uint32_t kProgramBinaryMagic{ 0x31434250u };
+
+// Create directory if it does not exist yet
+static void MakeDirectory(const std::string& directory);
+
+/* ProgramCache implementation */
+
+// Needs a current GL context; the directory is created if missing
+ProgramCache::ProgramCache(const char* directory, bool load_enabled) :
+    directory_{ directory },
+    device_hash_{ kHashSeed },
+    supported_{ false },
+    load_enabled_{ load_enabled },
+    stats_{} {
+    if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary) {
+        int format_count{};
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+        supported_ = format_count > 0;
+    }
+    if (!supported_) {
+        std::cout << "Program binary cache: driver has no program binary formats, always compiling" << std::endl;
+        return;
+    }
+
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+        const char* value{ reinterpret_cast<const char*>(glGetString(name)) };
+        std::string text{ value ? value : "" };
+        // Include the terminator so "ab" + "c" and "a" + "bc" differ
+        device_hash_ = HashBytes(device_hash_, text.c_str(), text.size() + 1);
+    }
+    MakeDirectory(directory_);
+}
+
+// @return: linked program created from the cached binary, or 0 on a miss or rejection
+unsigned int ProgramCache::Load(uint64_t key) {
+    if (!supported_ || !load_enabled_) {
+        return 0;
+    }
+    std::string path{ GetPath(key) };
+    std::ifstream file{ path, std::ios::binary };
+    ProgramBinaryHeader header{};
+    if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != kProgramBinaryMagic || header.key != key) {
+        ++stats_.misses;
+        return 0;
+    }
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size())) {
+        ++stats_.misses;
+        return 0;
+    }
+    file.close();
+
+    unsigned int program{ glCreateProgram() };
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+    int linked{};
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // Expected after driver updates; drop the entry so it is rebuilt once
+        glDeleteProgram(program);
+        std::remove(path.c_str());
+        ++stats_.rejected;
+        return 0;
+    }
+    ++stats_.hits;
+    return program;
+}
+
+// Call between glCreateProgram and glLinkProgram for programs that will be stored
+// Without the hint some drivers return an empty binary
+void ProgramCache::PrepareForStore(unsigned int program) const {
+    if (supported_) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+// Write the binary of a successfully linked program
+void ProgramCache::Store(uint64_t key, unsigned int program) {
+    if (!supported_) {
+        return;
+    }
+    int length{};
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format{};
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    ProgramBinaryHeader header{ kProgramBinaryMagic, format, key, static_cast<uint32_t>(length), 0 };
+    std::string path{ GetPath(key) };
+    std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+    if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) || !file.write(binary.data(), length)) {
+        std::cout << "ERROR [PROGRAM CACHE WRITE FAILED]\n" << path << std::endl;
+        return;
+    }
+    ++stats_.stores;
+}
+
+// @return: file an entry is stored in
+std::string ProgramCache::GetPath(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", static_cast<unsigned long long>(key));
+    return directory_ + name;
+}
+
+/* Non-member helper implementation */
+
+// Create directory if it does not exist yet
+void MakeDirectory(const std::string& directory) {
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+}
@@ -0,0 +1,57 @@
+/*
+On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary, core in 4.1,
+ARB_get_program_binary before that), so shaders are compiled once per driver instead of once per launch.
+
+Entries are keyed by a 64 bit FNV-1a hash of the program's sources and the GL_VENDOR, GL_RENDERER
+and GL_VERSION strings, so a driver update or a different GPU never loads a stale binary.
+Drivers may still reject a binary (e.g. after an update that kept the version string); such entries
+are deleted and the caller compiles from source as usual.
+*/
+
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// What the cache did since it was created
+struct ProgramCacheStats {
+    size_t hits;
+    size_t misses;
+    // Binaries found on disk but refused by the driver
+    size_t rejected;
+    size_t stores;
+};
+
+class ProgramCache {
+    std::string directory_;
+    // Hash of the vendor/renderer/version strings; every key starts from it
+    uint64_t device_hash_;
+    // Driver exposes at least one binary format
+    bool supported_;
+    // false: never load, only store; used to measure or force cold builds
+    bool load_enabled_;
+    ProgramCacheStats stats_;
+
+    // @return: file an entry is stored in
+    std::string GetPath(uint64_t key) const;
+public:
+    // Needs a current GL context; the directory is created if missing
+    explicit ProgramCache(const char* directory = "shader_cache", bool load_enabled = true);
+
+    // @return: key every program on this GL device and driver starts from; continue it over each
+    // stage's source with HashBytes (Hash.h), in stage order and ending each stage with its terminator
+    uint64_t GetDeviceKey() const { return device_hash_; }
+    // @return: linked program created from the cached binary, or 0 on a miss or rejection
+    unsigned int Load(uint64_t key);
+    // Call between glCreateProgram and glLinkProgram for programs that will be stored
+    void PrepareForStore(unsigned int program) const;
+    // Write the binary of a successfully linked program
+    void Store(uint64_t key, unsigned int program);
+
+    bool IsSupported() const { return supported_; }
+    const ProgramCacheStats& GetStats() const { return stats_; }
+};
+
+#endif // !PROGRAM_CACHE_H
@@ -0,0 +1,272 @@
+/*
+Render queue: sorts submitted draw packets by state and merges them into instanced draws
+*/
+
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "Hash.h"
+#include "JobSystem.h"
+#include "StreamBuffer.h"
+#include "VertexLayout.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+// Key field widths; see RenderQueue.h for the layout
+static const int kDepthBits{ 20 };
+static const int kVaoBits{ 12 };
+static const int kTextureSetBits{ 16 };
+static const int kProgramBits{ 12 };
+static const int kLayerBits{ 4 };
+
+// Below this many packets a single thread sorts faster than it takes to hand out jobs
+static const size_t kParallelSortThreshold{ 16384 };
+// Texture set table slots to start with; doubled whenever it becomes half full
+static const size_t kInitialTextureSetSlots{ 64 };
+
+// @return: FNV-1a hash of the texture names of a set
+static size_t HashTextureSet(const std::array<unsigned int, kMaxPacketTextures>& textures);
+// @return: true if a and b can be drawn without any state change in between
+static bool SameState(const DrawPacket& a, const DrawPacket& b);
+// @return: number of GL binds needed to go from prev (or nothing) to next
+static size_t CountStateChanges(const DrawPacket* prev, const DrawPacket& next);
+
+/* RenderQueue implementation */
+
+// far_plane: depth at which the key's depth bits saturate
+RenderQueue::RenderQueue(float far_plane, JobSystem* jobs) :
+    texture_sets_(kInitialTextureSetSlots, TextureSetSlot{}),
+    texture_set_count_{},
+    texture_set_generation_{ 1 }, // slots start at generation 0, so all are empty
+    jobs_{ jobs },
+    far_plane_{ far_plane },
+    stats_{} {}
+
+// Queue a packet for this frame
+void RenderQueue::Submit(const DrawPacket& packet) {
+    auto field = [](uint64_t value, int bits) { return value & ((uint64_t{ 1 } << bits) - 1); };
+
+    // Front to back: nearer packets get smaller keys
+    float depth_fraction{ glm::clamp(packet.depth / far_plane_, 0.f, 1.f) };
+    uint64_t depth{ static_cast<uint64_t>(depth_fraction * ((1 << kDepthBits) - 1)) };
+
+    uint64_t key{ field(packet.layer, kLayerBits) };
+    key = (key << kProgramBits) | field(packet.program, kProgramBits);
+    key = (key << kTextureSetBits) | field(GetTextureSetId(packet), kTextureSetBits);
+    key = (key << kVaoBits) | field(packet.vao, kVaoBits);
+    key = (key << kDepthBits) | depth;
+
+    keys_.push_back(key);
+    order_.push_back(static_cast<uint32_t>(packets_.size()));
+    packets_.push_back(packet);
+}
+
+// @return: dense id of the packet's texture set in this frame
+unsigned int RenderQueue::GetTextureSetId(const DrawPacket& packet) {
+    TextureSet textures;
+    std::copy(packet.textures, packet.textures + kMaxPacketTextures, textures.begin());
+    const size_t mask{ texture_sets_.size() - 1 };
+    for (size_t i{ HashTextureSet(textures) & mask };; i = (i + 1) & mask) {
+        TextureSetSlot& slot{ texture_sets_[i] };
+        if (slot.generation == texture_set_generation_) {
+            if (slot.textures == textures) {
+                return slot.id;
+            }
+            continue;
+        }
+        // Sets past the last id the key can hold share it
+        const unsigned int max_id{ (1u << kTextureSetBits) - 1 };
+        unsigned int id{ static_cast<unsigned int>(std::min<size_t>(texture_set_count_, max_id)) };
+        slot = TextureSetSlot{ textures, id, texture_set_generation_ };
+        if (++texture_set_count_ * 2 > texture_sets_.size()) {
+            GrowTextureSets();
+        }
+        return id;
+    }
+}
+
+// Double the texture set table, keeping this frame's entries
+void RenderQueue::GrowTextureSets() {
+    std::vector<TextureSetSlot> old_slots(texture_sets_.size() * 2, TextureSetSlot{});
+    old_slots.swap(texture_sets_);
+    const size_t mask{ texture_sets_.size() - 1 };
+    for (const TextureSetSlot& old_slot : old_slots) {
+        if (old_slot.generation != texture_set_generation_) {
+            continue;
+        }
+        size_t i{ HashTextureSet(old_slot.textures) & mask };
+        while (texture_sets_[i].generation == texture_set_generation_) {
+            i = (i + 1) & mask;
+        }
+        texture_sets_[i] = old_slot;
+    }
+}
+
+// Stable LSD radix sort of keys_/order_ by key, 8 bits per pass
+// Each pass: every thread histograms its chunk, per-thread bucket offsets come from a prefix sum
+// over (digit, thread), then every thread scatters its chunk; chunk order keeps the sort stable
+void RenderQueue::Sort() {
+    const size_t count{ keys_.size() };
+    scratch_keys_.resize(count);
+    scratch_order_.resize(count);
+
+    size_t thread_count{ 1 };
+    if (jobs_ && count >= kParallelSortThreshold) {
+        thread_count = std::max<size_t>(1, std::min<size_t>(jobs_->GetThreadCount(), count / (kParallelSortThreshold / 4)));
+    }
+    size_t chunk{ (count + thread_count - 1) / thread_count };
+
+    std::vector<std::array<size_t, 256>> histograms(thread_count);
+
+    // One job per chunk; the passes depend on every chunk's result, so each one waits for all
+    auto run_parallel = [&](auto&& body) {
+        if (thread_count == 1) {
+            body(0);
+            return;
+        }
+        jobs_->ParallelFor(thread_count, [&body](size_t begin, size_t end) {
+            for (size_t t{ begin }; t < end; ++t) { body(t); }
+        }, 1);
+    };
+
+    for (int shift{}; shift < 64; shift += 8) {
+        // Histogram
+        run_parallel([&](size_t t) {
+            std::array<size_t, 256>& histogram{ histograms[t] };
+            histogram.fill(0);
+            size_t end{ std::min(count, (t + 1) * chunk) };
+            for (size_t i{ t * chunk }; i < end; ++i) {
+                ++histogram[(keys_[i] >> shift) & 0xff];
+            }
+        });
+
+        // Skip the pass if every key has the same digit; common for the layer/program bytes
+        bool single_bucket{ false };
+        for (int digit{}; digit < 256; ++digit) {
+            size_t total{};
+            for (size_t t{}; t < thread_count; ++t) { total += histograms[t][digit]; }
+            if (total == count) { single_bucket = true; }
+            if (total != 0) { break; }
+        }
+        if (single_bucket) { continue; }
+
+        // Exclusive prefix sum in (digit, thread) order turns counts into write offsets
+        size_t offset{};
+        for (int digit{}; digit < 256; ++digit) {
+            for (size_t t{}; t < thread_count; ++t) {
+                size_t bucket_count{ histograms[t][digit] };
+                histograms[t][digit] = offset;
+                offset += bucket_count;
+            }
+        }
+
+        // Scatter
+        run_parallel([&](size_t t) {
+            std::array<size_t, 256>& write{ histograms[t] };
+            size_t end{ std::min(count, (t + 1) * chunk) };
+            for (size_t i{ t * chunk }; i < end; ++i) {
+                size_t dst{ write[(keys_[i] >> shift) & 0xff]++ };
+                scratch_keys_[dst] = keys_[i];
+                scratch_order_[dst] = order_[i];
+            }
+        });
+        keys_.swap(scratch_keys_);
+        order_.swap(scratch_order_);
+    }
+}
+
+// Sort, merge and draw every queued packet, then clear the queue
+void RenderQueue::Execute(StreamBuffer& stream, const VertexLayout& instance_layout) {
+    stats_ = RenderQueueStats{};
+    stats_.packets = packets_.size();
+
+    // Baseline: what issuing the packets as submitted, one draw each, would have cost
+    const DrawPacket* prev{ nullptr };
+    for (const DrawPacket& packet : packets_) {
+        stats_.naive_state_changes += CountStateChanges(prev, packet);
+        prev = &packet;
+    }
+    stats_.naive_draw_calls = packets_.size();
+
+    Sort();
+
+    // Walk runs of packets with identical state; each run becomes one instanced draw
+    prev = nullptr;
+    size_t run_start{};
+    while (run_start < order_.size()) {
+        const DrawPacket& first{ packets_[order_[run_start]] };
+        size_t run_end{ run_start + 1 };
+        while (run_end < order_.size() && SameState(first, packets_[order_[run_end]])) {
+            ++run_end;
+        }
+        size_t instance_count{ run_end - run_start };
+
+        size_t instance_offset;
+        glm::mat4* instances{ static_cast<glm::mat4*>(stream.Allocate(instance_count * sizeof(glm::mat4), sizeof(glm::vec4), &instance_offset)) };
+        if (!instances) {
+            // Out of stream space for this frame; drop the rest rather than overwrite in-flight data
+            break;
+        }
+        for (size_t i{ run_start }; i < run_end; ++i) {
+            instances[i - run_start] = packets_[order_[i]].model;
+        }
+        stream.Flush();
+
+        // GLState drops whatever is already bound from the previous run
+        GLState& gl_state{ GLState::GetInstance() };
+        gl_state.UseProgram(first.program);
+        gl_state.BindVertexArray(first.vao);
+        for (int unit{}; unit < kMaxPacketTextures; ++unit) {
+            if (first.textures[unit]) {
+                gl_state.BindTextureUnit(GL_TEXTURE0 + unit, GL_TEXTURE_2D, first.textures[unit]);
+            }
+        }
+        stats_.state_changes += CountStateChanges(prev, first);
+
+        gl_state.BindBuffer(GL_ARRAY_BUFFER, stream.GetId());
+        instance_layout.Apply(instance_offset);
+        glDrawElementsInstanced(GL_TRIANGLES, first.index_count, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(instance_count));
+        ++stats_.draw_calls;
+
+        prev = &first;
+        run_start = run_end;
+    }
+
+    packets_.clear();
+    keys_.clear();
+    order_.clear();
+    // Ids are only compared within a frame, so start the next one with an empty table
+    texture_set_count_ = 0;
+    if (++texture_set_generation_ == 0) {
+        // Wrapped around to the generation of never used slots
+        std::fill(texture_sets_.begin(), texture_sets_.end(), TextureSetSlot{});
+        texture_set_generation_ = 1;
+    }
+}
+
+/* Non-member helper implementation */
+
+// @return: FNV-1a hash of the texture names of a set
+size_t HashTextureSet(const std::array<unsigned int, kMaxPacketTextures>& textures) {
+    return static_cast<size_t>(HashBytes(kHashSeed, textures.data(), sizeof(textures)));
+}
+
+// @return: true if a and b can be drawn without any state change in between
+bool SameState(const DrawPacket& a, const DrawPacket& b) {
+    return a.program == b.program && a.vao == b.vao && a.index_count == b.index_count &&
+        memcmp(a.textures, b.textures, sizeof(a.textures)) == 0;
+}
+
+// @return: number of GL binds needed to go from prev (or nothing) to next
+size_t CountStateChanges(const DrawPacket* prev, const DrawPacket& next) {
+    size_t changes{};
+    if (!prev || prev->program != next.program) { ++changes; }
+    if (!prev || prev->vao != next.vao) { ++changes; }
+    for (int unit{}; unit < kMaxPacketTextures; ++unit) {
+        if (next.textures[unit] && (!prev || prev->textures[unit] != next.textures[unit])) { ++changes; }
+    }
+    return changes;
+}
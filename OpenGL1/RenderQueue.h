@@ -0,0 +1,101 @@
+/*
+Render queue: callers submit draw packets in any order, the queue sorts them by a
+64 bit state key and issues them with as few state changes and draw calls as possible.
+Consecutive packets that share program, VAO, textures and mesh are merged into one instanced draw.
+
+Sort key layout, most significant first:
+    layer (4) | program (12) | texture set (16) | VAO (12) | depth (20)
+so packets are grouped by the most expensive state first and drawn front to back within a group.
+Texture set ids are dense per frame; past 2^16 - 1 distinct sets in a frame the rest share the last
+id, which only costs grouping, since runs are merged by comparing the textures themselves.
+*/
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+class StreamBuffer;
+class VertexLayout;
+
+// Texture units a packet can bind, starting at GL_TEXTURE0
+const int kMaxPacketTextures{ 2 };
+
+// Everything needed to issue one draw
+// Programs drawn through the queue must read their model matrix from the instance attributes
+struct DrawPacket {
+    // 0-15, drawn in ascending order (e.g. opaque, then transparent)
+    unsigned int layer;
+    unsigned int program;
+    unsigned int vao;
+    // GL texture names for units 0..kMaxPacketTextures-1; 0 leaves the unit alone
+    unsigned int textures[kMaxPacketTextures];
+    // Indexed draw of the VAO's element buffer
+    int index_count;
+    glm::mat4 model;
+    // View space distance, used to sort front to back inside a state group
+    float depth;
+};
+
+// What the queue did with the last frame's packets
+struct RenderQueueStats {
+    size_t packets;
+    // Cost of issuing the packets one by one in submission order
+    size_t naive_draw_calls;
+    size_t naive_state_changes;
+    // Cost after sorting and merging
+    size_t draw_calls;
+    size_t state_changes;
+};
+
+class RenderQueue {
+    using TextureSet = std::array<unsigned int, kMaxPacketTextures>;
+    // Open addressing slot of the texture set table; empty unless generation matches the frame's
+    struct TextureSetSlot {
+        TextureSet textures;
+        unsigned int id;
+        uint32_t generation;
+    };
+
+    std::vector<DrawPacket> packets_;
+    // (key, packet index) pairs, sorted in place; scratch_ is the radix sort ping-pong buffer
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> order_;
+    std::vector<uint64_t> scratch_keys_;
+    std::vector<uint32_t> scratch_order_;
+    // Dense ids for this frame's texture tuples, so a texture set fits in 16 key bits without collisions.
+    // Linear probing over a power of two table; bumping texture_set_generation_ empties it
+    std::vector<TextureSetSlot> texture_sets_;
+    size_t texture_set_count_;
+    uint32_t texture_set_generation_;
+    // Sorts large frames in parallel if given
+    JobSystem* jobs_;
+    float far_plane_;
+    RenderQueueStats stats_;
+
+    // @return: dense id of the packet's texture set in this frame
+    unsigned int GetTextureSetId(const DrawPacket& packet);
+    // Double the texture set table, keeping this frame's entries
+    void GrowTextureSets();
+    // Stable LSD radix sort of keys_/order_ by key, 8 bits per pass
+    void Sort();
+public:
+    // far_plane: depth at which the key's depth bits saturate
+    // jobs: optional; frames with many packets are sorted on it
+    explicit RenderQueue(float far_plane = 100.f, JobSystem* jobs = nullptr);
+
+    // Queue a packet for this frame
+    void Submit(const DrawPacket& packet);
+    // Sort, merge and draw every queued packet, then clear the queue
+    // Instance transforms are written to stream and bound through instance_layout
+    void Execute(StreamBuffer& stream, const VertexLayout& instance_layout);
+
+    const RenderQueueStats& GetStats() const { return stats_; }
+};
+
+#endif // !RENDER_QUEUE_H
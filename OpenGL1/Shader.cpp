@@ -4,119 +4,343 @@ Based off example from https://learnopengl.com/Getting-started/Shaders
 */
 
 #include "Shader.h"
+#include "GLState.h"
+#include "ShaderCompiler.h"
 
 #include <glad/glad.h>
-#include <string>
-#include <fstream>
-#include <sstream>
+#include <algorithm>
 #include <iostream>
+#include <cstring>
 
 #include <glm/gtc/type_ptr.hpp>
 
-using std::string;
-using std::ifstream;
+#include <string>
+
+// How a uniform's current value is read back to seed its shadow
+enum class UniformComponent { kNone, kFloat, kInt, kUint };
 
-// Helper function to process files into c-strings
-// throws exception if file cannot be read
-static const string readFileToString(const char* filepath);
+// @return: bytes one element of a uniform of GL type takes in the shadow; 0 and kNone if it is not shadowed
+static size_t GetUniformElementSize(GLenum type, UniformComponent& component);
 
 /* Shader class implementation */
 
 // Builds shader object using specified vertex and fragment shaders from files
-Shader::Shader(const char* vertex_path, const char* fragment_path) {
-    // Get vertex/fragment source code from their filepaths
-    // Create strings on stack for char pointers
-    string vx_string{ readFileToString(vertex_path) };
-    string frag_string{ readFileToString(fragment_path) };
+// Same as submitting to a compiler of its own and finishing right away
+Shader::Shader(const char* vertex_path, const char* fragment_path, ProgramCache* cache, const std::vector<std::string>& defines) : id_{}, build_ms_{}, from_cache_{ false }, spirv_{ false }, ready_{ false }, generation_{} {
+    ShaderCompiler compiler{ cache };
+    compiler.Submit(*this, vertex_path, fragment_path, defines);
+    compiler.Finish();
+}
 
-    const char* vx_shader_code{ vx_string.c_str() };
-    const char* frag_shader_code{ frag_string.c_str() };
+// Submits the program to compiler and returns at once
+Shader::Shader(const char* vertex_path, const char* fragment_path, ShaderCompiler& compiler, const std::vector<std::string>& defines) : id_{}, build_ms_{}, from_cache_{ false }, spirv_{ false }, ready_{ false }, generation_{} {
+    compiler.Submit(*this, vertex_path, fragment_path, defines);
+}
 
-    // compile shaders
+// Builds a compute program from a single compute shader file; requires GL 4.3
+Shader::Shader(const char* compute_path, ProgramCache* cache, const std::vector<std::string>& defines) : id_{}, build_ms_{}, from_cache_{ false }, spirv_{ false }, ready_{ false }, generation_{} {
+    ShaderCompiler compiler{ cache };
+    compiler.Submit(*this, compute_path, defines);
+    compiler.Finish();
+}
 
-    // vertex shader 
-    unsigned int vertex{ glCreateShader(GL_VERTEX_SHADER) };
-    glShaderSource(vertex, 1, &vx_shader_code, nullptr);
-    glCompileShader(vertex);
+Shader::Shader(const char* compute_path, ShaderCompiler& compiler, const std::vector<std::string>& defines) : id_{}, build_ms_{}, from_cache_{ false }, spirv_{ false }, ready_{ false }, generation_{} {
+    compiler.Submit(*this, compute_path, defines);
+}
 
-    // check for compile errors
-    int success;
-    char info_log[512];
-    
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertex, 512, nullptr, info_log);
-        std::cout << "ERROR [VERTEX SHADER COMPILATION FAILED]\n" << info_log << std::endl;
+// Deletes the program; the GL context it was built in must still be alive
+Shader::~Shader() {
+    if (id_) {
+        glDeleteProgram(id_);
+        GLState::GetInstance().OnProgramDeleted(id_);
     }
+}
 
-    // fragment shader
-    unsigned int fragment{ glCreateShader(GL_FRAGMENT_SHADER) };
-    glShaderSource(fragment, 1, &frag_shader_code, nullptr);
-    glCompileShader(fragment);
+// Use the program maintained by this Shader instance; skipped if it is already current
+void Shader::Use() const { GLState::GetInstance().UseProgram(id_); }
 
-    // check for compile errors
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragment, 512, nullptr, info_log);
-        std::cout << "ERROR [FRAGMENT SHADER COMPILATION FAILED]\n" << info_log << std::endl;
+// Attach the named uniform block to a uniform buffer binding point
+// GLSL 330 has no layout(binding = N), so bindings are assigned here after linking
+void Shader::BindUniformBlock(const char* name, unsigned int binding) const {
+    if (!spirv_) {
+        unsigned int block_index{ glGetUniformBlockIndex(id_, name) };
+        if (block_index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(id_, block_index, binding);
+        }
+        return;
+    }
+    // No names to ask for, so find the block by the binding its module gave it
+    auto found = std::find_if(spirv_uniforms_.begin(), spirv_uniforms_.end(),
+        [name](const SpirvUniform& uniform) { return uniform.location < 0 && uniform.name == name; });
+    if (found == spirv_uniforms_.end()) {
+        return;
     }
+    int block_count{};
+    glGetProgramiv(id_, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+    for (int block{}; block < block_count; ++block) {
+        int block_binding{};
+        glGetActiveUniformBlockiv(id_, static_cast<GLuint>(block), GL_UNIFORM_BLOCK_BINDING, &block_binding);
+        if (block_binding == found->binding) {
+            glUniformBlockBinding(id_, static_cast<GLuint>(block), binding);
+            return;
+        }
+    }
+}
 
-    // Finally, link shader program
-    id_ = glCreateProgram();
-    glAttachShader(id_, vertex);
-    glAttachShader(id_, fragment);
-    glLinkProgram(id_);
+// @return: true if the program reads the named uniform block
+bool Shader::HasUniformBlock(UniformName name) const {
+    return std::binary_search(uniform_blocks_.begin(), uniform_blocks_.end(), name.hash);
+}
 
-    // Check for linkage errors
-    glGetProgramiv(id_, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(id_, 512, nullptr, info_log);
-        std::cout << "ERROR [SHADER PROGRAM LINKING FAILED]\n" << info_log << std::endl;
+// Called by ShaderCompiler once program has linked; replaces and deletes any previous program
+void Shader::OnBuilt(unsigned int program, double build_ms, bool from_cache, const std::vector<SpirvUniform>* spirv_uniforms) {
+    if (id_) {
+        glDeleteProgram(id_);
+        GLState::GetInstance().OnProgramDeleted(id_);
     }
+    id_ = program;
+    build_ms_ = build_ms;
+    from_cache_ = from_cache;
+    spirv_ = spirv_uniforms != nullptr;
+    spirv_uniforms_ = spirv_ ? *spirv_uniforms : std::vector<SpirvUniform>{};
+    ReflectUniforms();
+    ready_ = true;
+    ++generation_;
+}
+
+// Fill uniforms_, uniform_blocks_ and the value shadows from the linked program
+// Members of uniform blocks have no location and are skipped; arrays are also found without "[0]"
+void Shader::ReflectUniforms() {
+    uniforms_.clear();
+    uniform_blocks_.clear();
+    shadows_.clear();
+    shadow_values_.clear();
+    int uniform_count{}, max_name_length{};
+    glGetProgramiv(id_, GL_ACTIVE_UNIFORMS, &uniform_count);
+    glGetProgramiv(id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+    std::vector<char> name(std::max(max_name_length, 1));
+    for (int i{}; i < uniform_count; ++i) {
+        int length{}, size{};
+        GLenum type{};
+        glGetActiveUniform(id_, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+        int location{ -1 };
+        bool is_array{};
+        if (spirv_) {
+            // No names in the program; the modules name the uniform at this location
+            const GLenum property{ GL_LOCATION };
+            glGetProgramResourceiv(id_, GL_UNIFORM, static_cast<GLuint>(i), 1, &property, 1, nullptr, &location);
+            auto found = std::find_if(spirv_uniforms_.begin(), spirv_uniforms_.end(),
+                [location](const SpirvUniform& uniform) { return uniform.location == location; });
+            if (location < 0 || found == spirv_uniforms_.end()) {
+                continue;
+            }
+            uniforms_.push_back(UniformInfo{ HashUniformName(found->name.c_str()), location, type, size });
+            // Array elements take consecutive locations in SPIR-V
+            is_array = size > 1;
+            if (is_array) {
+                uniforms_.push_back(UniformInfo{ HashUniformName((found->name + "[0]").c_str()), location, type, size });
+            }
+        }
+        else {
+            location = glGetUniformLocation(id_, name.data());
+            if (location < 0) {
+                continue;
+            }
+            uniforms_.push_back(UniformInfo{ HashUniformName(name.data()), location, type, size });
+            is_array = length > 3 && strcmp(name.data() + length - 3, "[0]") == 0;
+            if (is_array) {
+                name[length - 3] = '\0';
+                uniforms_.push_back(UniformInfo{ HashUniformName(name.data()), location, type, size });
+            }
+        }
+
+        // Shadow every element; array elements may have any locations, but are stored in order,
+        // so a set of count elements from one location covers the bytes that follow it
+        UniformComponent component;
+        size_t element_size{ GetUniformElementSize(type, component) };
+        size_t offset{ shadow_values_.size() };
+        shadow_values_.resize(offset + element_size * size);
+        for (int element{}; element < size && element_size > 0; ++element) {
+            int element_location{ !is_array ? location :
+                spirv_ ? location + element :
+                glGetUniformLocation(id_, (std::string{ name.data() } + "[" + std::to_string(element) + "]").c_str()) };
+            if (element_location < 0) {
+                continue;
+            }
+            if (static_cast<size_t>(element_location) >= shadows_.size()) {
+                shadows_.resize(element_location + 1, UniformShadow{ 0, 0 });
+            }
+            size_t element_offset{ offset + element_size * element };
+            shadows_[element_location] = UniformShadow{ static_cast<uint32_t>(element_offset), static_cast<uint32_t>(element_size * (size - element)) };
+            // Start from what the program holds, which includes GLSL initializers
+            void* value{ &shadow_values_[element_offset] };
+            switch (component) {
+            case UniformComponent::kFloat: glGetUniformfv(id_, element_location, static_cast<float*>(value)); break;
+            case UniformComponent::kInt: glGetUniformiv(id_, element_location, static_cast<int*>(value)); break;
+            case UniformComponent::kUint: glGetUniformuiv(id_, element_location, static_cast<unsigned int*>(value)); break;
+            case UniformComponent::kNone: break;
+            }
+        }
+    }
+    std::sort(uniforms_.begin(), uniforms_.end(), [](const UniformInfo& a, const UniformInfo& b) { return a.hash < b.hash; });
+
+    // Blocks; SPIR-V programs have no names to ask for, so those come from the modules
+    if (spirv_) {
+        for (const SpirvUniform& uniform : spirv_uniforms_) {
+            if (uniform.location < 0) {
+                uniform_blocks_.push_back(HashUniformName(uniform.name.c_str()));
+            }
+        }
+    }
+    else {
+        int block_count{}, max_block_name_length{};
+        glGetProgramiv(id_, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+        glGetProgramiv(id_, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_block_name_length);
+        std::vector<char> block_name(std::max(max_block_name_length, 1));
+        for (int block{}; block < block_count; ++block) {
+            glGetActiveUniformBlockName(id_, static_cast<GLuint>(block), static_cast<GLsizei>(block_name.size()), nullptr, block_name.data());
+            uniform_blocks_.push_back(HashUniformName(block_name.data()));
+        }
+    }
+    std::sort(uniform_blocks_.begin(), uniform_blocks_.end());
+
+    // Two names with the same hash would silently alias each other
+    for (size_t i{ 1 }; i < uniforms_.size(); ++i) {
+        if (uniforms_[i].hash == uniforms_[i - 1].hash && uniforms_[i].location != uniforms_[i - 1].location) {
+            std::cout << "ERROR [UNIFORM NAME HASH COLLISION IN PROGRAM " << id_ << "]" << std::endl;
+        }
+    }
+}
 
-    // Delete shaders as they are now linked
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+// @return: handle of an active uniform, or location -1 if the program has no such uniform
+UniformHandle Shader::GetUniform(UniformName name) const {
+    auto found = std::lower_bound(uniforms_.begin(), uniforms_.end(), name.hash,
+        [](const UniformInfo& uniform, uint32_t hash) { return uniform.hash < hash; });
+    if (found == uniforms_.end() || found->hash != name.hash) {
+        return UniformHandle{ -1 };
+    }
+    return UniformHandle{ found->location };
 }
 
-// Use the program maintained by this Shader instance
-void Shader::Use() const { glUseProgram(id_); }
+// @return: true if size bytes of data differ from the shadow at location and must be uploaded
+// Updates the shadow and the GLState uniform counters; locations without a shadow are always uploaded
+bool Shader::UpdateShadow(int location, const void* data, size_t size) const {
+    if (location < 0) {
+        return false;
+    }
+    GLState& gl_state{ GLState::GetInstance() };
+    if (static_cast<size_t>(location) >= shadows_.size() || shadows_[location].size == 0) {
+        gl_state.CountUniform(true);
+        return true;
+    }
+    const UniformShadow& shadow{ shadows_[location] };
+    // Elements past the end of the array are ignored by GL, so they are not compared either
+    size = std::min(size, static_cast<size_t>(shadow.size));
+    unsigned char* value{ &shadow_values_[shadow.offset] };
+    if (memcmp(value, data, size) == 0) {
+        gl_state.CountUniform(false);
+        return false;
+    }
+    memcpy(value, data, size);
+    gl_state.CountUniform(true);
+    return true;
+}
 
-// Uniform modifiers
-void Shader::SetBool(const char* name, bool val) const {
-    SetInt(name, val);
+// Uniform modifiers; each uploads only if the value differs from the last one this program got
+void Shader::SetBool(UniformHandle uniform, bool val) const {
+    SetInt(uniform, val ? 1 : 0);
 }
-void Shader::SetInt(const char* name, int val) const {
-    glUniform1i(glGetUniformLocation(id_, name), val);
+void Shader::SetInt(UniformHandle uniform, int val) const {
+    if (UpdateShadow(uniform.location, &val, sizeof(val))) { glUniform1i(uniform.location, val); }
 }
-void Shader::SetFloat(const char* name, float val) const {
-    glUniform1f(glGetUniformLocation(id_, name), val);
+void Shader::SetUInt(UniformHandle uniform, unsigned int val) const {
+    if (UpdateShadow(uniform.location, &val, sizeof(val))) { glUniform1ui(uniform.location, val); }
 }
-void Shader::SetMatrix4(const char* name, glm::mat4 trans) {
-    glUniformMatrix4fv(glGetUniformLocation(id_, name), 1, GL_FALSE, &trans[0][0]);
+void Shader::SetFloat(UniformHandle uniform, float val) const {
+    if (UpdateShadow(uniform.location, &val, sizeof(val))) { glUniform1f(uniform.location, val); }
+}
+void Shader::SetVec2(UniformHandle uniform, const glm::vec2& val) const {
+    if (UpdateShadow(uniform.location, &val, sizeof(val))) { glUniform2fv(uniform.location, 1, &val[0]); }
+}
+void Shader::SetVec3(UniformHandle uniform, const glm::vec3& val) const {
+    if (UpdateShadow(uniform.location, &val, sizeof(val))) { glUniform3fv(uniform.location, 1, &val[0]); }
+}
+void Shader::SetVec4(UniformHandle uniform, const glm::vec4& val) const {
+    if (UpdateShadow(uniform.location, &val, sizeof(val))) { glUniform4fv(uniform.location, 1, &val[0]); }
+}
+void Shader::SetIVec2(UniformHandle uniform, const glm::ivec2& val) const {
+    if (UpdateShadow(uniform.location, &val, sizeof(val))) { glUniform2iv(uniform.location, 1, &val[0]); }
+}
+void Shader::SetIVec3(UniformHandle uniform, const glm::ivec3& val) const {
+    if (UpdateShadow(uniform.location, &val, sizeof(val))) { glUniform3iv(uniform.location, 1, &val[0]); }
+}
+void Shader::SetIVec4(UniformHandle uniform, const glm::ivec4& val) const {
+    if (UpdateShadow(uniform.location, &val, sizeof(val))) { glUniform4iv(uniform.location, 1, &val[0]); }
+}
+void Shader::SetMatrix3(UniformHandle uniform, const glm::mat3& trans) const {
+    if (UpdateShadow(uniform.location, &trans, sizeof(trans))) { glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &trans[0][0]); }
+}
+void Shader::SetMatrix4(UniformHandle uniform, const glm::mat4& trans) const {
+    if (UpdateShadow(uniform.location, &trans, sizeof(trans))) { glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &trans[0][0]); }
+}
+void Shader::SetFloatArray(UniformHandle uniform, const float* vals, int count) const {
+    if (UpdateShadow(uniform.location, vals, count * sizeof(float))) { glUniform1fv(uniform.location, count, vals); }
+}
+void Shader::SetIntArray(UniformHandle uniform, const int* vals, int count) const {
+    if (UpdateShadow(uniform.location, vals, count * sizeof(int))) { glUniform1iv(uniform.location, count, vals); }
+}
+void Shader::SetVec4Array(UniformHandle uniform, const glm::vec4* vals, int count) const {
+    if (UpdateShadow(uniform.location, vals, count * sizeof(glm::vec4))) { glUniform4fv(uniform.location, count, &vals[0][0]); }
+}
+void Shader::SetMatrix4Array(UniformHandle uniform, const glm::mat4* trans, int count) const {
+    if (UpdateShadow(uniform.location, trans, count * sizeof(glm::mat4))) { glUniformMatrix4fv(uniform.location, count, GL_FALSE, &trans[0][0][0]); }
 }
 
-/* Non-memeber helper implementation */
-
-// Helper function to process files into c-strings
-// throws exception if file cannot be read
-const string readFileToString(const char* filepath) {
-    ifstream shader_input;
-
-    // ensure ifstreams can throw exceptions
-    shader_input.exceptions(ifstream::failbit | ifstream::badbit);
-
-    try {
-        shader_input.open(filepath);
-        std::stringstream shader_stream;
-
-        // Convert ifstream -> stringstream -> string -> cstring
-        shader_stream << shader_input.rdbuf();
-        shader_input.close();
+/* Non-member helper implementation */
 
-        return shader_stream.str();
+// @return: bytes one element of a uniform of GL type takes in the shadow; 0 and kNone if it is not shadowed
+size_t GetUniformElementSize(GLenum type, UniformComponent& component) {
+    component = UniformComponent::kFloat;
+    switch (type) {
+    case GL_FLOAT: return 4;
+    case GL_FLOAT_VEC2: return 8;
+    case GL_FLOAT_VEC3: return 12;
+    case GL_FLOAT_VEC4: return 16;
+    case GL_FLOAT_MAT2: return 16;
+    case GL_FLOAT_MAT3: return 36;
+    case GL_FLOAT_MAT4: return 64;
+    case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2: return 24;
+    case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2: return 32;
+    case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3: return 48;
+    default: break;
     }
-    catch (ifstream::failure& e) {
-        std::cout << "ERROR [ " << e.what() << " ]\n" << filepath << std::endl;
+    component = UniformComponent::kInt;
+    switch (type) {
+    // Booleans are set and read back as ints
+    case GL_INT: case GL_BOOL: return 4;
+    case GL_INT_VEC2: case GL_BOOL_VEC2: return 8;
+    case GL_INT_VEC3: case GL_BOOL_VEC3: return 12;
+    case GL_INT_VEC4: case GL_BOOL_VEC4: return 16;
+    // Samplers hold a texture unit
+    case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+    case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW:
+    case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_RECT:
+    case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_2D_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+        return 4;
+    default: break;
     }
-}
\ No newline at end of file
+    component = UniformComponent::kUint;
+    switch (type) {
+    case GL_UNSIGNED_INT: return 4;
+    case GL_UNSIGNED_INT_VEC2: return 8;
+    case GL_UNSIGNED_INT_VEC3: return 12;
+    case GL_UNSIGNED_INT_VEC4: return 16;
+    default: break;
+    }
+    // Doubles (GL 4.0) and anything else are uploaded every time
+    component = UniformComponent::kNone;
+    return 0;
+}
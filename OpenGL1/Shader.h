@@ -1,4 +1,4 @@
-/* 
+/*
 Shader class to read GLSL from file and build shader programs
 Based off example from https://learnopengl.com/Getting-started/Shaders
 */
@@ -6,26 +6,159 @@ Based off example from https://learnopengl.com/Getting-started/Shaders
 #ifndef SHADER_H
 #define SHADER_H
 
+#include "Hash.h"
+#include "SpirvLibrary.h" // for SpirvUniform
+
 #include <glm/gtc/type_ptr.hpp> // for glm::mat4
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ProgramCache;
+class ShaderCompiler;
+
+// 32 bit FNV-1a of a uniform name; constexpr so names can be hashed at compile time
+constexpr uint32_t HashUniformName(const char* name) {
+    return HashString32(kHashSeed32, name);
+}
+
+// Hashed uniform name. Declare as constexpr to hash at compile time, e.g.
+//     constexpr UniformName kModelUniform{ "model" };
+// Plain strings convert implicitly and are hashed at runtime, still without asking the driver
+struct UniformName {
+    uint32_t hash;
+    constexpr UniformName(const char* name) : hash{ HashUniformName(name) } {}
+};
+
+// Uniform location resolved once with Shader::GetUniform; -1 means inactive and sets are ignored, as in GL
+struct UniformHandle {
+    int location;
+};
+
 class Shader {
-    // Program id
+    // One active uniform found by reflection after linking
+    struct UniformInfo {
+        uint32_t hash;
+        int location;
+        // GL type (e.g. GL_FLOAT_MAT4) and array size
+        unsigned int type;
+        int size;
+    };
+
+    // Program id; 0 until the program is ready
     unsigned int id_;
+    // Where the last value uploaded to one uniform location is kept
+    struct UniformShadow {
+        uint32_t offset;
+        // Bytes from this location to the end of its uniform (array); 0 if the type is not shadowed
+        uint32_t size;
+    };
+
+    // Active uniforms sorted by name hash
+    std::vector<UniformInfo> uniforms_;
+    // Name hashes of the active uniform blocks, sorted
+    std::vector<uint32_t> uniform_blocks_;
+    // Indexed by location; values live in shadow_values_ and start out as read back after linking
+    std::vector<UniformShadow> shadows_;
+    mutable std::vector<unsigned char> shadow_values_;
+    // Wall time from submitting the sources until the program was ready
+    double build_ms_;
+    // Program came from the binary cache rather than a compile
+    bool from_cache_;
+    // Program was linked from SPIR-V modules, which give GL no names; these stand in for them
+    bool spirv_;
+    std::vector<SpirvUniform> spirv_uniforms_;
+    bool ready_;
+    // Bumped every time a program is installed, so callers notice hot reloads
+    unsigned int generation_;
+
+    friend class ShaderCompiler;
+    // Called by ShaderCompiler once program has linked; replaces and deletes any previous program
+    // spirv_uniforms: names and locations from the modules if program was linked from SPIR-V
+    void OnBuilt(unsigned int program, double build_ms, bool from_cache, const std::vector<SpirvUniform>* spirv_uniforms = nullptr);
+    // Fill uniforms_, uniform_blocks_ and the value shadows from the linked program
+    void ReflectUniforms();
+    // @return: true if size bytes of data differ from the shadow at location and must be uploaded
+    bool UpdateShadow(int location, const void* data, size_t size) const;
 public:
     // Prevent any funny business with uninitialized shaders
     Shader() = delete;
+    // A pending Shader is referenced by its compiler, so it must not be copied
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
     // Builds shader program using specified vertex and fragment shaders from files
-    // Throws exception if file cannot be read
-    Shader(const char* vertex_path, const char* frag_path);
+    // Sources are preprocessed with defines first (see ShaderPreprocessor.h)
+    // With a cache the linked binary is loaded from / saved to disk instead of compiling every launch
+    Shader(const char* vertex_path, const char* frag_path, ProgramCache* cache = nullptr, const std::vector<std::string>& defines = {});
+    // Submits the program to compiler and returns at once; usable after a later Poll/Finish makes it ready
+    Shader(const char* vertex_path, const char* frag_path, ShaderCompiler& compiler, const std::vector<std::string>& defines = {});
+    // Builds a compute program from a single compute shader file; requires GL 4.3
+    explicit Shader(const char* compute_path, ProgramCache* cache = nullptr, const std::vector<std::string>& defines = {});
+    Shader(const char* compute_path, ShaderCompiler& compiler, const std::vector<std::string>& defines = {});
+    // Deletes the program; the GL context it was built in must still be alive
+    ~Shader();
+    // @return: true once the program has linked; until then draw with a fallback program
+    bool IsReady() const { return ready_; }
+    // @return: changes whenever a new program is installed; uniforms must then be set again
+    unsigned int GetGeneration() const { return generation_; }
     // Use the program maintained by this Shader instance
     void Use() const;
-    
-    // Functions to modify uniforms
-    void SetBool(const char* name, bool val) const;
-    void SetInt(const char* name, int val) const;
-    void SetFloat(const char* name, float val) const;
-    void SetMatrix4(const char* name, glm::mat4 trans);
+    // @return: GL program name, e.g. for sort keys
+    unsigned int GetId() const { return id_; }
+    // Attach the named uniform block to a uniform buffer binding point; no-op if the block is unused
+    void BindUniformBlock(const char* name, unsigned int binding) const;
+    // @return: true if the program reads the named uniform block, e.g. to pick between per-draw
+    // records in a block (see DrawData.h) and Set* calls for programs without one
+    bool HasUniformBlock(UniformName name) const;
+
+    // @return: handle of an active uniform, or location -1 if the program has no such uniform
+    UniformHandle GetUniform(UniformName name) const;
+    // @return: number of active uniforms outside of uniform blocks
+    size_t GetUniformCount() const { return uniforms_.size(); }
+    // @return: milliseconds from submission until the program was ready, for startup reports
+    double GetBuildMs() const { return build_ms_; }
+    bool IsFromCache() const { return from_cache_; }
+    // @return: true if the program was linked from precompiled SPIR-V rather than GLSL
+    bool IsSpirv() const { return spirv_; }
+
+    // Functions to modify uniforms of the program in use
+    // Handles are the hot path; names cost a binary search over the uniform table
+    // Values equal to the last one uploaded to this program are skipped (see GLState::GetUniformCounters),
+    // so uniforms must only be changed through these while the shadow is in use
+    void SetBool(UniformHandle uniform, bool val) const;
+    void SetInt(UniformHandle uniform, int val) const;
+    void SetUInt(UniformHandle uniform, unsigned int val) const;
+    void SetFloat(UniformHandle uniform, float val) const;
+    void SetVec2(UniformHandle uniform, const glm::vec2& val) const;
+    void SetVec3(UniformHandle uniform, const glm::vec3& val) const;
+    void SetVec4(UniformHandle uniform, const glm::vec4& val) const;
+    void SetIVec2(UniformHandle uniform, const glm::ivec2& val) const;
+    void SetIVec3(UniformHandle uniform, const glm::ivec3& val) const;
+    void SetIVec4(UniformHandle uniform, const glm::ivec4& val) const;
+    void SetMatrix3(UniformHandle uniform, const glm::mat3& trans) const;
+    void SetMatrix4(UniformHandle uniform, const glm::mat4& trans) const;
+    // Arrays: count elements starting at the element uniform refers to
+    void SetFloatArray(UniformHandle uniform, const float* vals, int count) const;
+    void SetIntArray(UniformHandle uniform, const int* vals, int count) const;
+    void SetVec4Array(UniformHandle uniform, const glm::vec4* vals, int count) const;
+    void SetMatrix4Array(UniformHandle uniform, const glm::mat4* trans, int count) const;
+    void SetBool(UniformName name, bool val) const { SetBool(GetUniform(name), val); }
+    void SetInt(UniformName name, int val) const { SetInt(GetUniform(name), val); }
+    void SetUInt(UniformName name, unsigned int val) const { SetUInt(GetUniform(name), val); }
+    void SetFloat(UniformName name, float val) const { SetFloat(GetUniform(name), val); }
+    void SetVec2(UniformName name, const glm::vec2& val) const { SetVec2(GetUniform(name), val); }
+    void SetVec3(UniformName name, const glm::vec3& val) const { SetVec3(GetUniform(name), val); }
+    void SetVec4(UniformName name, const glm::vec4& val) const { SetVec4(GetUniform(name), val); }
+    void SetIVec2(UniformName name, const glm::ivec2& val) const { SetIVec2(GetUniform(name), val); }
+    void SetIVec3(UniformName name, const glm::ivec3& val) const { SetIVec3(GetUniform(name), val); }
+    void SetIVec4(UniformName name, const glm::ivec4& val) const { SetIVec4(GetUniform(name), val); }
+    void SetMatrix3(UniformName name, const glm::mat3& trans) const { SetMatrix3(GetUniform(name), trans); }
+    void SetMatrix4(UniformName name, const glm::mat4& trans) const { SetMatrix4(GetUniform(name), trans); }
+    void SetFloatArray(UniformName name, const float* vals, int count) const { SetFloatArray(GetUniform(name), vals, count); }
+    void SetIntArray(UniformName name, const int* vals, int count) const { SetIntArray(GetUniform(name), vals, count); }
+    void SetVec4Array(UniformName name, const glm::vec4* vals, int count) const { SetVec4Array(GetUniform(name), vals, count); }
+    void SetMatrix4Array(UniformName name, const glm::mat4* trans, int count) const { SetMatrix4Array(GetUniform(name), trans, count); }
 };
 
 #endif // !SHADER_H
-
@@ -0,0 +1,286 @@
+/*
+Batched shader compilation
+*/
+
+#include "ShaderCompiler.h"
+#include "Hash.h"
+#include "ProgramCache.h"
+#include "Shader.h"
+#include "ShaderPreprocessor.h"
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <string>
+
+using std::string;
+
+// Let the driver pick how many threads compile shaders in the background
+static const GLuint kDriverChosenThreadCount{ 0xFFFFFFFFu };
+
+// @return: key continued over the pieces of source, then a terminator so stage boundaries count
+static uint64_t HashStage(uint64_t key, const PreprocessedSource& source);
+// Print the info log of a shader stage that failed to compile; label names the stage in the log
+// @return: true if the stage compiled
+static bool checkStage(unsigned int shader, const char* label);
+// Print the info log of a program that failed to link
+// @return: true if the program linked
+static bool checkProgram(unsigned int program);
+
+/* ShaderCompiler implementation */
+
+// cache: optional binary cache; hits are ready as soon as Submit returns
+ShaderCompiler::ShaderCompiler(ProgramCache* cache, SpirvLibrary* spirv) :
+    cache_{ cache },
+    spirv_{ spirv },
+    parallel_{ GLAD_GL_KHR_parallel_shader_compile != 0 },
+    failed_count_{} {
+    if (parallel_) {
+        glMaxShaderCompilerThreadsKHR(kDriverChosenThreadCount);
+    }
+}
+
+// Programs still pending are deleted; their Shaders never become ready
+ShaderCompiler::~ShaderCompiler() {
+    for (PendingProgram& pending : pending_) {
+        for (size_t s{}; s < pending.stage_count; ++s) {
+            glDeleteShader(pending.stages[s]);
+        }
+        glDeleteProgram(pending.program);
+    }
+}
+
+// Queue a vertex + fragment program for shader, both preprocessed with defines
+void ShaderCompiler::Submit(Shader& shader, const char* vertex_path, const char* frag_path, const std::vector<string>& defines) {
+    const StageFile files[]{
+        { GL_VERTEX_SHADER, vertex_path, "VERTEX" },
+        { GL_FRAGMENT_SHADER, frag_path, "FRAGMENT" },
+    };
+    Submit(shader, ReadStages(files, 2, defines));
+}
+
+// Queue a compute program for shader; requires GL 4.3
+void ShaderCompiler::Submit(Shader& shader, const char* compute_path, const std::vector<string>& defines) {
+    const StageFile file{ GL_COMPUTE_SHADER, compute_path, "COMPUTE" };
+    Submit(shader, ReadStages(&file, 1, defines));
+}
+
+// Finalize every program the driver has completed; never blocks with KHR_parallel_shader_compile
+size_t ShaderCompiler::Poll() {
+    size_t finalized{};
+    for (size_t i{}; i < pending_.size();) {
+        if (parallel_) {
+            int complete{};
+            glGetProgramiv(pending_[i].program, GL_COMPLETION_STATUS_KHR, &complete);
+            if (!complete) {
+                ++i;
+                continue;
+            }
+        }
+        if (Finalize(pending_[i])) {
+            // Rebuilding from GLSL; a later Poll picks it up
+            ++i;
+            continue;
+        }
+        ++finalized;
+        // Order does not matter, so fill the hole with the last entry
+        pending_[i] = std::move(pending_.back());
+        pending_.pop_back();
+    }
+    return finalized;
+}
+
+// Finalize every pending program, waiting for the driver as needed
+void ShaderCompiler::Finish() {
+    // Status queries block until the driver is done, so no completion polling is needed here.
+    // A program reissued from GLSL stays at its index and is finalized again
+    for (size_t i{}; i < pending_.size();) {
+        if (!Finalize(pending_[i])) {
+            ++i;
+        }
+    }
+    pending_.clear();
+}
+
+// Queue a program of up to two stages already in memory
+void ShaderCompiler::Submit(Shader& shader, std::vector<StageSource> stages) {
+    PendingProgram pending{};
+    pending.shader = &shader;
+    pending.start = std::chrono::steady_clock::now();
+
+    // Precompiled SPIR-V for every stage, or GLSL for all of them; stages without a module are exported
+    std::vector<uint32_t> modules[2];
+    if (spirv_) {
+        // Modules belong to a program, since its stages are linked together to agree on locations
+        uint64_t stage_keys[2]{};
+        for (size_t s{}; s < stages.size(); ++s) {
+            stage_keys[s] = SpirvLibrary::MakeKey(stages[s].type, stages[s].source);
+        }
+        uint64_t program_key{ SpirvLibrary::MakeProgramKey(stage_keys, stages.size()) };
+        pending.spirv = true;
+        for (size_t s{}; s < stages.size(); ++s) {
+            pending.spirv = spirv_->Load(program_key, stages[s].type, modules[s]) && pending.spirv;
+        }
+        for (size_t s{}; s < stages.size(); ++s) {
+            if (pending.spirv) {
+                ReflectSpirvUniforms(modules[s], pending.spirv_uniforms);
+            }
+            else {
+                spirv_->Export(program_key, stages[s].type, stages[s].source);
+            }
+        }
+    }
+
+    // A cached binary skips compiling and linking entirely
+    if (cache_) {
+        pending.cache_key = cache_->GetDeviceKey();
+        for (const StageSource& stage : stages) {
+            pending.cache_key = HashStage(pending.cache_key, stage.source);
+        }
+        pending.glsl_cache_key = pending.cache_key;
+        // Binaries linked from SPIR-V are kept apart, since their Shaders need the module's names
+        if (pending.spirv) {
+            pending.cache_key = HashBytes(pending.cache_key, "SPIR-V", 6);
+        }
+        unsigned int program{ cache_->Load(pending.cache_key) };
+        if (program) {
+            double build_ms{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pending.start).count() };
+            shader.OnBuilt(program, build_ms, true, pending.spirv ? &pending.spirv_uniforms : nullptr);
+            return;
+        }
+    }
+
+    Issue(pending, stages, pending.spirv ? modules : nullptr);
+    if (pending.spirv) {
+        pending.sources = std::move(stages);
+    }
+    pending_.push_back(std::move(pending));
+}
+
+// Create the stages of pending from modules if given, GLSL stages otherwise, and link them without waiting
+void ShaderCompiler::Issue(PendingProgram& pending, std::vector<StageSource>& stages, std::vector<uint32_t>* modules) {
+    // Issue everything without asking for a status, so the driver is free to defer the work
+    pending.program = glCreateProgram();
+    std::vector<const char*> pieces;
+    std::vector<int> lengths;
+    for (size_t s{}; s < stages.size(); ++s) {
+        unsigned int stage{ glCreateShader(stages[s].type) };
+        if (modules) {
+            glShaderBinary(1, &stage, GL_SHADER_BINARY_FORMAT_SPIR_V, modules[s].data(),
+                static_cast<GLsizei>(modules[s].size() * sizeof(uint32_t)));
+            // Specializing is the compile step of a SPIR-V stage; no constants are overridden
+            if (GLAD_GL_VERSION_4_6) {
+                glSpecializeShader(stage, "main", 0, nullptr, nullptr);
+            }
+            else {
+                glSpecializeShaderARB(stage, "main", 0, nullptr, nullptr);
+            }
+        }
+        else {
+            // The driver copies the pieces here, so the files they point into may be released afterwards
+            stages[s].source.GetPieces(pieces, lengths);
+            glShaderSource(stage, static_cast<GLsizei>(pieces.size()), pieces.data(), lengths.data());
+            glCompileShader(stage);
+        }
+        glAttachShader(pending.program, stage);
+        pending.stages[s] = stage;
+        pending.labels[s] = stages[s].label;
+    }
+    pending.stage_count = stages.size();
+    if (cache_) { cache_->PrepareForStore(pending.program); }
+    glLinkProgram(pending.program);
+}
+
+// Read and preprocess the files of a program's stages; needs no GL context, so it may run on any thread
+std::vector<ShaderCompiler::StageSource> ShaderCompiler::ReadStages(const StageFile* files, size_t file_count,
+    const std::vector<string>& defines, std::vector<string>* dependencies) {
+    std::vector<StageSource> stages;
+    if (dependencies) {
+        dependencies->clear();
+    }
+    std::vector<string> stage_dependencies;
+    for (size_t s{}; s < file_count; ++s) {
+        // A stage that fails to read is still submitted; its compile error keeps the program from linking
+        StageSource stage{ files[s].type, PreprocessedSource{}, files[s].label };
+        PreprocessShader(files[s].path, defines, stage.source, &stage_dependencies);
+        stages.push_back(std::move(stage));
+        if (dependencies) {
+            dependencies->insert(dependencies->end(), stage_dependencies.begin(), stage_dependencies.end());
+        }
+    }
+    return stages;
+}
+
+// Check the logs of a completed program and hand it to its Shader, or report why it failed
+bool ShaderCompiler::Finalize(PendingProgram& pending) {
+    bool compiled{ true };
+    for (size_t s{}; s < pending.stage_count; ++s) {
+        compiled = checkStage(pending.stages[s], pending.labels[s]) && compiled;
+    }
+    bool linked{ checkProgram(pending.program) };
+
+    // Delete shaders as they are now linked
+    for (size_t s{}; s < pending.stage_count; ++s) {
+        glDetachShader(pending.program, pending.stages[s]);
+        glDeleteShader(pending.stages[s]);
+    }
+
+    if (!compiled || !linked) {
+        glDeleteProgram(pending.program);
+        if (pending.spirv) {
+            // The GLSL the modules came from is still good; only the modules are at fault
+            std::cout << "ERROR [SPIR-V PROGRAM FAILED, REBUILDING FROM GLSL]" << std::endl;
+            pending.spirv = false;
+            pending.spirv_uniforms.clear();
+            pending.cache_key = pending.glsl_cache_key;
+            Issue(pending, pending.sources, nullptr);
+            pending.sources.clear();
+            return true;
+        }
+        ++failed_count_;
+        return false;
+    }
+    if (cache_) {
+        cache_->Store(pending.cache_key, pending.program);
+    }
+    double build_ms{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pending.start).count() };
+    pending.shader->OnBuilt(pending.program, build_ms, false, pending.spirv ? &pending.spirv_uniforms : nullptr);
+    return false;
+}
+
+/* Non-member helper implementation */
+
+// @return: key continued over the pieces of source, then a terminator so stage boundaries count
+uint64_t HashStage(uint64_t key, const PreprocessedSource& source) {
+    std::vector<const char*> pieces;
+    std::vector<int> lengths;
+    source.GetPieces(pieces, lengths);
+    for (size_t i{}; i < pieces.size(); ++i) {
+        key = HashBytes(key, pieces[i], static_cast<size_t>(lengths[i]));
+    }
+    return HashBytes(key, "", 1);
+}
+
+// Print the info log of a shader stage that failed to compile
+bool checkStage(unsigned int shader, const char* label) {
+    int success;
+    char info_log[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, nullptr, info_log);
+        std::cout << "ERROR [" << label << " SHADER COMPILATION FAILED]\n" << info_log << std::endl;
+    }
+    return success != 0;
+}
+
+// Print the info log of a program that failed to link
+bool checkProgram(unsigned int program) {
+    int success;
+    char info_log[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, nullptr, info_log);
+        std::cout << "ERROR [SHADER PROGRAM LINKING FAILED]\n" << info_log << std::endl;
+    }
+    return success != 0;
+}
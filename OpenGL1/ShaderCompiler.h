@@ -0,0 +1,115 @@
+/*
+Batched shader compilation. Submit issues glCompileShader and glLinkProgram for a program and
+returns without asking for any status, since GL_COMPILE_STATUS / GL_LINK_STATUS make the driver
+finish the work on the spot. Poll later picks up the programs that are done and hands them to
+their Shader, which reports IsReady from then on; callers draw with a fallback program until then.
+
+With KHR_parallel_shader_compile the driver compiles on its own threads and Poll only finalizes
+programs whose GL_COMPLETION_STATUS_KHR is set, so it never blocks. Without it Poll finalizes
+everything pending, which blocks on whatever the driver has not finished yet; deferring that call
+still lets drivers that compile lazily overlap the work with everything done in between.
+
+Given a SpirvLibrary, programs whose every stage has a precompiled module are built from SPIR-V
+instead (a program cannot mix the two); the rest compile from GLSL as before. A SPIR-V program that
+fails to link is rebuilt from its GLSL, so a bad module costs a rebuild rather than the program.
+*/
+
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include "ShaderPreprocessor.h"
+#include "SpirvLibrary.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ProgramCache;
+class Shader;
+
+class ShaderCompiler {
+public:
+    // One stage of a program, named by file
+    struct StageFile {
+        // GL shader type, e.g. GL_VERTEX_SHADER
+        unsigned int type;
+        const char* path;
+        // Names the stage in error messages
+        const char* label;
+    };
+    // One stage of a program, already preprocessed; its pieces go to glShaderSource as they are
+    struct StageSource {
+        unsigned int type;
+        PreprocessedSource source;
+        const char* label;
+    };
+
+private:
+    // A linked program the driver may still be working on
+    struct PendingProgram {
+        // Receives the program once it is finalized; must stay at the same address until then
+        Shader* shader;
+        unsigned int program;
+        // Compiled stages, kept for their info logs until the program is finalized
+        unsigned int stages[2];
+        const char* labels[2];
+        size_t stage_count;
+        uint64_t cache_key;
+        std::chrono::steady_clock::time_point start;
+        // Built from SPIR-V modules; the names GL cannot reflect for them
+        bool spirv;
+        std::vector<SpirvUniform> spirv_uniforms;
+        // SPIR-V programs only: the GLSL to rebuild from if the program fails, and its cache key
+        std::vector<StageSource> sources;
+        uint64_t glsl_cache_key;
+    };
+
+    ProgramCache* cache_;
+    SpirvLibrary* spirv_;
+    // KHR_parallel_shader_compile is available, so completion can be queried without blocking
+    bool parallel_;
+    std::vector<PendingProgram> pending_;
+    size_t failed_count_;
+
+    // Create the stages of pending from modules if given, GLSL stages otherwise, and link them without waiting
+    void Issue(PendingProgram& pending, std::vector<StageSource>& stages, std::vector<uint32_t>* modules);
+    // Check the logs of a completed program and hand it to its Shader, or report why it failed
+    // @return: true if a SPIR-V program failed and pending was reissued from GLSL, so it is still pending
+    bool Finalize(PendingProgram& pending);
+public:
+    // cache: optional binary cache; hits are ready as soon as Submit returns
+    // spirv: optional precompiled modules, used where the driver supports them
+    explicit ShaderCompiler(ProgramCache* cache = nullptr, SpirvLibrary* spirv = nullptr);
+    // Programs still pending are deleted; their Shaders never become ready
+    ~ShaderCompiler();
+    ShaderCompiler(const ShaderCompiler&) = delete;
+    ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+    // Queue a vertex + fragment program for shader, both preprocessed with defines
+    // See ShaderPreprocessor.h for the define format
+    void Submit(Shader& shader, const char* vertex_path, const char* frag_path, const std::vector<std::string>& defines = {});
+    // Queue a compute program for shader; requires GL 4.3
+    void Submit(Shader& shader, const char* compute_path, const std::vector<std::string>& defines = {});
+    // Queue a program of up to two stages already in memory. If shader is ready, its program is
+    // replaced once the new one links; if the new one fails, the old one stays
+    void Submit(Shader& shader, std::vector<StageSource> stages);
+    // Read and preprocess the files of a program's stages; needs no GL context, so it may run on any thread
+    // dependencies: if given, receives every file read, includes too (may repeat across stages)
+    static std::vector<StageSource> ReadStages(const StageFile* files, size_t file_count,
+        const std::vector<std::string>& defines = {}, std::vector<std::string>* dependencies = nullptr);
+
+    // Finalize every program the driver has completed; never blocks with KHR_parallel_shader_compile
+    // @return: number of programs finalized by this call, including failed ones
+    size_t Poll();
+    // Finalize every pending program, waiting for the driver as needed
+    void Finish();
+
+    size_t GetPendingCount() const { return pending_.size(); }
+    // @return: programs that failed to compile or link since the compiler was created
+    size_t GetFailedCount() const { return failed_count_; }
+    bool IsParallel() const { return parallel_; }
+};
+
+#endif // !SHADER_COMPILER_H
@@ -0,0 +1,220 @@
+/*
+GLSL source preprocessing
+*/
+
+#include "ShaderPreprocessor.h"
+#include "ShaderSources.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using std::string;
+
+// Includes nested deeper than this are taken to be a cycle without guards
+static const int kMaxIncludeDepth{ 16 };
+
+// Shared by the files of one PreprocessShader call
+struct PreprocessState {
+    const std::vector<string>* defines;
+    PreprocessedSource* output;
+    // Every file read so far; the index is the #line source number
+    std::vector<string> files;
+    // Files that contained #pragma once
+    std::vector<string> once_files;
+    bool version_seen;
+};
+
+// Append the expanded contents of the file at path to state.output
+// @return: false on a missing file or runaway nesting
+static bool ExpandFile(const string& path, PreprocessState& state, int depth);
+// Append "#line line source\n" to output
+static void AppendLineDirective(PreprocessedSource& output, int line, size_t source);
+// @return: directory part of path including the trailing separator, or "" if there is none
+static string GetDirectory(const string& path);
+// @return: true if [begin, end), after leading whitespace, starts with directive (e.g. "#include")
+static bool IsDirective(const char* begin, const char* end, const char* directive);
+
+/* PreprocessedSource implementation */
+
+PreprocessedSource::PreprocessedSource() : size_{} {}
+
+void PreprocessedSource::Clear() {
+    segments_.clear();
+    generated_.clear();
+    files_.clear();
+    size_ = 0;
+}
+
+// Keep file alive as long as this source; call before appending from it
+void PreprocessedSource::AddFile(std::shared_ptr<const ShaderFile> file) {
+    files_.push_back(std::move(file));
+}
+
+// Append size bytes of a file added with AddFile; continues the last piece if contiguous with it
+void PreprocessedSource::Append(const char* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    size_ += size;
+    if (!segments_.empty() && segments_.back().data && segments_.back().data + segments_.back().size == data) {
+        segments_.back().size += size;
+        return;
+    }
+    segments_.push_back({ data, 0, size });
+}
+
+// Append text that is copied into the source
+void PreprocessedSource::AppendGenerated(const char* text, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    size_ += size;
+    if (!segments_.empty() && !segments_.back().data) {
+        segments_.back().size += size;
+    }
+    else {
+        segments_.push_back({ nullptr, generated_.size(), size });
+    }
+    generated_.append(text, size);
+}
+
+// Copy every piece into generated text and release the files
+void PreprocessedSource::Detach() {
+    if (files_.empty()) {
+        return;
+    }
+    string flat{ ToString() };
+    Clear();
+    AppendGenerated(flat.data(), flat.size());
+}
+
+// Fill strings and lengths with the pieces, ready for glShaderSource
+void PreprocessedSource::GetPieces(std::vector<const char*>& strings, std::vector<int>& lengths) const {
+    strings.clear();
+    lengths.clear();
+    // generated_ may have grown since a segment was added, so its pointers are only taken now
+    for (const Segment& segment : segments_) {
+        strings.push_back(segment.data ? segment.data : generated_.data() + segment.offset);
+        lengths.push_back(static_cast<int>(segment.size));
+    }
+}
+
+// @return: the whole source in one string
+string PreprocessedSource::ToString() const {
+    string text;
+    text.reserve(size_);
+    for (const Segment& segment : segments_) {
+        text.append(segment.data ? segment.data : generated_.data() + segment.offset, segment.size);
+    }
+    return text;
+}
+
+// Expand the shader at path into output
+bool PreprocessShader(const char* path, const std::vector<std::string>& defines, PreprocessedSource& output,
+    std::vector<std::string>* dependencies) {
+    output.Clear();
+    PreprocessState state{ &defines, &output, {}, {}, false };
+    bool success{ ExpandFile(path, state, 0) };
+    if (dependencies) {
+        *dependencies = std::move(state.files);
+    }
+    return success;
+}
+
+/* Non-member helper implementation */
+
+// Append the expanded contents of the file at path to state.output
+bool ExpandFile(const string& path, PreprocessState& state, int depth) {
+    if (depth > kMaxIncludeDepth) {
+        std::cout << "ERROR [SHADER INCLUDES NESTED TOO DEEP]\n" << path << std::endl;
+        return false;
+    }
+    if (std::find(state.once_files.begin(), state.once_files.end(), path) != state.once_files.end()) {
+        return true;
+    }
+    std::shared_ptr<const ShaderFile> file{ ShaderSources::GetInstance().Open(path) };
+    if (!file) {
+        std::cout << "ERROR [SHADER FILE NOT FOUND]\n" << path << std::endl;
+        return false;
+    }
+    const size_t file_index{ state.files.size() };
+    state.files.push_back(path);
+    PreprocessedSource& output{ *state.output };
+    output.AddFile(file);
+    if (depth > 0) {
+        AppendLineDirective(output, 1, file_index);
+    }
+
+    const char* const file_end{ file->GetData() + file->GetSize() };
+    const char* line_end{};
+    int line_number{ 1 };
+    for (const char* line{ file->GetData() }; line < file_end; line = line_end, ++line_number) {
+        // The line includes its newline, if it has one
+        const char* newline{ static_cast<const char*>(memchr(line, '\n', file_end - line)) };
+        line_end = newline ? newline + 1 : file_end;
+
+        if (IsDirective(line, line_end, "#version") && !state.version_seen) {
+            // #version must come first, so the defines go right after it
+            state.version_seen = true;
+            output.Append(line, line_end - line);
+            if (!newline) {
+                output.AppendGenerated("\n", 1);
+            }
+            for (const string& define : *state.defines) {
+                output.AppendGenerated("#define ", 8);
+                output.AppendGenerated(define.data(), define.size());
+                output.AppendGenerated("\n", 1);
+            }
+            AppendLineDirective(output, line_number + 1, file_index);
+        }
+        else if (IsDirective(line, line_end, "#pragma once")) {
+            state.once_files.push_back(path);
+            output.AppendGenerated("\n", 1);
+        }
+        else if (IsDirective(line, line_end, "#include")) {
+            const char* open{ std::find(line, line_end, '"') };
+            const char* close{ open == line_end ? line_end : std::find(open + 1, line_end, '"') };
+            if (close == line_end) {
+                std::cout << "ERROR [MALFORMED SHADER INCLUDE]\n" << path << ":" << line_number << std::endl;
+                return false;
+            }
+            string include_path{ GetDirectory(path) + string{ open + 1, close } };
+            if (!ExpandFile(include_path, state, depth + 1)) {
+                return false;
+            }
+            AppendLineDirective(output, line_number + 1, file_index);
+        }
+        else {
+            output.Append(line, line_end - line);
+            // Keep the next file's first line from joining this one
+            if (!newline && depth > 0) {
+                output.AppendGenerated("\n", 1);
+            }
+        }
+    }
+    return true;
+}
+
+// Append "#line line source\n" to output
+void AppendLineDirective(PreprocessedSource& output, int line, size_t source) {
+    char text[48];
+    int length{ snprintf(text, sizeof(text), "#line %d %u\n", line, static_cast<unsigned int>(source)) };
+    output.AppendGenerated(text, static_cast<size_t>(length));
+}
+
+// @return: directory part of path including the trailing separator, or "" if there is none
+string GetDirectory(const string& path) {
+    size_t slash{ path.find_last_of("/\\") };
+    return slash == string::npos ? string{} : path.substr(0, slash + 1);
+}
+
+// @return: true if [begin, end), after leading whitespace, starts with directive (e.g. "#include")
+bool IsDirective(const char* begin, const char* end, const char* directive) {
+    while (begin < end && (*begin == ' ' || *begin == '\t')) {
+        ++begin;
+    }
+    size_t length{ strlen(directive) };
+    return static_cast<size_t>(end - begin) >= length && memcmp(begin, directive, length) == 0;
+}
@@ -0,0 +1,69 @@
+/*
+GLSL source preprocessing done before glShaderSource:
+- #include "file" is replaced by the file's contents; paths are relative to the including file
+- #pragma once skips files that were already included; classic #ifndef guards also work, since
+  the GLSL compiler evaluates them on the expanded source
+- defines are injected right after #version, so one file can be compiled into specialized variants
+- #line directives keep compiler messages pointing at the right file (by dependency index) and line
+Everything else, including #if on the injected defines, is left to the GLSL compiler.
+
+Files are opened through ShaderSources and never copied: the result is a list of pieces pointing
+into the embedded table or the mapped files, interleaved with the few generated lines, which
+glShaderSource takes as is.
+*/
+
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ShaderFile;
+
+// Expanded source of one shader stage, as pieces of the files it was built from
+class PreprocessedSource {
+    // Piece of a file, or of generated_ if data is null
+    struct Segment {
+        const char* data;
+        size_t offset;
+        size_t size;
+    };
+
+    std::vector<Segment> segments_;
+    // #define and #line text the files do not contain
+    std::string generated_;
+    // Keeps the mapped files the segments point into alive
+    std::vector<std::shared_ptr<const ShaderFile>> files_;
+    size_t size_;
+public:
+    PreprocessedSource();
+
+    void Clear();
+    // Keep file alive as long as this source; call before appending from it
+    void AddFile(std::shared_ptr<const ShaderFile> file);
+    // Append size bytes of a file added with AddFile; continues the last piece if contiguous with it
+    void Append(const char* data, size_t size);
+    // Append text that is copied into the source
+    void AppendGenerated(const char* text, size_t size);
+    // Copy every piece into generated text and release the files, so the source no longer depends
+    // on them; for sources that are kept while the files may be rewritten
+    void Detach();
+
+    // Fill strings and lengths with the pieces, ready for glShaderSource
+    void GetPieces(std::vector<const char*>& strings, std::vector<int>& lengths) const;
+    // @return: total length in bytes
+    size_t GetSize() const { return size_; }
+    // @return: the whole source in one string; copies, so meant for diagnostics
+    std::string ToString() const;
+};
+
+// Expand the shader at path (relative to the shader directory, see ShaderSources.h) into output
+// defines: "NAME" or "NAME VALUE" each, emitted as #define lines
+// dependencies: if given, receives every file read, path first, in the order of their #line source numbers
+// @return: false if a file could not be opened or includes nest too deep; output is then incomplete
+bool PreprocessShader(const char* path, const std::vector<std::string>& defines, PreprocessedSource& output,
+    std::vector<std::string>* dependencies = nullptr);
+
+#endif // !SHADER_PREPROCESSOR_H
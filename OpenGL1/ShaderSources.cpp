@@ -0,0 +1,96 @@
+/*
+Embedded shader sources and memory mapped development overrides
+*/
+
+#include "ShaderSources.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// One entry of the table generated by embed_shaders.py
+struct EmbeddedShader {
+    const char* path;
+    size_t size;
+    const char* data;
+};
+
+#include "EmbeddedShaders.inl"
+
+// @return: the embedded files, wrapped once so Open hands them out without allocating
+static const std::vector<std::shared_ptr<const ShaderFile>>& GetEmbeddedFiles();
+
+/* ShaderFile implementation */
+
+// Embedded file; data lives as long as the program
+ShaderFile::ShaderFile(const char* data, size_t size) :
+    data_{ data },
+    size_{ size },
+    mapped_{ nullptr } {}
+
+// Map path; IsValid is false if it cannot be opened
+ShaderFile::ShaderFile(const char* path) :
+    data_{ nullptr },
+    size_{},
+    mapped_{ std::make_unique<MappedFile>(path) } {
+    data_ = mapped_->GetData();
+    size_ = mapped_->GetSize();
+}
+
+ShaderFile::~ShaderFile() {}
+
+/* ShaderSources implementation */
+
+ShaderSources::ShaderSources() {}
+
+// @return: Singleton ShaderSources reference
+ShaderSources& ShaderSources::GetInstance() {
+    static ShaderSources s;
+    return s;
+}
+
+// @return: where path would be found on disk, or "" if overrides are disabled
+std::string ShaderSources::GetOverridePath(const std::string& path) const {
+    if (override_directory_.empty()) {
+        return std::string{};
+    }
+    return override_directory_ + "/" + path;
+}
+
+// @return: the file at path; nullptr if neither the override directory nor the embedded table has it
+std::shared_ptr<const ShaderFile> ShaderSources::Open(const std::string& path) const {
+    if (!override_directory_.empty()) {
+        std::shared_ptr<const ShaderFile> file{ std::make_shared<const ShaderFile>(GetOverridePath(path).c_str()) };
+        if (file->IsValid()) {
+            return file;
+        }
+    }
+    const EmbeddedShader* begin{ std::begin(kEmbeddedShaders) };
+    const EmbeddedShader* end{ std::end(kEmbeddedShaders) };
+    const EmbeddedShader* found{ std::lower_bound(begin, end, path.c_str(),
+        [](const EmbeddedShader& shader, const char* name) { return strcmp(shader.path, name) < 0; }) };
+    if (found == end || path != found->path) {
+        return nullptr;
+    }
+    return GetEmbeddedFiles()[found - begin];
+}
+
+// @return: number of embedded files
+size_t ShaderSources::GetEmbeddedCount() const {
+    return std::end(kEmbeddedShaders) - std::begin(kEmbeddedShaders);
+}
+
+/* Non-member helper implementation */
+
+// @return: the embedded files, wrapped once so Open hands them out without allocating
+const std::vector<std::shared_ptr<const ShaderFile>>& GetEmbeddedFiles() {
+    static const std::vector<std::shared_ptr<const ShaderFile>> files{ [] {
+        std::vector<std::shared_ptr<const ShaderFile>> wrapped;
+        for (const EmbeddedShader& shader : kEmbeddedShaders) {
+            wrapped.push_back(std::make_shared<const ShaderFile>(shader.data, shader.size));
+        }
+        return wrapped;
+    }() };
+    return files;
+}
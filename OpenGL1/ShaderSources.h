@@ -0,0 +1,66 @@
+/*
+Where shader source text comes from. Every shader file is compiled into the executable by
+embed_shaders.py (EmbeddedShaders.inl), so a build runs without any shader files next to it.
+For development an override directory can be set: files found there are memory mapped and win
+over the embedded copies, which is what hot reload edits.
+
+Either way a ShaderFile is a read-only view of the whole file that is never copied; the
+preprocessor passes pieces of it straight to glShaderSource.
+*/
+
+#ifndef SHADER_SOURCES_H
+#define SHADER_SOURCES_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+class MappedFile;
+
+// Read-only contents of one shader file, mapped from disk or pointing into the embedded table
+class ShaderFile {
+    const char* data_;
+    size_t size_;
+    // Null for embedded files
+    std::unique_ptr<MappedFile> mapped_;
+public:
+    // Embedded file; data lives as long as the program
+    ShaderFile(const char* data, size_t size);
+    // Map path; IsValid is false if it cannot be opened
+    explicit ShaderFile(const char* path);
+    ~ShaderFile();
+    ShaderFile(const ShaderFile&) = delete;
+    ShaderFile& operator=(const ShaderFile&) = delete;
+
+    bool IsValid() const { return data_ != nullptr; }
+    const char* GetData() const { return data_; }
+    size_t GetSize() const { return size_; }
+    bool IsEmbedded() const { return mapped_ == nullptr; }
+};
+
+/* ShaderSources class
+* One table of embedded sources per program, so treat it as a Singleton
+*/
+class ShaderSources {
+    // Empty: embedded sources only
+    std::string override_directory_;
+
+    ShaderSources();
+public:
+    // @return: Singleton ShaderSources reference
+    static ShaderSources& GetInstance();
+
+    // Files in directory take precedence over embedded ones; "" disables overrides
+    // Set before any shader is loaded; it is read from the watcher thread without locking
+    void SetOverrideDirectory(const char* directory) { override_directory_ = directory; }
+    const std::string& GetOverrideDirectory() const { return override_directory_; }
+    // @return: where path would be found on disk, or "" if overrides are disabled
+    std::string GetOverridePath(const std::string& path) const;
+    // @return: the file at path (relative to the shader directory); nullptr if neither the
+    // override directory nor the embedded table has it. Safe to call from any thread
+    std::shared_ptr<const ShaderFile> Open(const std::string& path) const;
+    // @return: number of embedded files
+    size_t GetEmbeddedCount() const;
+};
+
+#endif // !SHADER_SOURCES_H
@@ -0,0 +1,54 @@
+/*
+Specialized variants of one program, keyed by a feature bitmask
+*/
+
+#include "ShaderVariantCache.h"
+#include "Shader.h"
+#include "ShaderCompiler.h"
+#include "ShaderWatcher.h"
+
+#include <iostream>
+
+/* ShaderVariantCache implementation */
+
+// features: define for each feature bit, at most 32; paths must outlive the cache
+ShaderVariantCache::ShaderVariantCache(const char* vertex_path, const char* frag_path, std::vector<std::string> features,
+    ShaderCompiler& compiler, ShaderWatcher* watcher, std::vector<std::string> common_defines) :
+    vertex_path_{ vertex_path },
+    frag_path_{ frag_path },
+    features_{ std::move(features) },
+    common_defines_{ std::move(common_defines) },
+    compiler_{ compiler },
+    watcher_{ watcher } {
+    if (features_.size() > 32) {
+        std::cout << "ERROR [MORE THAN 32 SHADER FEATURES]\n" << vertex_path << " " << frag_path << std::endl;
+        features_.resize(32);
+    }
+}
+
+// Out of line so the header gets away with forward declarations
+ShaderVariantCache::~ShaderVariantCache() = default;
+
+// @return: the variant with exactly these feature bits; submitted on the first request
+Shader& ShaderVariantCache::Get(uint32_t feature_mask) {
+    std::unique_ptr<Shader>& variant{ variants_[feature_mask] };
+    if (!variant) {
+        std::vector<std::string> defines{ GetDefines(feature_mask) };
+        variant = std::make_unique<Shader>(vertex_path_, frag_path_, compiler_, defines);
+        if (watcher_) {
+            watcher_->Watch(*variant, vertex_path_, frag_path_, defines);
+        }
+    }
+    return *variant;
+}
+
+// @return: defines a variant is compiled with
+std::vector<std::string> ShaderVariantCache::GetDefines(uint32_t feature_mask) const {
+    std::vector<std::string> defines{ common_defines_ };
+    for (size_t bit{}; bit < features_.size(); ++bit) {
+        if (feature_mask & (1u << bit)) {
+            defines.push_back(features_[bit]);
+        }
+    }
+    return defines;
+}
@@ -0,0 +1,48 @@
+/*
+Specialized variants of one vertex + fragment program, keyed by a feature bitmask. Bit i of the
+mask adds the i-th feature's define, so shaders test features with #ifdef at compile time instead
+of branching on uniforms at run time. A variant is submitted to the ShaderCompiler the first
+time it is requested and memoized from then on; like any submitted Shader, it is usable once
+IsReady returns true.
+*/
+
+#ifndef SHADER_VARIANT_CACHE_H
+#define SHADER_VARIANT_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Shader;
+class ShaderCompiler;
+class ShaderWatcher;
+
+class ShaderVariantCache {
+    const char* vertex_path_;
+    const char* frag_path_;
+    // Define for each feature bit, e.g. "INSTANCED" or "FACE_MIX 0.2"
+    std::vector<std::string> features_;
+    // Defines every variant gets
+    std::vector<std::string> common_defines_;
+    ShaderCompiler& compiler_;
+    ShaderWatcher* watcher_;
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>> variants_;
+public:
+    // features: define for each feature bit, at most 32; paths must outlive the cache
+    // watcher: optional; every variant created is hot reloaded with its own defines
+    ShaderVariantCache(const char* vertex_path, const char* frag_path, std::vector<std::string> features,
+        ShaderCompiler& compiler, ShaderWatcher* watcher = nullptr, std::vector<std::string> common_defines = {});
+    ~ShaderVariantCache();
+    ShaderVariantCache(const ShaderVariantCache&) = delete;
+    ShaderVariantCache& operator=(const ShaderVariantCache&) = delete;
+
+    // @return: the variant with exactly these feature bits; submitted on the first request, so it may not be ready yet
+    Shader& Get(uint32_t feature_mask);
+    // @return: defines a variant is compiled with
+    std::vector<std::string> GetDefines(uint32_t feature_mask) const;
+    size_t GetVariantCount() const { return variants_.size(); }
+};
+
+#endif // !SHADER_VARIANT_CACHE_H
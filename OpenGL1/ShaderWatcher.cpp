@@ -0,0 +1,279 @@
+/*
+Shader hot reload
+*/
+
+#include "ShaderWatcher.h"
+#include "Shader.h"
+#include "ShaderSources.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Longest the watcher thread sleeps before checking whether it should stop
+static const int kWakeIntervalMs{ 100 };
+// Modification time polling period where inotify is unavailable
+static const int kPollIntervalMs{ 250 };
+// Quiet time after the last event before reading; editors often write a file in several steps
+static const int kSettleMs{ 50 };
+
+// @return: value that changes whenever the file's modification time or size changes, or -1 if missing
+static long long GetFileStamp(const char* path);
+// Split path into its directory ("." if none) and file name
+static void SplitPath(const char* path, std::string& directory, std::string& name);
+
+/* ShaderWatcher implementation */
+
+ShaderWatcher::ShaderWatcher() : stop_{ false }, notify_fd_{ -1 } {}
+
+// Stops and joins the watcher thread
+ShaderWatcher::~ShaderWatcher() {
+    stop_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+#ifdef __linux__
+    if (notify_fd_ >= 0) {
+        close(notify_fd_);
+    }
+#endif
+}
+
+// Register a program built with these files and defines; may be called before or after Start
+void ShaderWatcher::Watch(Shader& shader, const char* vertex_path, const char* frag_path, const std::vector<std::string>& defines) {
+    const ShaderCompiler::StageFile stages[]{
+        { GL_VERTEX_SHADER, vertex_path, "VERTEX" },
+        { GL_FRAGMENT_SHADER, frag_path, "FRAGMENT" },
+    };
+    Watch(shader, stages, 2, defines);
+}
+
+void ShaderWatcher::Watch(Shader& shader, const char* compute_path, const std::vector<std::string>& defines) {
+    const ShaderCompiler::StageFile stage{ GL_COMPUTE_SHADER, compute_path, "COMPUTE" };
+    Watch(shader, &stage, 1, defines);
+}
+
+void ShaderWatcher::Watch(Shader& shader, const ShaderCompiler::StageFile* stages, size_t stage_count, const std::vector<std::string>& defines) {
+    WatchedProgram program{};
+    program.shader = &shader;
+    program.stage_count = stage_count;
+    std::copy(stages, stages + stage_count, program.stages);
+    program.defines = defines;
+    // The watcher thread finds the files, so registering never reads anything on this thread
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    added_.push_back(std::move(program));
+}
+
+// Start the watcher thread
+void ShaderWatcher::Start() {
+#ifdef __linux__
+    notify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notify_fd_ >= 0) {
+        thread_ = std::thread{ &ShaderWatcher::RunNotify, this };
+        return;
+    }
+#endif
+    thread_ = std::thread{ &ShaderWatcher::RunPolling, this };
+}
+
+// GL thread: submit the rebuilds queued since the last call; never waits on the watcher thread
+size_t ShaderWatcher::SubmitReloads(ShaderCompiler& compiler) {
+    std::vector<Reload> reloads;
+    {
+        // The watcher only holds the lock to push or swap, so a busy lock just means next frame
+        std::unique_lock<std::mutex> lock{ mutex_, std::try_to_lock };
+        if (!lock.owns_lock() || reloads_.empty()) {
+            return 0;
+        }
+        reloads.swap(reloads_);
+    }
+    for (Reload& reload : reloads) {
+        std::cout << "Reloading " << reload.stages.size() << " stage(s) of program " << reload.shader->GetId() << std::endl;
+        compiler.Submit(*reload.shader, std::move(reload.stages));
+    }
+    return reloads.size();
+}
+
+// Watcher thread: sleep on inotify and queue every program with a changed file
+void ShaderWatcher::RunNotify() {
+#ifdef __linux__
+    std::vector<bool> changed;
+    alignas(inotify_event) char buffer[4096];
+    pollfd notify_poll{ notify_fd_, POLLIN, 0 };
+    bool any_changed{ false };
+    while (!stop_) {
+        TakeAdded();
+        changed.resize(programs_.size());
+
+        // Once something changed, wait only until the writes settle
+        int ready{ poll(&notify_poll, 1, any_changed ? kSettleMs : kWakeIntervalMs) };
+        if (ready <= 0) {
+            if (!any_changed) {
+                continue;
+            }
+            for (size_t p{}; p < programs_.size(); ++p) {
+                if (changed[p]) {
+                    QueueReload(programs_[p]);
+                    changed[p] = false;
+                }
+            }
+            any_changed = false;
+            continue;
+        }
+
+        ssize_t length{ read(notify_fd_, buffer, sizeof(buffer)) };
+        for (ssize_t offset{}; offset < length;) {
+            const inotify_event* event{ reinterpret_cast<const inotify_event*>(buffer + offset) };
+            offset += sizeof(inotify_event) + event->len;
+            if (event->len == 0) {
+                continue;
+            }
+            for (size_t p{}; p < programs_.size(); ++p) {
+                for (const WatchedFile& file : programs_[p].files) {
+                    if (event->wd == file.watch && file.name == event->name) {
+                        changed[p] = true;
+                        any_changed = true;
+                    }
+                }
+            }
+        }
+    }
+#endif
+}
+
+// Watcher thread: compare modification times and queue every program with a changed file
+void ShaderWatcher::RunPolling() {
+    auto next_poll = std::chrono::steady_clock::now();
+    while (!stop_) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{ kWakeIntervalMs });
+        TakeAdded();
+        if (std::chrono::steady_clock::now() < next_poll) {
+            continue;
+        }
+        next_poll = std::chrono::steady_clock::now() + std::chrono::milliseconds{ kPollIntervalMs };
+
+        for (WatchedProgram& program : programs_) {
+            bool changed{ false };
+            for (WatchedFile& file : program.files) {
+                long long stamp{ GetFileStamp(file.path.c_str()) };
+                if (stamp != file.stamp && stamp != -1) {
+                    file.stamp = stamp;
+                    changed = true;
+                }
+            }
+            if (changed) {
+                // Same settle time as with inotify, so a half written file is not picked up
+                std::this_thread::sleep_for(std::chrono::milliseconds{ kSettleMs });
+                QueueReload(program);
+            }
+        }
+    }
+}
+
+// Move newly registered programs into programs_ and find their files
+void ShaderWatcher::TakeAdded() {
+    std::vector<WatchedProgram> added;
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        added.swap(added_);
+    }
+    for (WatchedProgram& program : added) {
+        std::vector<std::string> dependencies;
+        ShaderCompiler::ReadStages(program.stages, program.stage_count, program.defines, &dependencies);
+        SetFiles(program, dependencies);
+        programs_.push_back(std::move(program));
+    }
+}
+
+// Point program's watched files at the given paths
+// The stage files are always included, so a file that failed to read is still watched
+// Only the override directory is watched; embedded sources cannot change
+void ShaderWatcher::SetFiles(WatchedProgram& program, const std::vector<std::string>& paths) {
+    const ShaderSources& sources{ ShaderSources::GetInstance() };
+    std::vector<std::string> unique_paths;
+    for (size_t s{}; s < program.stage_count; ++s) {
+        unique_paths.push_back(sources.GetOverridePath(program.stages[s].path));
+    }
+    for (const std::string& path : paths) {
+        std::string disk_path{ sources.GetOverridePath(path) };
+        if (std::find(unique_paths.begin(), unique_paths.end(), disk_path) == unique_paths.end()) {
+            unique_paths.push_back(disk_path);
+        }
+    }
+
+    program.files.clear();
+    for (const std::string& path : unique_paths) {
+        if (path.empty()) {
+            continue;
+        }
+        WatchedFile file{ path, -1, std::string{}, GetFileStamp(path.c_str()) };
+#ifdef __linux__
+        if (notify_fd_ >= 0) {
+            std::string directory;
+            SplitPath(path.c_str(), directory, file.name);
+            // Adding a directory again returns its existing watch
+            file.watch = inotify_add_watch(notify_fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            if (file.watch < 0) {
+                std::cout << "ERROR [SHADER WATCH FAILED]\n" << directory << std::endl;
+            }
+        }
+#endif
+        program.files.push_back(std::move(file));
+    }
+}
+
+// Read and preprocess the sources of program and queue them for the GL thread
+// Includes may have been added or removed, so the watched files are refreshed too
+void ShaderWatcher::QueueReload(WatchedProgram& program) {
+    std::vector<std::string> dependencies;
+    Reload reload{ program.shader, ShaderCompiler::ReadStages(program.stages, program.stage_count, program.defines, &dependencies) };
+    SetFiles(program, dependencies);
+    // The queue may wait a while for the GL thread, and an editor truncating a mapped file in
+    // that time would fault the read, so queued sources own their text
+    for (ShaderCompiler::StageSource& stage : reload.stages) {
+        stage.source.Detach();
+    }
+
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    // A newer read of the same program replaces one the GL thread has not picked up yet
+    for (Reload& queued : reloads_) {
+        if (queued.shader == reload.shader) {
+            queued = std::move(reload);
+            return;
+        }
+    }
+    reloads_.push_back(std::move(reload));
+}
+
+/* Non-member helper implementation */
+
+// @return: value that changes whenever the file's modification time or size changes, or -1 if missing
+long long GetFileStamp(const char* path) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return -1;
+    }
+    return static_cast<long long>(info.st_mtime) * 1000003 + static_cast<long long>(info.st_size);
+}
+
+// Split path into its directory ("." if none) and file name
+void SplitPath(const char* path, std::string& directory, std::string& name) {
+    std::string full{ path };
+    size_t slash{ full.find_last_of("/\\") };
+    if (slash == std::string::npos) {
+        directory = ".";
+        name = full;
+        return;
+    }
+    directory = full.substr(0, slash);
+    name = full.substr(slash + 1);
+}
@@ -0,0 +1,98 @@
+/*
+Shader hot reload. A background thread watches the source files of registered programs, includes
+too, and when one changes, reads and preprocesses the program's sources itself and queues them.
+The GL thread picks the queue up with SubmitReloads and hands the sources to a ShaderCompiler,
+which swaps the new program into the existing Shader once it links and keeps the old one if it
+does not.
+
+On Linux the thread sleeps on inotify (watching the directories, since editors often save by
+renaming a new file over the old one). Elsewhere it compares modification times every
+kPollIntervalMs. Either way the GL thread never touches the file system and never waits on the
+watcher; with KHR_parallel_shader_compile the rebuild itself is off the GL thread as well.
+*/
+
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include "ShaderCompiler.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Shader;
+
+class ShaderWatcher {
+    // One file a program is built from
+    struct WatchedFile {
+        std::string path;
+        // Directory watch and name within it (inotify)
+        int watch;
+        std::string name;
+        // Last seen change (polling)
+        long long stamp;
+    };
+
+    // A program and the files it is built from
+    struct WatchedProgram {
+        Shader* shader;
+        // Paths must outlive the watcher, e.g. string literals
+        ShaderCompiler::StageFile stages[2];
+        size_t stage_count;
+        std::vector<std::string> defines;
+        // Stage files and everything they include; refreshed by the watcher thread on every read
+        std::vector<WatchedFile> files;
+    };
+
+    // Sources read by the watcher thread, waiting for the GL thread
+    struct Reload {
+        Shader* shader;
+        std::vector<ShaderCompiler::StageSource> stages;
+    };
+
+    // Guards added_ and reloads_
+    std::mutex mutex_;
+    // Registered since the watcher thread last looked
+    std::vector<WatchedProgram> added_;
+    std::vector<Reload> reloads_;
+    // Only touched by the watcher thread
+    std::vector<WatchedProgram> programs_;
+    std::atomic<bool> stop_;
+    std::thread thread_;
+    // inotify descriptor, or -1 when polling
+    int notify_fd_;
+
+    void Watch(Shader& shader, const ShaderCompiler::StageFile* stages, size_t stage_count, const std::vector<std::string>& defines);
+    // Watcher thread body for each mechanism
+    void RunNotify();
+    void RunPolling();
+    // Move newly registered programs into programs_ and find their files
+    void TakeAdded();
+    // Point program's watched files at the given paths
+    void SetFiles(WatchedProgram& program, const std::vector<std::string>& paths);
+    // Read and preprocess the sources of program and queue them for the GL thread
+    void QueueReload(WatchedProgram& program);
+public:
+    ShaderWatcher();
+    // Stops and joins the watcher thread
+    ~ShaderWatcher();
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    // Register a program built with these files and defines; may be called before or after Start
+    // shader must stay at the same address while watched
+    void Watch(Shader& shader, const char* vertex_path, const char* frag_path, const std::vector<std::string>& defines = {});
+    void Watch(Shader& shader, const char* compute_path, const std::vector<std::string>& defines = {});
+    // Start the watcher thread
+    void Start();
+
+    // GL thread: submit the rebuilds queued since the last call; never waits on the watcher thread
+    // @return: number of programs submitted
+    size_t SubmitReloads(ShaderCompiler& compiler);
+    // @return: true if changes are noticed through inotify rather than by polling
+    bool IsNotifyBased() const { return notify_fd_ >= 0; }
+};
+
+#endif // !SHADER_WATCHER_H
@@ -0,0 +1,50 @@
+/*
+Instruction set selection for the CPU kernels
+*/
+
+#include "Simd.h"
+
+#if defined(SIMD_AVX2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// @return: widest SimdLevel this CPU and build support
+SimdLevel GetBestSimdLevel() {
+    static const SimdLevel best{ [] {
+#if defined(SIMD_AVX2) && defined(_MSC_VER)
+        // AVX2 and FMA need the CPU flags and the OS saving the YMM registers
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] >= 7) {
+            __cpuid(info, 1);
+            bool os_saves_ymm{ (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6 };
+            bool fma{ (info[2] & (1 << 12)) != 0 };
+            __cpuidex(info, 7, 0);
+            if (os_saves_ymm && fma && (info[1] & (1 << 5))) {
+                return SimdLevel::kAvx2;
+            }
+        }
+#elif defined(SIMD_AVX2)
+        // Also checks that the OS saves the YMM registers
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return SimdLevel::kAvx2;
+        }
+#endif
+#ifdef SIMD_SSE2
+        return SimdLevel::kSse2;
+#else
+        return SimdLevel::kScalar;
+#endif
+    }() };
+    return best;
+}
+
+// @return: short name of a SimdLevel for reports
+const char* GetSimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::kScalar: return "scalar";
+        case SimdLevel::kSse2: return "SSE2";
+        case SimdLevel::kAvx2: return "AVX2";
+    }
+    return "unknown";
+}
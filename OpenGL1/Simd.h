@@ -0,0 +1,31 @@
+/*
+Instruction set selection for the CPU kernels (culling, block compression, mip generation).
+SSE2 is part of x86-64; AVX2 kernels (which may also use FMA) are compiled per function with
+SIMD_TARGET_AVX2 and only called once GetBestSimdLevel has found that the CPU and OS support them.
+*/
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SIMD_SSE2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+// MSVC accepts AVX2 intrinsics in any function
+#define SIMD_TARGET_AVX2
+#define SIMD_AVX2 1
+#elif defined(__GNUC__)
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SIMD_AVX2 1
+#endif
+#endif
+
+// Instruction sets the kernels are written for; the best one the CPU supports is picked at runtime
+enum class SimdLevel { kScalar, kSse2, kAvx2 };
+
+// @return: widest SimdLevel this CPU and build support
+SimdLevel GetBestSimdLevel();
+// @return: short name of a SimdLevel for reports
+const char* GetSimdLevelName(SimdLevel level);
+
+#endif // !SIMD_H
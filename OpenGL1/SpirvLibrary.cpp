@@ -0,0 +1,213 @@
+/*
+Precompiled SPIR-V modules
+*/
+
+#include "SpirvLibrary.h"
+#include "Hash.h"
+#include "ShaderPreprocessor.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// First word of every module
+static const uint32_t kSpirvMagic{ 0x07230203u };
+// Words before the first instruction
+static const size_t kSpirvHeaderWords{ 5 };
+
+// Opcodes, decorations and storage classes ReflectSpirvUniforms looks at
+enum SpirvOp : uint32_t { kOpName = 5, kOpTypePointer = 32, kOpVariable = 59, kOpDecorate = 71 };
+enum SpirvDecoration : uint32_t { kDecorationBlock = 2, kDecorationLocation = 30, kDecorationBinding = 33 };
+enum SpirvStorageClass : uint32_t { kStorageUniformConstant = 0, kStorageUniform = 2 };
+
+// @return: the nul terminated string literal packed into words, or "" if it runs off the end
+static std::string ReadSpirvString(const uint32_t* words, size_t word_count);
+// @return: file extension compile_spirv.py takes the stage of GL type from, or nullptr if it has none
+static const char* GetStageExtension(unsigned int type);
+
+/* SpirvLibrary implementation */
+
+// Needs a current GL context; the directory is created if export is enabled
+SpirvLibrary::SpirvLibrary(const char* directory, bool export_sources) :
+    directory_{ directory },
+    supported_{ GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_gl_spirv },
+    export_sources_{ export_sources },
+    stats_{} {
+    if (export_sources_) {
+#ifdef _WIN32
+        _mkdir(directory_.c_str());
+#else
+        mkdir(directory_.c_str(), 0755);
+#endif
+    }
+}
+
+// @return: key of a stage of GL type built from source
+uint64_t SpirvLibrary::MakeKey(unsigned int type, const PreprocessedSource& source) {
+    uint64_t key{ HashBytes(kHashSeed, &type, sizeof(type)) };
+    std::vector<const char*> pieces;
+    std::vector<int> lengths;
+    source.GetPieces(pieces, lengths);
+    for (size_t i{}; i < pieces.size(); ++i) {
+        key = HashBytes(key, pieces[i], static_cast<size_t>(lengths[i]));
+    }
+    return key;
+}
+
+// @return: key the modules of a program are stored under, from the keys of all its stages in order
+uint64_t SpirvLibrary::MakeProgramKey(const uint64_t* stage_keys, size_t stage_count) {
+    return HashBytes(kHashSeed, stage_keys, stage_count * sizeof(uint64_t));
+}
+
+// Read the module of the stage of GL type in the program of program_key into words
+bool SpirvLibrary::Load(uint64_t program_key, unsigned int type, std::vector<uint32_t>& words) {
+    const char* extension{ GetStageExtension(type) };
+    if (!supported_ || !extension) {
+        return false;
+    }
+    std::ifstream file{ GetPath(program_key, extension, true), std::ios::binary | std::ios::ate };
+    std::streamoff size{ file ? static_cast<std::streamoff>(file.tellg()) : 0 };
+    if (size < static_cast<std::streamoff>(kSpirvHeaderWords * 4) || size % 4 != 0) {
+        ++stats_.missing;
+        return false;
+    }
+    words.resize(static_cast<size_t>(size / 4));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(words.data()), size) || words[0] != kSpirvMagic) {
+        ++stats_.missing;
+        return false;
+    }
+    ++stats_.loaded;
+    return true;
+}
+
+// Write the source of a stage for compile_spirv.py if export is enabled and it is not written yet
+void SpirvLibrary::Export(uint64_t program_key, unsigned int type, const PreprocessedSource& source) {
+    const char* extension{ GetStageExtension(type) };
+    if (!export_sources_ || !extension) {
+        return;
+    }
+    std::string path{ GetPath(program_key, extension, false) };
+    if (std::ifstream{ path }) {
+        return;
+    }
+    std::string text{ source.ToString() };
+    std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+    if (!file.write(text.data(), text.size())) {
+        std::cout << "ERROR [SPIR-V SOURCE EXPORT FAILED]\n" << path << std::endl;
+        return;
+    }
+    ++stats_.exported;
+}
+
+// @return: file the exported source of a stage is stored in, or its module if module is set
+std::string SpirvLibrary::GetPath(uint64_t program_key, const char* extension, bool module) const {
+    char name[40];
+    snprintf(name, sizeof(name), "/%016llx.%s%s", static_cast<unsigned long long>(program_key), extension, module ? ".spv" : "");
+    return directory_ + name;
+}
+
+// Append the default block uniforms and uniform blocks module names to uniforms
+bool ReflectSpirvUniforms(const std::vector<uint32_t>& module, std::vector<SpirvUniform>& uniforms) {
+    if (module.size() < kSpirvHeaderWords || module[0] != kSpirvMagic) {
+        return false;
+    }
+    // Pointer type -> pointee, and the variables in declaration order
+    struct Variable { uint32_t id; uint32_t pointer_type; uint32_t storage; };
+    std::unordered_map<uint32_t, std::string> names;
+    std::unordered_map<uint32_t, int> locations;
+    std::unordered_map<uint32_t, int> bindings;
+    std::unordered_set<uint32_t> blocks;
+    std::unordered_map<uint32_t, uint32_t> pointees;
+    std::vector<Variable> variables;
+
+    for (size_t i{ kSpirvHeaderWords }; i < module.size();) {
+        uint32_t word_count{ module[i] >> 16 };
+        uint32_t opcode{ module[i] & 0xFFFFu };
+        if (word_count == 0 || i + word_count > module.size()) {
+            return false;
+        }
+        const uint32_t* operands{ &module[i + 1] };
+        switch (opcode) {
+        case kOpName:
+            if (word_count >= 3) { names[operands[0]] = ReadSpirvString(operands + 1, word_count - 2); }
+            break;
+        case kOpDecorate:
+            if (word_count >= 3 && operands[1] == kDecorationBlock) { blocks.insert(operands[0]); }
+            if (word_count >= 4 && operands[1] == kDecorationLocation) { locations[operands[0]] = static_cast<int>(operands[2]); }
+            if (word_count >= 4 && operands[1] == kDecorationBinding) { bindings[operands[0]] = static_cast<int>(operands[2]); }
+            break;
+        case kOpTypePointer:
+            if (word_count >= 4) { pointees[operands[0]] = operands[2]; }
+            break;
+        case kOpVariable:
+            if (word_count >= 4) { variables.push_back({ operands[1], operands[0], operands[2] }); }
+            break;
+        }
+        i += word_count;
+    }
+
+    // Stages linked together by compile_spirv.py agree on locations and bindings, so a name seen
+    // in an earlier stage is the same uniform
+    auto is_listed = [&uniforms](const std::string& name, bool block) {
+        return std::any_of(uniforms.begin(), uniforms.end(),
+            [&name, block](const SpirvUniform& uniform) { return (uniform.location < 0) == block && uniform.name == name; });
+    };
+    for (const Variable& variable : variables) {
+        if (variable.storage == kStorageUniformConstant) {
+            auto location = locations.find(variable.id);
+            auto name = names.find(variable.id);
+            if (location != locations.end() && name != names.end() && !name->second.empty() && !is_listed(name->second, false)) {
+                uniforms.push_back(SpirvUniform{ name->second, location->second, -1 });
+            }
+        }
+        else if (variable.storage == kStorageUniform) {
+            // The block is named by its type; the variable is the instance name, often empty
+            uint32_t type{ pointees[variable.pointer_type] };
+            auto name = names.find(type);
+            if (blocks.count(type) && name != names.end() && !is_listed(name->second, true)) {
+                auto binding = bindings.find(variable.id);
+                uniforms.push_back(SpirvUniform{ name->second, -1, binding == bindings.end() ? 0 : binding->second });
+            }
+        }
+    }
+    return true;
+}
+
+/* Non-member helper implementation */
+
+// @return: the nul terminated string literal packed into words, or "" if it runs off the end
+std::string ReadSpirvString(const uint32_t* words, size_t word_count) {
+    std::string text;
+    for (size_t w{}; w < word_count; ++w) {
+        for (int byte{}; byte < 4; ++byte) {
+            char c{ static_cast<char>((words[w] >> (8 * byte)) & 0xFFu) };
+            if (c == '\0') {
+                return text;
+            }
+            text.push_back(c);
+        }
+    }
+    return std::string{};
+}
+
+// @return: file extension compile_spirv.py takes the stage of GL type from, or nullptr if it has none
+const char* GetStageExtension(unsigned int type) {
+    switch (type) {
+    case GL_VERTEX_SHADER: return "vert";
+    case GL_FRAGMENT_SHADER: return "frag";
+    case GL_COMPUTE_SHADER: return "comp";
+    default: return nullptr;
+    }
+}
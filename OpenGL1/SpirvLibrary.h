@@ -0,0 +1,77 @@
+/*
+Precompiled SPIR-V modules for ARB_gl_spirv (core in 4.6), so the GLSL front end (parsing,
+preprocessing, semantic checks) runs offline and the driver only lowers an already validated
+module with glShaderBinary + glSpecializeShader.
+
+Modules are found by the key of the whole program's preprocessed GLSL, <directory>/<key>.<stage>.spv,
+so any edit to a shader or its defines makes the program miss and fall back to GLSL; a stale module
+is never used. Keying by program rather than stage matters because GLSL 330 has no layout(location),
+so compile_spirv.py links the stages of a program together to give their uniforms one set of
+locations; a stage shared by two programs gets a module for each. With export enabled, every program
+that misses writes the preprocessed source of all its stages (<key>.vert, .frag or .comp).
+
+SPIR-V programs have no names for GL to reflect, so the uniform names and locations are read
+from the modules themselves (ReflectSpirvUniforms) and handed to the Shader.
+*/
+
+#ifndef SPIRV_LIBRARY_H
+#define SPIRV_LIBRARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class PreprocessedSource;
+
+// A default block uniform or uniform block named in a SPIR-V module
+struct SpirvUniform {
+    std::string name;
+    // Default block uniforms: first location; -1 for blocks
+    int location;
+    // Uniform blocks: binding decoration; -1 for default block uniforms
+    int binding;
+};
+
+// What the library did since it was created
+struct SpirvStats {
+    size_t loaded;
+    size_t missing;
+    size_t exported;
+};
+
+class SpirvLibrary {
+    std::string directory_;
+    // Driver takes SPIR-V shaders
+    bool supported_;
+    // Write the sources of stages without a module
+    bool export_sources_;
+    SpirvStats stats_;
+
+    // @return: file the exported source of a stage is stored in, or its module if module is set
+    std::string GetPath(uint64_t program_key, const char* extension, bool module) const;
+public:
+    // Needs a current GL context; the directory is created if export is enabled
+    explicit SpirvLibrary(const char* directory = "spirv", bool export_sources = false);
+
+    // @return: key of a stage of GL type built from source
+    static uint64_t MakeKey(unsigned int type, const PreprocessedSource& source);
+    // @return: key the modules of a program are stored under, from the keys of all its stages in order
+    static uint64_t MakeProgramKey(const uint64_t* stage_keys, size_t stage_count);
+    // Read the module of the stage of GL type in the program of program_key into words
+    // @return: false if the driver has no SPIR-V support or there is no valid module
+    bool Load(uint64_t program_key, unsigned int type, std::vector<uint32_t>& words);
+    // Write the source of a stage for compile_spirv.py if export is enabled and it is not written yet;
+    // call for every stage of the program, since they are compiled together
+    void Export(uint64_t program_key, unsigned int type, const PreprocessedSource& source);
+
+    bool IsSupported() const { return supported_; }
+    const SpirvStats& GetStats() const { return stats_; }
+};
+
+// Append the default block uniforms and uniform blocks module names to uniforms; names already in
+// uniforms (read from another stage of the program) are not added twice
+// @return: false if module is not SPIR-V
+bool ReflectSpirvUniforms(const std::vector<uint32_t>& module, std::vector<SpirvUniform>& uniforms);
+
+#endif // !SPIRV_LIBRARY_H
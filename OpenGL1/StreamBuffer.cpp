@@ -0,0 +1,145 @@
+/*
+Ring buffer for data that is rewritten every frame
+*/
+
+#include "StreamBuffer.h"
+#include "GLState.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <iostream>
+
+// Mapping goes through this target so the GL_ARRAY_BUFFER and GL_UNIFORM_BUFFER bindings
+// the renderer relies on are left alone. It stays bound; GLState makes rebinding it free
+static const GLenum kUploadTarget{ GL_COPY_WRITE_BUFFER };
+
+/* StreamBuffer implementation */
+
+// Create a buffer of region_count regions of region_size bytes each
+StreamBuffer::StreamBuffer(size_t region_size, int region_count) :
+    id_{},
+    region_size_{ region_size },
+    region_count_{ region_count },
+    region_{ region_count - 1 }, // so the first BeginFrame() lands on region 0
+    head_{},
+    mapped_{ nullptr },
+    mapped_from_{},
+    persistent_{ GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage },
+    fences_(region_count, nullptr),
+    bytes_streamed_{},
+    fence_wait_ms_{} {
+    GLsizeiptr total_size{ static_cast<GLsizeiptr>(region_size_ * region_count_) };
+
+    glGenBuffers(1, &id_);
+    GLState::GetInstance().BindBuffer(kUploadTarget, id_);
+    if (persistent_) {
+        // Immutable storage, mapped for the lifetime of the buffer. Coherent means no explicit
+        // flushes; the fences alone order CPU writes against GPU reads
+        GLbitfield flags{ GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT };
+        glBufferStorage(kUploadTarget, total_size, nullptr, flags);
+        mapped_ = static_cast<unsigned char*>(glMapBufferRange(kUploadTarget, 0, total_size, flags));
+        if (!mapped_) {
+            std::cout << "ERROR [STREAM BUFFER PERSISTENT MAP FAILED, ORPHANING INSTEAD]" << std::endl;
+            // Immutable storage cannot be respecified, so the fallback needs a new buffer name
+            glDeleteBuffers(1, &id_);
+            GLState::GetInstance().OnBufferDeleted(id_);
+            glGenBuffers(1, &id_);
+            GLState::GetInstance().BindBuffer(kUploadTarget, id_);
+            persistent_ = false;
+        }
+    }
+    if (!persistent_) {
+        glBufferData(kUploadTarget, total_size, nullptr, GL_STREAM_DRAW);
+    }
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (GLsync fence : fences_) {
+        if (fence) { glDeleteSync(fence); }
+    }
+    if (mapped_) {
+        GLState::GetInstance().BindBuffer(kUploadTarget, id_);
+        glUnmapBuffer(kUploadTarget);
+    }
+    glDeleteBuffers(1, &id_);
+    GLState::GetInstance().OnBufferDeleted(id_);
+}
+
+// Advance to the next region, waiting for the GPU to release it if needed
+void StreamBuffer::BeginFrame() {
+    Flush();
+    region_ = (region_ + 1) % region_count_;
+    head_ = 0;
+
+    if (!persistent_ && region_ == 0) {
+        // Orphan: the driver hands out fresh storage and frees the old one once the GPU is done,
+        // so the fences below are normally already signaled in this mode
+        GLState::GetInstance().BindBuffer(kUploadTarget, id_);
+        glBufferData(kUploadTarget, static_cast<GLsizeiptr>(region_size_ * region_count_), nullptr, GL_STREAM_DRAW);
+    }
+
+    GLsync& fence{ fences_[region_] };
+    if (fence) {
+        auto wait_start = std::chrono::steady_clock::now();
+        // Poll without flushing first, then flush once so the fence is guaranteed to signal
+        GLenum result{ glClientWaitSync(fence, 0, 0) };
+        while (result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+        }
+        if (result == GL_WAIT_FAILED) {
+            std::cout << "ERROR [STREAM BUFFER FENCE WAIT FAILED]" << std::endl;
+        }
+        fence_wait_ms_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wait_start).count();
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+// Reserve size bytes in the current region at a buffer offset aligned to alignment (power of two)
+// The buffer offset is what gets aligned: region_size_ need not be a multiple of alignment, and
+// glBindBufferRange checks the absolute offset against GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+void* StreamBuffer::Allocate(size_t size, size_t alignment, size_t* offset) {
+    size_t region_base{ region_ * region_size_ };
+    size_t start{ ((region_base + head_ + alignment - 1) & ~(alignment - 1)) - region_base };
+    if (start + size > region_size_) {
+        return nullptr;
+    }
+
+    if (!persistent_ && !mapped_) {
+        // Map the rest of the region; nothing else is using it, so skip synchronization
+        GLState::GetInstance().BindBuffer(kUploadTarget, id_);
+        mapped_from_ = region_base + start;
+        mapped_ = static_cast<unsigned char*>(glMapBufferRange(kUploadTarget, mapped_from_, region_size_ - start,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+        if (!mapped_) {
+            std::cout << "ERROR [STREAM BUFFER MAP FAILED]" << std::endl;
+            return nullptr;
+        }
+    }
+
+    head_ = start + size;
+    bytes_streamed_ += size;
+    *offset = region_base + start;
+    // The persistent mapping starts at buffer offset 0, the fallback one at mapped_from_
+    return mapped_ + (*offset - (persistent_ ? 0 : mapped_from_));
+}
+
+// Make everything allocated so far visible to GL
+void StreamBuffer::Flush() {
+    if (persistent_ || !mapped_) {
+        return;
+    }
+    GLState::GetInstance().BindBuffer(kUploadTarget, id_);
+    glUnmapBuffer(kUploadTarget);
+    mapped_ = nullptr;
+}
+
+// Fence the current region after the frame's last draw that reads it
+void StreamBuffer::EndFrame() {
+    Flush();
+    if (fences_[region_]) {
+        glDeleteSync(fences_[region_]);
+    }
+    fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,71 @@
+/*
+Ring buffer for data that is rewritten every frame (instance transforms, uniform blocks).
+One GL buffer is split into N frame regions; the CPU writes region i while the GPU
+may still be reading regions i-1..i-N+1, and a fence per region keeps the CPU from
+overwriting data the GPU has not consumed yet.
+
+With ARB_buffer_storage (core in 4.4) the buffer is mapped once, persistently and coherently,
+so writes land directly in GPU-visible memory. On plain GL 3.3 the current region is mapped
+with INVALIDATE_RANGE | UNSYNCHRONIZED on demand and the whole buffer is orphaned on wrap-around.
+*/
+
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+// Opaque GL fence type, so this header does not need to pull in glad
+struct __GLsync;
+
+class StreamBuffer {
+    unsigned int id_;
+    size_t region_size_;
+    int region_count_;
+    // Region being written this frame, and the write head inside it
+    int region_;
+    size_t head_;
+
+    // Persistent: base of the whole buffer, always valid
+    // Fallback: base of the mapped range [mapped_from_, region end), or null while unmapped
+    unsigned char* mapped_;
+    size_t mapped_from_;
+    bool persistent_;
+
+    // Fence placed after the last draw that read each region
+    std::vector<__GLsync*> fences_;
+
+    // Counters since the last ResetCounters()
+    size_t bytes_streamed_;
+    double fence_wait_ms_;
+public:
+    StreamBuffer() = delete;
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+    // Create a buffer of region_count regions of region_size bytes each
+    StreamBuffer(size_t region_size, int region_count = 3);
+    ~StreamBuffer();
+
+    // Advance to the next region, waiting for the GPU to release it if needed
+    void BeginFrame();
+    // Reserve size bytes in the current region at a buffer offset aligned to alignment (power of two);
+    // the first allocation of a region may be padded by up to alignment - 1 bytes
+    // @return: CPU write pointer, or nullptr if the region is full; *offset receives the buffer offset
+    void* Allocate(size_t size, size_t alignment, size_t* offset);
+    // Make everything allocated so far visible to GL; must be called before drawing from it
+    // No-op for persistent coherent mappings
+    void Flush();
+    // Fence the current region after the frame's last draw that reads it
+    void EndFrame();
+
+    unsigned int GetId() const { return id_; }
+    bool IsPersistent() const { return persistent_; }
+
+    /* Counters */
+    size_t GetBytesStreamed() const { return bytes_streamed_; }
+    // Time spent blocked on fences for regions the GPU had not released yet
+    double GetFenceWaitMs() const { return fence_wait_ms_; }
+    void ResetCounters() { bytes_streamed_ = 0; fence_wait_ms_ = 0.; }
+};
+
+#endif // !STREAM_BUFFER_H
@@ -0,0 +1,288 @@
+/*
+Reference counted, deduplicated textures under a VRAM budget
+*/
+
+#include "TextureManager.h"
+#include "BakedTexture.h"
+#include "BlockCompression.h"
+#include "GLState.h"
+#include "MappedFile.h"
+#include "TextureStreamer.h"
+#include "TextureUpload.h"
+#include "stb_image_.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+// @return: absolute path with . and .. resolved (and links on POSIX), or path itself if it does not exist
+static std::string CanonicalizePath(const std::string& path);
+
+/* TextureHandle implementation */
+
+TextureHandle::TextureHandle(const TextureHandle& other) : manager_{ other.manager_ }, slot_{ other.slot_ } {
+    if (manager_) {
+        manager_->AddReference(slot_);
+    }
+}
+
+TextureHandle::TextureHandle(TextureHandle&& other) : manager_{ other.manager_ }, slot_{ other.slot_ } {
+    other.manager_ = nullptr;
+}
+
+// Copy and swap; other releases what this held
+TextureHandle& TextureHandle::operator=(TextureHandle other) {
+    std::swap(manager_, other.manager_);
+    std::swap(slot_, other.slot_);
+    return *this;
+}
+
+TextureHandle::~TextureHandle() {
+    if (manager_) {
+        manager_->RemoveReference(slot_);
+    }
+}
+
+// @return: GL texture name, or 0 for an empty handle
+unsigned int TextureHandle::GetTexture() const {
+    return manager_ ? manager_->entries_[slot_].texture : 0;
+}
+
+/* TextureManager implementation */
+
+// Needs a current GL context; streamer may be nullptr and must outlive the manager otherwise
+TextureManager::TextureManager(size_t budget, TextureStreamer* streamer) :
+    budget_{ budget },
+    streamer_{ streamer },
+    resident_bytes_{},
+    stats_{} {}
+
+// Deletes every texture; handles must not outlive the manager
+TextureManager::~TextureManager() {
+    for (size_t slot{}; slot < entries_.size(); ++slot) {
+        if (entries_[slot].texture != 0) {
+            Destroy(slot);
+        }
+    }
+}
+
+// @return: handle to the texture of path; empty if the file cannot be read or decoded
+TextureHandle TextureManager::Acquire(const std::string& path) {
+    std::string canonical{ CanonicalizePath(path) };
+    auto known_path = by_path_.find(canonical);
+    if (known_path != by_path_.end()) {
+        ++stats_.hits;
+        AddReference(known_path->second);
+        return TextureHandle{ this, known_path->second };
+    }
+
+    // A new path may still be a copy of a file already loaded
+    MappedFile source{ canonical.c_str() };
+    if (!source.IsValid()) {
+        std::cout << "ERROR [TEXTURE FILE NOT FOUND]\n" << path << std::endl;
+        ++stats_.failed;
+        return TextureHandle{};
+    }
+    // The same hash bakes record, so it also tells whether a bake of this file is current
+    uint64_t content_hash{ HashTextureSource(source.GetData(), source.GetSize()) };
+    auto known_content = by_content_.find(content_hash);
+    if (known_content != by_content_.end()) {
+        ++stats_.content_hits;
+        size_t slot{ known_content->second };
+        entries_[slot].paths.push_back(canonical);
+        by_path_[canonical] = slot;
+        AddReference(slot);
+        return TextureHandle{ this, slot };
+    }
+
+    size_t bytes{};
+    bool streamed{};
+    unsigned int texture{ Load(canonical, source, content_hash, &bytes, &streamed) };
+    if (texture == 0) {
+        ++stats_.failed;
+        return TextureHandle{};
+    }
+    ++stats_.misses;
+
+    size_t slot{ entries_.size() };
+    if (!free_slots_.empty()) {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    else {
+        entries_.emplace_back();
+    }
+    Entry& entry{ entries_[slot] };
+    entry.paths.assign(1, canonical);
+    entry.content_hash = content_hash;
+    entry.texture = texture;
+    entry.streamed = streamed;
+    entry.bytes = bytes;
+    entry.references = 1;
+    entry.lru = unreferenced_.end();
+    by_path_[canonical] = slot;
+    by_content_[content_hash] = slot;
+
+    resident_bytes_ += bytes;
+    // The new texture is referenced, so only older ones can make room for it
+    Evict();
+    stats_.peak_bytes = std::max(stats_.peak_bytes, resident_bytes_);
+    return TextureHandle{ this, slot };
+}
+
+// Change the budget, evicting right away if the resident textures no longer fit
+void TextureManager::SetBudget(size_t budget) {
+    budget_ = budget;
+    Evict();
+}
+
+void TextureManager::AddReference(size_t slot) {
+    Entry& entry{ entries_[slot] };
+    if (entry.references++ == 0) {
+        unreferenced_.erase(entry.lru);
+        entry.lru = unreferenced_.end();
+    }
+}
+
+void TextureManager::RemoveReference(size_t slot) {
+    Entry& entry{ entries_[slot] };
+    if (--entry.references == 0) {
+        entry.lru = unreferenced_.insert(unreferenced_.end(), slot);
+        Evict();
+    }
+}
+
+// Delete unreferenced textures, oldest first, until the resident bytes fit the budget
+void TextureManager::Evict() {
+    while (resident_bytes_ > budget_ && !unreferenced_.empty()) {
+        size_t slot{ unreferenced_.front() };
+        ++stats_.evictions;
+        stats_.evicted_bytes += entries_[slot].bytes;
+        Destroy(slot);
+    }
+}
+
+// Delete the texture of slot and forget its paths and contents
+void TextureManager::Destroy(size_t slot) {
+    Entry& entry{ entries_[slot] };
+    if (entry.lru != unreferenced_.end()) {
+        unreferenced_.erase(entry.lru);
+        entry.lru = unreferenced_.end();
+    }
+    for (const std::string& path : entry.paths) {
+        by_path_.erase(path);
+    }
+    by_content_.erase(entry.content_hash);
+    if (entry.streamed) {
+        // Also drops the load if the image has not arrived yet
+        streamer_->Release(entry.texture);
+    }
+    else {
+        glDeleteTextures(1, &entry.texture);
+        GLState::GetInstance().OnTextureDeleted(entry.texture);
+    }
+    resident_bytes_ -= entry.bytes;
+    entry.paths.clear();
+    entry.texture = 0;
+    entry.bytes = 0;
+    free_slots_.push_back(slot);
+}
+
+// @return: texture holding the image of the mapped file source, or 0 if it cannot be decoded
+// A current bake next to the file is uploaded straight from its mapping; otherwise the file is decoded.
+// The size comes from the image header, so streamed textures are counted before their pixels arrive
+unsigned int TextureManager::Load(const std::string& path, const MappedFile& source, uint64_t content_hash, size_t* bytes, bool* streamed) {
+    BakedTexture baked{ GetBakedTexturePath(path), content_hash };
+    BlockFormat block_format;
+    bool sampleable{ !baked.IsValid() || !baked.IsCompressed()
+        || (FindBlockFormat(baked.GetHeader().internal_format, &block_format) && IsBlockFormatSupported(block_format)) };
+    if (baked.IsValid() && sampleable) {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        GLState& gl_state{ GLState::GetInstance() };
+        gl_state.BindTextureForEdit(GL_TEXTURE0 + kTextureUploadUnit, GL_TEXTURE_2D, texture);
+        SetTextureParameters();
+        gl_state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        UploadBakedTexture(baked);
+        const BakedTextureHeader& header{ baked.GetHeader() };
+        *bytes = baked.IsCompressed() ? baked.GetDataBytes()
+            : EstimateTextureBytes(static_cast<int>(header.width), static_cast<int>(header.height), 4);
+        ++stats_.baked;
+        return texture;
+    }
+    if (!sampleable) {
+        std::cout << "Baked texture format is not supported by the GL driver, decoding the source instead: " << path << std::endl;
+    }
+    else if (baked.GetStatus() == BakedTextureStatus::kStale) {
+        std::cout << "Baked texture is stale, decoding the source instead: " << path << std::endl;
+    }
+    else if (baked.GetStatus() == BakedTextureStatus::kInvalid) {
+        std::cout << "Baked texture is not a valid bake, decoding the source instead: " << path << std::endl;
+    }
+
+    const stbi_uc* data{ reinterpret_cast<const stbi_uc*>(source.GetData()) };
+    int size{ static_cast<int>(source.GetSize()) };
+    int width{}, height{}, channels{};
+    if (!stbi_info_from_memory(data, size, &width, &height, &channels)) {
+        std::cout << "ERROR [TEXTURE DECODE FAILED]\n" << path << std::endl;
+        return 0;
+    }
+    // RGB8 and RGBA8 alike; drivers pad RGB texels to 4 bytes
+    *bytes = EstimateTextureBytes(width, height, 4);
+    if (streamer_) {
+        *streamed = true;
+        // The streamer maps the file again on its decode thread; by now the pages are in the OS file cache
+        return streamer_->Request(path);
+    }
+
+    // Grey and grey + alpha are expanded as in the streamer, so both paths make the same textures
+    int components{ (channels == 2 || channels == 4) ? 4 : 3 };
+    unsigned char* pixels{ stbi_load_from_memory(data, size, &width, &height, &channels, components) };
+    if (!pixels) {
+        std::cout << "ERROR [TEXTURE DECODE FAILED]\n" << path << std::endl;
+        return 0;
+    }
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    GLState::GetInstance().BindTextureForEdit(GL_TEXTURE0 + kTextureUploadUnit, GL_TEXTURE_2D, texture);
+    SetTextureParameters();
+    GLenum format{ components == 4 ? static_cast<GLenum>(GL_RGBA) : static_cast<GLenum>(GL_RGB) };
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, components == 4 ? GL_RGBA8 : GL_RGB8, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    stbi_image_free(pixels);
+    return texture;
+}
+
+// @return: estimated VRAM of a width x height texture with a full mip chain
+size_t EstimateTextureBytes(int width, int height, int bytes_per_texel) {
+    size_t bytes{};
+    while (true) {
+        bytes += static_cast<size_t>(width) * height * bytes_per_texel;
+        if (width == 1 && height == 1) {
+            return bytes;
+        }
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+}
+
+/* Non-member helper implementation */
+
+// @return: absolute path with . and .. resolved (and links on POSIX), or path itself if it does not exist
+std::string CanonicalizePath(const std::string& path) {
+#ifdef _WIN32
+    char* resolved{ _fullpath(nullptr, path.c_str(), 0) };
+#else
+    char* resolved{ realpath(path.c_str(), nullptr) };
+#endif
+    if (!resolved) {
+        return path;
+    }
+    std::string canonical{ resolved };
+    free(resolved);
+    return canonical;
+}
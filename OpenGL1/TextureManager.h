@@ -0,0 +1,129 @@
+/*
+Registry of loaded textures. Acquire returns a handle to the texture of a file, loading it only
+if no file with the same canonical path or the same contents is loaded already, so every copy of
+an image shares one GL texture. Handles are reference counted; once the last one is gone the
+texture stays resident for later Acquires until the estimated VRAM of all textures exceeds the
+budget, at which point unreferenced textures are deleted, least recently released first.
+
+A file with a current bake next to it (TextureBaker) is uploaded from the bake's mapping. Other
+loads go through a TextureStreamer when one is given (the handle's texture shows a placeholder
+until the image is uploaded), otherwise they decode and upload on the spot. GL thread only.
+*/
+
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class MappedFile;
+class TextureManager;
+class TextureStreamer;
+
+// Estimated VRAM of all textures when no budget is given
+const size_t kDefaultTextureBudget{ 256u << 20 };
+
+// What the manager did since it was created
+struct TextureManagerStats {
+    // Acquires of a path already loaded
+    size_t hits;
+    // Acquires of a new path whose contents match a loaded texture
+    size_t content_hits;
+    // Acquires that loaded a texture
+    size_t misses;
+    // Misses served from a current bake (see BakedTexture.h) instead of decoding the file
+    size_t baked;
+    size_t failed;
+    size_t evictions;
+    size_t evicted_bytes;
+    // Highest resident_bytes seen; above the budget when referenced textures alone exceed it
+    size_t peak_bytes;
+};
+
+// Shared reference to a managed texture; empty handles have texture 0
+class TextureHandle {
+    friend class TextureManager;
+
+    TextureManager* manager_;
+    size_t slot_;
+
+    TextureHandle(TextureManager* manager, size_t slot) : manager_{ manager }, slot_{ slot } {}
+public:
+    TextureHandle() : manager_{ nullptr }, slot_{} {}
+    TextureHandle(const TextureHandle& other);
+    TextureHandle(TextureHandle&& other);
+    TextureHandle& operator=(TextureHandle other);
+    ~TextureHandle();
+
+    // @return: GL texture name, or 0 for an empty handle
+    unsigned int GetTexture() const;
+    bool IsValid() const { return manager_ != nullptr; }
+};
+
+class TextureManager {
+    friend class TextureHandle;
+
+    struct Entry {
+        // Canonical paths that resolved to this texture; the first one was loaded
+        std::vector<std::string> paths;
+        uint64_t content_hash;
+        unsigned int texture;
+        // Created by the streamer, which must also delete it
+        bool streamed;
+        size_t bytes;
+        int references;
+        // Position in unreferenced_ while references is 0
+        std::list<size_t>::iterator lru;
+    };
+
+    size_t budget_;
+    TextureStreamer* streamer_;
+    // Slots of deleted entries are reused; texture 0 marks a free slot
+    std::vector<Entry> entries_;
+    std::vector<size_t> free_slots_;
+    std::unordered_map<std::string, size_t> by_path_;
+    std::unordered_map<uint64_t, size_t> by_content_;
+    // Unreferenced entries, least recently released first
+    std::list<size_t> unreferenced_;
+    size_t resident_bytes_;
+    TextureManagerStats stats_;
+
+    void AddReference(size_t slot);
+    void RemoveReference(size_t slot);
+    // Delete unreferenced textures, oldest first, until the resident bytes fit the budget
+    void Evict();
+    // Delete the texture of slot and forget its paths and contents
+    void Destroy(size_t slot);
+    // @return: texture holding the image of the mapped file source, or 0 if it cannot be decoded
+    // *bytes receives the estimated VRAM, *streamed whether the streamer owns the texture
+    unsigned int Load(const std::string& path, const MappedFile& source, uint64_t content_hash, size_t* bytes, bool* streamed);
+public:
+    // Needs a current GL context; streamer may be nullptr and must outlive the manager otherwise
+    explicit TextureManager(size_t budget = kDefaultTextureBudget, TextureStreamer* streamer = nullptr);
+    // Deletes every texture; handles must not outlive the manager
+    ~TextureManager();
+    TextureManager(const TextureManager&) = delete;
+    TextureManager& operator=(const TextureManager&) = delete;
+
+    // @return: handle to the texture of path; empty if the file cannot be read or decoded
+    TextureHandle Acquire(const std::string& path);
+    // Change the budget, evicting right away if the resident textures no longer fit
+    void SetBudget(size_t budget);
+
+    size_t GetBudget() const { return budget_; }
+    // @return: estimated VRAM of every resident texture, referenced or not
+    size_t GetResidentBytes() const { return resident_bytes_; }
+    // @return: textures currently resident
+    size_t GetTextureCount() const { return entries_.size() - free_slots_.size(); }
+    const TextureManagerStats& GetStats() const { return stats_; }
+};
+
+// @return: estimated VRAM of a width x height texture with a full mip chain
+// bytes_per_texel is what the driver stores, e.g. 4 for RGB8, which is usually padded to RGBA8
+size_t EstimateTextureBytes(int width, int height, int bytes_per_texel);
+
+#endif // !TEXTURE_MANAGER_H
@@ -0,0 +1,221 @@
+/*
+Asynchronous texture loading through decode threads and a pixel buffer ring
+*/
+
+#include "TextureStreamer.h"
+#include "GLState.h"
+#include "MappedFile.h"
+#include "StreamBuffer.h"
+#include "TextureUpload.h"
+#include "stb_image_.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// Regions in the upload ring; a region is reused once the GPU has read the uploads of 3 frames ago
+static const int kUploadRingRegions{ 3 };
+// Shown until the image arrives: one mid grey texel
+static const unsigned char kPlaceholderTexel[4]{ 128, 128, 128, 255 };
+
+/* TextureStreamer implementation */
+
+// Needs a current GL context
+TextureStreamer::TextureStreamer(size_t upload_budget, size_t decode_threads) :
+    upload_budget_{ upload_budget },
+    upload_ring_{ std::make_unique<StreamBuffer>(upload_budget, kUploadRingRegions) },
+    cpu_mips_{},
+    next_ticket_{},
+    stopping_{ false },
+    stats_{} {
+    if (decode_threads == 0) {
+        decode_threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+    }
+    for (size_t i{}; i < decode_threads; ++i) {
+        threads_.emplace_back(&TextureStreamer::DecodeLoop, this);
+    }
+}
+
+// Stops the decode threads and deletes every texture the streamer still owns
+TextureStreamer::~TextureStreamer() {
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+    GLState& gl_state{ GLState::GetInstance() };
+    for (unsigned int texture : textures_) {
+        glDeleteTextures(1, &texture);
+        gl_state.OnTextureDeleted(texture);
+    }
+}
+
+// Start loading path; GL thread only
+unsigned int TextureStreamer::Request(const std::string& path) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    GLState::GetInstance().BindTextureForEdit(GL_TEXTURE0 + kTextureUploadUnit, GL_TEXTURE_2D, texture);
+    SetTextureParameters();
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, kPlaceholderTexel);
+
+    uint64_t ticket{ ++next_ticket_ };
+    textures_.push_back(texture);
+    pending_[texture] = ticket;
+    ++stats_.requested;
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        decode_queue_.push_back(DecodeJob{ path, texture, ticket, cpu_mips_, mip_options_, 0, 0, 0, 0, {} });
+    }
+    wake_.notify_one();
+    return texture;
+}
+
+// Delete texture, dropping its load if it is still pending; GL thread only
+// A decode already running finishes, but its result no longer matches a pending ticket
+void TextureStreamer::Release(unsigned int texture) {
+    auto owned = std::find(textures_.begin(), textures_.end(), texture);
+    if (owned == textures_.end()) {
+        return;
+    }
+    textures_.erase(owned);
+    if (pending_.erase(texture)) {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        decode_queue_.erase(std::remove_if(decode_queue_.begin(), decode_queue_.end(),
+            [texture](const DecodeJob& job) { return job.texture == texture; }), decode_queue_.end());
+    }
+    glDeleteTextures(1, &texture);
+    GLState::GetInstance().OnTextureDeleted(texture);
+}
+
+// Upload finished images until the budget is spent; call once per frame on the GL thread
+void TextureStreamer::Update() {
+    auto start = std::chrono::steady_clock::now();
+    upload_ring_->BeginFrame();
+    size_t frame_bytes{};
+    while (true) {
+        DecodeJob job;
+        {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            if (decoded_.empty()) {
+                break;
+            }
+            size_t bytes{ decoded_.front().pixels.size() };
+            // Always let one image through, or one larger than the budget would never be uploaded
+            if (frame_bytes > 0 && frame_bytes + bytes > upload_budget_) {
+                break;
+            }
+            job = std::move(decoded_.front());
+            decoded_.pop_front();
+        }
+        // Released, or the name now belongs to a newer request
+        auto pending = pending_.find(job.texture);
+        if (pending == pending_.end() || pending->second != job.ticket) {
+            continue;
+        }
+        pending_.erase(pending);
+        if (job.pixels.empty()) {
+            std::cout << "ERROR [TEXTURE DECODE FAILED]\n" << job.path << std::endl;
+            ++stats_.failed;
+            continue;
+        }
+        Upload(job);
+        frame_bytes += job.pixels.size();
+    }
+    upload_ring_->EndFrame();
+    stats_.update_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Build mip chains on the decode threads with options instead of glGenerateMipmap on the GL thread
+void TextureStreamer::SetCpuMips(bool enabled, const MipOptions& options) {
+    cpu_mips_ = enabled;
+    mip_options_ = options;
+    mip_options_.jobs = nullptr;
+}
+
+// Upload a decoded image into its texture through the ring, or directly if it does not fit
+void TextureStreamer::Upload(const DecodeJob& job) {
+    GLState& gl_state{ GLState::GetInstance() };
+    gl_state.BindTextureForEdit(GL_TEXTURE0 + kTextureUploadUnit, GL_TEXTURE_2D, job.texture);
+    GLenum format{ job.channels == 4 ? static_cast<GLenum>(GL_RGBA) : static_cast<GLenum>(GL_RGB) };
+    GLint internal_format{ job.channels == 4 ? GL_RGBA8 : GL_RGB8 };
+
+    size_t offset{};
+    void* staging{ upload_ring_->Allocate(job.pixels.size(), 4, &offset) };
+    const void* source{ job.pixels.data() };
+    if (staging) {
+        memcpy(staging, job.pixels.data(), job.pixels.size());
+        upload_ring_->Flush();
+        gl_state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_ring_->GetId());
+        // With a buffer bound to GL_PIXEL_UNPACK_BUFFER the pointer is an offset into it
+        source = reinterpret_cast<const void*>(offset);
+    }
+    else {
+        gl_state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        ++stats_.direct_uploads;
+    }
+    // RGB rows are not 4 byte aligned in general
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int width{ job.width }, height{ job.height };
+    for (int level{}; level < job.levels; ++level) {
+        glTexImage2D(GL_TEXTURE_2D, level, internal_format, width, height, 0, format, GL_UNSIGNED_BYTE, source);
+        source = static_cast<const char*>(source) + static_cast<size_t>(width) * height * job.channels;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (job.levels == 1) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    // Client memory pointers everywhere else expect no unpack buffer
+    gl_state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    ++stats_.uploaded;
+    stats_.bytes_uploaded += job.pixels.size();
+}
+
+// Decode thread body
+void TextureStreamer::DecodeLoop() {
+    while (true) {
+        DecodeJob job;
+        {
+            std::unique_lock<std::mutex> lock{ mutex_ };
+            wake_.wait(lock, [this] { return stopping_ || !decode_queue_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            job = std::move(decode_queue_.front());
+            decode_queue_.pop_front();
+        }
+
+        // One mapping serves both the header and the decode, so the file is opened and read once
+        // Grey and grey + alpha are expanded so every texture is RGB8 or RGBA8
+        MappedFile file{ job.path.c_str() };
+        const stbi_uc* data{ reinterpret_cast<const stbi_uc*>(file.GetData()) };
+        int size{ static_cast<int>(file.GetSize()) };
+        int channels{};
+        if (file.IsValid() && stbi_info_from_memory(data, size, &job.width, &job.height, &channels)) {
+            job.channels = (channels == 2 || channels == 4) ? 4 : 3;
+            unsigned char* pixels{ stbi_load_from_memory(data, size, &job.width, &job.height, &channels, job.channels) };
+            if (pixels) {
+                job.pixels.assign(pixels, pixels + static_cast<size_t>(job.width) * job.height * job.channels);
+                job.levels = 1;
+                if (job.cpu_mips) {
+                    for (const std::vector<unsigned char>& level : GenerateMipChain(pixels, job.width, job.height, job.channels, 1, job.mip_options)) {
+                        job.pixels.insert(job.pixels.end(), level.begin(), level.end());
+                        ++job.levels;
+                    }
+                }
+                stbi_image_free(pixels);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        decoded_.push_back(std::move(job));
+    }
+}
@@ -0,0 +1,70 @@
+/*
+Uploads of block compressed and baked textures
+*/
+
+#include "TextureUpload.h"
+#include "BakedTexture.h"
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <vector>
+
+// @return: whether the current GL context can sample format; needs a current GL context
+// RGTC is core; the S3TC answer of the first context asked is kept
+bool IsBlockFormatSupported(BlockFormat format) {
+    if (format == BlockFormat::kBC4 || format == BlockFormat::kBC5) {
+        return true;
+    }
+    static const bool s3tc{ [] {
+        GLint count{};
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i{}; i < count; ++i) {
+            const char* extension{ reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)) };
+            if (extension && strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0) {
+                return true;
+            }
+        }
+        return false;
+    }() };
+    return s3tc;
+}
+
+// Compress rgba and upload it with glCompressedTexImage2D as level of the texture bound to GL_TEXTURE_2D
+// Needs no bound GL_PIXEL_UNPACK_BUFFER
+void UploadCompressedImage(const unsigned char* rgba, int width, int height, int level, BlockFormat format,
+    BlockQuality quality, JobSystem* jobs) {
+    std::vector<unsigned char> blocks(GetCompressedSize(format, width, height));
+    CompressImage(rgba, width, height, format, quality, blocks.data(), jobs);
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, GetBlockFormatGL(format), width, height, 0,
+        static_cast<GLsizei>(blocks.size()), blocks.data());
+}
+
+// Upload every level of baked into the texture bound to GL_TEXTURE_2D; needs a valid bake and no bound GL_PIXEL_UNPACK_BUFFER
+// Rows are padded to GL's default unpack alignment of 4, so no pixel store state changes
+void UploadBakedTexture(const BakedTexture& baked) {
+    const BakedTextureHeader& header{ baked.GetHeader() };
+    for (uint32_t i{}; i < header.level_count; ++i) {
+        const BakedTextureLevel& level{ baked.GetLevel(i) };
+        if (baked.IsCompressed()) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, header.internal_format, level.width, level.height, 0,
+                static_cast<GLsizei>(level.size), baked.GetLevelData(i));
+        }
+        else {
+            glTexImage2D(GL_TEXTURE_2D, i, header.internal_format, level.width, level.height, 0,
+                header.format, header.type, baked.GetLevelData(i));
+        }
+    }
+    // A chain cut short by the baker would otherwise leave the texture incomplete
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(header.level_count - 1));
+}
+
+// Give the texture bound to GL_TEXTURE_2D the wrap and filter settings of managed and streamed textures
+void SetTextureParameters() {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    // Every load path leaves a full chain: glGenerateMipmap, the streamer's CPU mips or a bake;
+    // the streamer's 1x1 placeholder is one by itself
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
@@ -0,0 +1,26 @@
+/*
+GL side of the offline texture formats: whether the driver samples a block format, and uploads of
+block compressed images and of baked textures into the texture bound to GL_TEXTURE_2D. Also the
+sampling parameters TextureManager and TextureStreamer give every texture they create.
+BlockCompression and BakedTexture stay free of GL calls so TextureBaker links without a context.
+*/
+
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include "BlockCompression.h"
+
+class BakedTexture;
+class JobSystem;
+
+// @return: whether the current GL context can sample format; needs a current GL context
+bool IsBlockFormatSupported(BlockFormat format);
+// Compress rgba and upload it with glCompressedTexImage2D as level of the texture bound to GL_TEXTURE_2D
+void UploadCompressedImage(const unsigned char* rgba, int width, int height, int level, BlockFormat format,
+    BlockQuality quality, JobSystem* jobs = nullptr);
+// Upload every level of baked into the texture bound to GL_TEXTURE_2D; needs a valid bake and no bound GL_PIXEL_UNPACK_BUFFER
+void UploadBakedTexture(const BakedTexture& baked);
+// Give the texture bound to GL_TEXTURE_2D the wrap and filter settings of managed and streamed textures
+void SetTextureParameters();
+
+#endif // !TEXTURE_UPLOAD_H
@@ -0,0 +1,292 @@
+/*
+Data-driven vertex attribute setup plus an encoder that packs float meshes
+into compact GPU vertex formats
+*/
+
+#include "VertexLayout.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Helpers to quantize/dequantize a single component
+static int16_t EncodeSnorm16(float value);
+static float DecodeSnorm16(int16_t value);
+static uint16_t EncodeUnorm16(float value);
+static float DecodeUnorm16(uint16_t value);
+static uint32_t EncodeSnorm10_10_10_2(const glm::vec3& value);
+static glm::vec3 DecodeSnorm10_10_10_2(uint32_t packed);
+
+// @return: size in bytes of one component of a GL type
+static unsigned int ComponentSize(unsigned int type);
+
+/* VertexLayout implementation */
+
+// Append an attribute right after the previous one
+VertexLayout& VertexLayout::Add(unsigned int location, int components, unsigned int type, bool normalized, unsigned int divisor) {
+    unsigned int offset{ (stride_ + 3u) & ~3u };
+    // Packed formats hold every component in one 32 bit word
+    unsigned int size{ (type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV)
+        ? 4u : ComponentSize(type) * components };
+    attributes_.push_back(VertexAttribute{ location, components, type, normalized, offset, divisor });
+    stride_ = (offset + size + 3u) & ~3u;
+    return *this;
+}
+
+// Point the attributes at the buffer bound to GL_ARRAY_BUFFER, starting base_offset bytes in
+void VertexLayout::Apply(size_t base_offset) const {
+    for (const VertexAttribute& attr : attributes_) {
+        glVertexAttribPointer(attr.location, attr.components, attr.type, attr.normalized ? GL_TRUE : GL_FALSE,
+            stride_, reinterpret_cast<void*>(base_offset + attr.offset));
+        glEnableVertexAttribArray(attr.location);
+        glVertexAttribDivisor(attr.location, attr.divisor);
+    }
+}
+
+/* Vertex encoding */
+
+// @return: mesh packed in the requested formats, along with its layout and error report
+EncodedMesh EncodeMesh(const Mesh& mesh, const VertexFormat& format) {
+    EncodedMesh encoded;
+    encoded.indices = mesh.indices;
+    VertexEncodeReport& report{ encoded.report };
+    report = VertexEncodeReport{};
+
+    // Quantized positions are stored in [-1, 1] relative to the bounding box
+    glm::vec3 lo{ mesh.vertices.empty() ? glm::vec3{ 0.f } : mesh.vertices[0].position };
+    glm::vec3 hi{ lo };
+    for (const MeshVertex& v : mesh.vertices) {
+        lo = glm::min(lo, v.position);
+        hi = glm::max(hi, v.position);
+    }
+    if (format.position == PositionFormat::kFloat) {
+        encoded.position_scale = glm::vec3{ 1.f };
+        encoded.position_bias = glm::vec3{ 0.f };
+    }
+    else {
+        encoded.position_bias = (lo + hi) * 0.5f;
+        encoded.position_scale = glm::max((hi - lo) * 0.5f, glm::vec3{ 1e-20f });
+    }
+    float max_half_extent{ std::max({ encoded.position_scale.x, encoded.position_scale.y, encoded.position_scale.z }) };
+    // The float math of the scale/bias round trip adds a few ulps on top of the quantization step
+    float transform_slack{ 4.f * FLT_EPSILON * std::max({ std::fabs(lo.x), std::fabs(lo.y), std::fabs(lo.z), std::fabs(hi.x), std::fabs(hi.y), std::fabs(hi.z) }) };
+
+    // Build the layout and the error bounds for each format
+    VertexLayout& layout{ encoded.layout };
+    report.float_bytes_per_vertex = 5 * sizeof(float);
+    switch (format.position) {
+        case PositionFormat::kFloat: {
+            layout.Add(kPositionAttrib, 3, GL_FLOAT);
+            break;
+        }
+        case PositionFormat::kHalf: {
+            layout.Add(kPositionAttrib, 3, GL_HALF_FLOAT);
+            // 11 significant bits for values in [-1, 1]: half an ulp just below 1.0
+            report.position_error_bound = max_half_extent * std::ldexp(1.f, -12) + transform_slack;
+            break;
+        }
+        case PositionFormat::kSnorm16: {
+            layout.Add(kPositionAttrib, 3, GL_SHORT, true);
+            report.position_error_bound = max_half_extent * 0.5f / 32767.f + transform_slack;
+            break;
+        }
+    }
+    unsigned int tex_coord_offset{ (layout.GetStride() + 3u) & ~3u };
+    switch (format.tex_coord) {
+        case TexCoordFormat::kFloat: {
+            layout.Add(kTexCoordAttrib, 2, GL_FLOAT);
+            break;
+        }
+        case TexCoordFormat::kUnorm16: {
+            layout.Add(kTexCoordAttrib, 2, GL_UNSIGNED_SHORT, true);
+            report.tex_coord_error_bound = 0.5f / 65535.f;
+            break;
+        }
+    }
+    unsigned int normal_offset{ (layout.GetStride() + 3u) & ~3u };
+    switch (format.normal) {
+        case NormalFormat::kNone: {
+            break;
+        }
+        case NormalFormat::kFloat: {
+            layout.Add(kNormalAttrib, 3, GL_FLOAT);
+            report.float_bytes_per_vertex += 3 * sizeof(float);
+            break;
+        }
+        case NormalFormat::kSnorm10_10_10_2: {
+            layout.Add(kNormalAttrib, 4, GL_INT_2_10_10_10_REV, true);
+            report.float_bytes_per_vertex += 3 * sizeof(float);
+            report.normal_error_bound = 0.5f / 511.f;
+            break;
+        }
+    }
+    report.encoded_bytes_per_vertex = layout.GetStride();
+
+    // Pack every vertex and measure the round trip error
+    encoded.vertex_data.assign(mesh.vertices.size() * layout.GetStride(), 0);
+    for (size_t i{}; i < mesh.vertices.size(); ++i) {
+        const MeshVertex& v{ mesh.vertices[i] };
+        unsigned char* dst{ encoded.vertex_data.data() + i * layout.GetStride() };
+        glm::vec3 normalized_pos{ (v.position - encoded.position_bias) / encoded.position_scale };
+
+        glm::vec3 decoded_pos{};
+        switch (format.position) {
+            case PositionFormat::kFloat: {
+                memcpy(dst, &v.position, sizeof(glm::vec3));
+                decoded_pos = v.position;
+                break;
+            }
+            case PositionFormat::kHalf: {
+                uint16_t halves[3];
+                for (int c{}; c < 3; ++c) {
+                    halves[c] = FloatToHalf(normalized_pos[c]);
+                    decoded_pos[c] = HalfToFloat(halves[c]);
+                }
+                memcpy(dst, halves, sizeof(halves));
+                decoded_pos = decoded_pos * encoded.position_scale + encoded.position_bias;
+                break;
+            }
+            case PositionFormat::kSnorm16: {
+                int16_t shorts[3];
+                for (int c{}; c < 3; ++c) {
+                    shorts[c] = EncodeSnorm16(normalized_pos[c]);
+                    decoded_pos[c] = DecodeSnorm16(shorts[c]);
+                }
+                memcpy(dst, shorts, sizeof(shorts));
+                decoded_pos = decoded_pos * encoded.position_scale + encoded.position_bias;
+                break;
+            }
+        }
+        glm::vec3 pos_error{ glm::abs(decoded_pos - v.position) };
+        report.max_position_error = std::max({ report.max_position_error, pos_error.x, pos_error.y, pos_error.z });
+
+        unsigned char* tex_dst{ dst + tex_coord_offset };
+        if (format.tex_coord == TexCoordFormat::kFloat) {
+            memcpy(tex_dst, &v.tex_coord, sizeof(glm::vec2));
+        }
+        else {
+            uint16_t shorts[2];
+            for (int c{}; c < 2; ++c) {
+                shorts[c] = EncodeUnorm16(v.tex_coord[c]);
+                report.max_tex_coord_error = std::max(report.max_tex_coord_error, std::fabs(DecodeUnorm16(shorts[c]) - v.tex_coord[c]));
+            }
+            memcpy(tex_dst, shorts, sizeof(shorts));
+        }
+
+        unsigned char* normal_dst{ dst + normal_offset };
+        if (format.normal == NormalFormat::kFloat) {
+            memcpy(normal_dst, &v.normal, sizeof(glm::vec3));
+        }
+        else if (format.normal == NormalFormat::kSnorm10_10_10_2) {
+            uint32_t packed{ EncodeSnorm10_10_10_2(v.normal) };
+            memcpy(normal_dst, &packed, sizeof(packed));
+            glm::vec3 normal_error{ glm::abs(DecodeSnorm10_10_10_2(packed) - v.normal) };
+            report.max_normal_error = std::max({ report.max_normal_error, normal_error.x, normal_error.y, normal_error.z });
+        }
+    }
+
+    return encoded;
+}
+
+// IEEE 754 binary16 conversion, round to nearest even
+unsigned short FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign{ (bits >> 16) & 0x8000u };
+    uint32_t abs_bits{ bits & 0x7fffffffu };
+
+    // NaN stays NaN, overflow and infinity become infinity
+    if (abs_bits > 0x7f800000u) { return static_cast<unsigned short>(sign | 0x7e00u); }
+    if (abs_bits >= 0x477ff000u) { return static_cast<unsigned short>(sign | 0x7c00u); }
+
+    // Too small for a normal half: shift the mantissa into a denormal, rounding to nearest even
+    if (abs_bits < 0x38800000u) {
+        if (abs_bits < 0x33000000u) { return static_cast<unsigned short>(sign); }
+        uint32_t exponent{ abs_bits >> 23 };
+        uint32_t mantissa{ (abs_bits & 0x7fffffu) | 0x800000u };
+        uint32_t shift{ 126u - exponent };
+        uint32_t half_mantissa{ mantissa >> shift };
+        uint32_t remainder{ mantissa & ((1u << shift) - 1u) };
+        uint32_t halfway{ 1u << (shift - 1u) };
+        if (remainder > halfway || (remainder == halfway && (half_mantissa & 1u))) { ++half_mantissa; }
+        return static_cast<unsigned short>(sign | half_mantissa);
+    }
+
+    // Normal: rebias exponent and round the dropped 13 mantissa bits
+    uint32_t rounded{ abs_bits + 0xfffu + ((abs_bits >> 13) & 1u) };
+    return static_cast<unsigned short>(sign | ((rounded - 0x38000000u) >> 13));
+}
+
+float HalfToFloat(unsigned short half) {
+    uint32_t sign{ (half & 0x8000u) << 16 };
+    uint32_t exponent{ (half >> 10) & 0x1fu };
+    uint32_t mantissa{ half & 0x3ffu };
+    uint32_t bits;
+    if (exponent == 0) {
+        // Zero or denormal: value is mantissa * 2^-24
+        float value{ std::ldexp(static_cast<float>(mantissa), -24) };
+        return sign ? -value : value;
+    }
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    }
+    else {
+        bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/* Non-member helper implementation */
+
+int16_t EncodeSnorm16(float value) {
+    return static_cast<int16_t>(std::lround(glm::clamp(value, -1.f, 1.f) * 32767.f));
+}
+float DecodeSnorm16(int16_t value) {
+    // GL 4.2+ snorm rule: -32768 and -32767 both map to -1
+    return std::max(value / 32767.f, -1.f);
+}
+uint16_t EncodeUnorm16(float value) {
+    return static_cast<uint16_t>(std::lround(glm::clamp(value, 0.f, 1.f) * 65535.f));
+}
+float DecodeUnorm16(uint16_t value) {
+    return value / 65535.f;
+}
+
+// x in bits 0-9, y in 10-19, z in 20-29; w (bits 30-31) is left at 0
+uint32_t EncodeSnorm10_10_10_2(const glm::vec3& value) {
+    uint32_t packed{};
+    for (int c{}; c < 3; ++c) {
+        int component{ static_cast<int>(std::lround(glm::clamp(value[c], -1.f, 1.f) * 511.f)) };
+        packed |= (static_cast<uint32_t>(component) & 0x3ffu) << (10 * c);
+    }
+    return packed;
+}
+glm::vec3 DecodeSnorm10_10_10_2(uint32_t packed) {
+    glm::vec3 value;
+    for (int c{}; c < 3; ++c) {
+        // sign extend the 10 bit field
+        int component{ static_cast<int>((packed >> (10 * c)) & 0x3ffu) };
+        if (component & 0x200) { component -= 0x400; }
+        value[c] = std::max(component / 511.f, -1.f);
+    }
+    return value;
+}
+
+// @return: size in bytes of one component of a GL type
+unsigned int ComponentSize(unsigned int type) {
+    switch (type) {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT: return 2;
+        case GL_DOUBLE: return 8;
+        default: return 4;
+    }
+}
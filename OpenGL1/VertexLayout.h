@@ -0,0 +1,115 @@
+/*
+Data-driven vertex attribute setup plus an encoder that packs float meshes
+into compact GPU vertex formats
+*/
+
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include "Mesh.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Attribute slots shared by the vertex shaders
+const unsigned int kPositionAttrib{ 0 };
+const unsigned int kTexCoordAttrib{ 1 };
+// The per-instance model matrix takes up 4 consecutive slots
+const unsigned int kInstanceModelAttrib{ 2 };
+const unsigned int kNormalAttrib{ 6 };
+// Index of the draw's record in the DrawData block (see DrawData.h); an unsigned int
+const unsigned int kDrawIdAttrib{ 7 };
+
+// Describes one attribute inside an interleaved vertex
+struct VertexAttribute {
+    unsigned int location;
+    // 1-4
+    int components;
+    // GL component type, e.g. GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, GL_INT_2_10_10_10_REV
+    unsigned int type;
+    // Integer types are mapped to [0, 1] or [-1, 1] when true
+    bool normalized;
+    // Byte offset from the start of the vertex
+    unsigned int offset;
+    // 0 advances per vertex, N advances once every N instances
+    unsigned int divisor;
+};
+
+class VertexLayout {
+    std::vector<VertexAttribute> attributes_;
+    // Size of one vertex in bytes
+    unsigned int stride_;
+public:
+    VertexLayout() : stride_{} {}
+
+    // Append an attribute right after the previous one; offsets are rounded up to 4 bytes
+    // as GL requires for attribute alignment
+    VertexLayout& Add(unsigned int location, int components, unsigned int type, bool normalized = false, unsigned int divisor = 0);
+
+    // Point the attributes at the buffer bound to GL_ARRAY_BUFFER, starting base_offset bytes in
+    // Must be called with the target VAO bound
+    void Apply(size_t base_offset = 0) const;
+
+    unsigned int GetStride() const { return stride_; }
+    const std::vector<VertexAttribute>& GetAttributes() const { return attributes_; }
+};
+
+/* Vertex encoding */
+
+enum class PositionFormat {
+    kFloat,   // 3 x float, 12 bytes
+    kHalf,    // 3 x half + pad, 8 bytes; stored normalized to [-1, 1] for even precision
+    kSnorm16  // 3 x snorm16 + pad, 8 bytes
+};
+enum class TexCoordFormat {
+    kFloat,   // 2 x float, 8 bytes
+    kUnorm16  // 2 x unorm16, 4 bytes; coordinates are clamped to [0, 1]
+};
+enum class NormalFormat {
+    kNone,             // normals are not stored
+    kFloat,            // 3 x float, 12 bytes
+    kSnorm10_10_10_2   // GL_INT_2_10_10_10_REV, 4 bytes
+};
+
+struct VertexFormat {
+    PositionFormat position;
+    TexCoordFormat tex_coord;
+    NormalFormat normal;
+};
+
+// Size and precision of an encoded mesh
+struct VertexEncodeReport {
+    // Bytes per vertex for the all-float version of the same attributes, and for the encoded one
+    size_t float_bytes_per_vertex;
+    size_t encoded_bytes_per_vertex;
+    // Theoretical worst case error of the format, in mesh units / uv units / normal components
+    float position_error_bound;
+    float tex_coord_error_bound;
+    float normal_error_bound;
+    // Largest error actually measured after decoding every vertex
+    float max_position_error;
+    float max_tex_coord_error;
+    float max_normal_error;
+};
+
+// Mesh packed into a GPU-ready interleaved buffer
+struct EncodedMesh {
+    std::vector<unsigned char> vertex_data;
+    std::vector<unsigned int> indices;
+    VertexLayout layout;
+    // Decode in the vertex shader with position = a_pos * position_scale + position_bias
+    glm::vec3 position_scale;
+    glm::vec3 position_bias;
+    VertexEncodeReport report;
+};
+
+// @return: mesh packed in the requested formats, along with its layout and error report
+EncodedMesh EncodeMesh(const Mesh& mesh, const VertexFormat& format);
+
+// IEEE 754 binary16 conversion, round to nearest even
+unsigned short FloatToHalf(float value);
+float HalfToFloat(unsigned short half);
+
+#endif // !VERTEX_LAYOUT_H
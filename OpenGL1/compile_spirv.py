@@ -0,0 +1,65 @@
+"""
+Compile the stage sources a SpirvLibrary exported (run the app with --export-spirv or
+--bench spirv first) into the SPIR-V modules it loads, using glslangValidator from the Vulkan SDK
+or the glslang package. Sources are already preprocessed, so every stage is compiled as is. The
+stages of a program share a file stem (<key>.vert + <key>.frag) and are linked together, so their
+uniforms get one set of locations; programs whose modules are newer than their sources are skipped.
+
+usage: python compile_spirv.py [directory]    (default: spirv)
+"""
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+STAGE_EXTENSIONS = (".vert", ".frag", ".comp")
+
+
+def main():
+    directory = sys.argv[1] if len(sys.argv) > 1 else "spirv"
+    compiler = shutil.which("glslangValidator")
+    if not compiler:
+        sys.exit("compile_spirv.py: glslangValidator not found on PATH")
+    if not os.path.isdir(directory):
+        sys.exit("compile_spirv.py: %s does not exist; export the sources first" % directory)
+
+    # Program key -> its stage sources
+    programs = {}
+    for name in sorted(os.listdir(directory)):
+        stem, extension = os.path.splitext(name)
+        if extension in STAGE_EXTENSIONS:
+            programs.setdefault(stem, []).append(name)
+
+    compiled = failed = 0
+    for stem, names in sorted(programs.items()):
+        sources = [os.path.abspath(os.path.join(directory, name)) for name in names]
+        modules = [os.path.join(directory, name + ".spv") for name in names]
+        newest_source = max(os.path.getmtime(source) for source in sources)
+        if all(os.path.exists(module) and os.path.getmtime(module) >= newest_source for module in modules):
+            continue
+        for module in modules:
+            if os.path.exists(module):
+                os.remove(module)
+        # -G: SPIR-V for OpenGL. GLSL 330 has no layout(location) on uniforms or varyings, which
+        # SPIR-V requires, so they are assigned here; -l links the stages first so both agree on them.
+        # Linked output goes to <stage>.spv in the working directory, one per stage
+        with tempfile.TemporaryDirectory() as work:
+            result = subprocess.run([compiler, "-G", "-l", "--auto-map-locations", "--auto-map-bindings"] + sources,
+                                    cwd=work, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                    universal_newlines=True)
+            outputs = [os.path.join(work, os.path.splitext(name)[1][1:] + ".spv") for name in names]
+            if result.returncode != 0 or not all(os.path.exists(output) for output in outputs):
+                print("compile_spirv.py: %s failed\n%s" % (" + ".join(names), result.stdout))
+                failed += 1
+                continue
+            for output, module in zip(outputs, modules):
+                shutil.move(output, module)
+        compiled += 1
+    print("compile_spirv.py: %d programs compiled, %d failed" % (compiled, failed))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,24 @@
+#pragma once
+// Per-draw records, same layout as DrawData.h; include before any declaration, as it may enable an extension
+// DrawDataBlock::GetDefines supplies DRAW_RECORD_COUNT, and DRAW_ID_BUILTIN if the driver has gl_DrawIDARB
+#ifndef DRAW_RECORD_COUNT
+#define DRAW_RECORD_COUNT 204 // 16 KB, the smallest GL_MAX_UNIFORM_BLOCK_SIZE
+#endif
+
+// DRAW_ID: index of this draw's record
+#ifdef DRAW_ID_BUILTIN
+#extension GL_ARB_shader_draw_parameters : require
+#define DRAW_ID gl_DrawIDARB
+#else
+layout (location = 7) in uint a_draw_id; // kDrawIdAttrib
+#define DRAW_ID int(a_draw_id)
+#endif
+
+struct DrawRecord {
+    mat4 model;
+    vec4 material; // rgb: tint, a: how much texture2 shows through
+};
+
+layout (std140) uniform DrawData {
+    DrawRecord draw_records[DRAW_RECORD_COUNT];
+};
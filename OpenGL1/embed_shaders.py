@@ -0,0 +1,73 @@
+"""
+Embed every shader source next to this script into EmbeddedShaders.inl, a table compiled into the
+executable so it runs without the shader files. Run by the pre-build event; the output is only
+rewritten when it changes, so unchanged shaders do not trigger a rebuild.
+
+usage: python embed_shaders.py [output]
+"""
+
+import os
+import sys
+
+SHADER_EXTENSIONS = (".vert", ".frag", ".comp", ".geom", ".glsl")
+# MSVC limits a string literal, after concatenation, to 65535 bytes
+MAX_LITERAL_BYTES = 65535
+
+
+def escape_line(line):
+    out = []
+    for ch in line:
+        if ch == "\\":
+            out.append("\\\\")
+        elif ch == "\"":
+            out.append("\\\"")
+        elif ch == "\t":
+            out.append("\\t")
+        elif ch == "\r":
+            out.append("\\r")
+        elif ch == "\n":
+            out.append("\\n")
+        elif ord(ch) < 32 or ord(ch) > 126:
+            # Octal keeps the next character from being read as part of the escape
+            for byte in ch.encode("utf-8"):
+                out.append("\\%03o" % byte)
+        else:
+            out.append(ch)
+    return "".join(out)
+
+
+def main():
+    directory = os.path.dirname(os.path.abspath(__file__))
+    output = sys.argv[1] if len(sys.argv) > 1 else os.path.join(directory, "EmbeddedShaders.inl")
+
+    names = sorted(name for name in os.listdir(directory) if name.endswith(SHADER_EXTENSIONS))
+    lines = [
+        "// Generated by embed_shaders.py from the shader sources next to it; do not edit",
+        "// Sorted by path, so ShaderSources can binary search it",
+        "static const EmbeddedShader kEmbeddedShaders[]{",
+    ]
+    for name in names:
+        with open(os.path.join(directory, name), "rb") as f:
+            data = f.read()
+        if len(data) > MAX_LITERAL_BYTES:
+            sys.exit("embed_shaders.py: %s is larger than a string literal may be" % name)
+        text = data.decode("utf-8")
+        lines.append("    { \"%s\", %d," % (name, len(data)))
+        for line in text.splitlines(True) or [""]:
+            lines.append("        \"%s\"" % escape_line(line))
+        lines[-1] += " },"
+    lines.append("};")
+    lines.append("")
+    generated = "\n".join(lines)
+
+    if os.path.exists(output):
+        with open(output, "r", newline="") as f:
+            if f.read() == generated:
+                return
+    with open(output, "w", newline="") as f:
+        f.write(generated)
+    print("embed_shaders.py: embedded %d shader files into %s" % (len(names), output))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,7 @@
+#version 330 core
+out vec4 frag_color;
+
+// Drawn with shader0.vert while the real fragment shader is still compiling; flat grey, no textures
+void main() {
+    frag_color = vec4(0.6, 0.6, 0.6, 1.0);
+}
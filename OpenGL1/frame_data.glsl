@@ -0,0 +1,10 @@
+#pragma once
+// Filled once per frame and shared by every program; same layout as FrameData.h
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 proj;
+    mat4 view_proj;
+    vec4 camera_pos;
+    vec4 frustum_planes[6];
+    float time;
+};
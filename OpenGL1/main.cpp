@@ -2,6 +2,29 @@
 
 #include "Shader.h" // Custom shader class to quickly compile and link vertex + fragment shader
 #include "Camera.h"
+#include "Mesh.h" // Vertex welding and cache optimization for indexed meshes
+#include "VertexLayout.h" // Packed vertex formats and generic attribute setup
+#include "StreamBuffer.h" // Ring buffer for per-frame dynamic data
+#include "FrameData.h" // Uniform block shared by all programs
+#include "DrawData.h" // Per-draw records in a uniform block, indexed by draw ID
+#include "RenderQueue.h" // Sorted, batched draw submission
+#include "GLState.h" // Filters redundant binds
+#include "Frustum.h" // Frustum planes for culling
+#include "GpuCuller.h" // Compute shader culling + multi-draw indirect
+#include "Culling.h" // SIMD frustum culling on the CPU
+#include "Benchmark.h" // --bench mode
+#include "JobSystem.h" // Spreads per-cube work over all cores
+#include "ProgramCache.h" // Program binaries on disk, skips compiling at startup
+#include "ShaderCompiler.h" // Compiles programs in the background of startup and the first frames
+#include "ShaderWatcher.h" // Rebuilds programs when their sources change on disk
+#include "ShaderSources.h" // Embedded shader sources and on-disk overrides
+#include "SpirvLibrary.h" // Precompiled SPIR-V modules
+#include "ShaderVariantCache.h" // Specialized shader variants selected by feature bits
+#include "TextureManager.h" // Shared, reference counted textures under a VRAM budget
+#include "TextureStreamer.h" // Decodes images on worker threads, uploads them through a PBO ring
+#include "MipGenerator.h" // Gamma correct mip chains built on the CPU
+// The one translation unit that holds the stb_image implementation
+#define STB_IMAGE_IMPLEMENTATION
 #include "stb_image_.h" // Sean Barret's image loader lib
 
 #include <glad/glad.h>
@@ -13,11 +36,76 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
 
 // Viewport dimensions
 const int kWidth{ 800 };
 const int kHeight{ 600 };
 
+// Number of cubes drawn when no count is given on the command line
+const int kDefaultCubeCount{ 10 };
+// Frames the CPU may run ahead of the GPU; one stream buffer region each
+const int kFramesInFlight{ 3 };
+
+// Per-draw uniform of shader0, hashed at compile time
+constexpr UniformName kModelUniform{ "model" };
+// Block the draw-data variant of shader0 reads its per-draw records from
+constexpr UniformName kDrawDataBlock{ kDrawDataBlockName };
+// Feature bits of the shader0 variants; each selects the define at the same index in kSceneFeatureDefines
+const uint32_t kSceneInstanced{ 1u << 0 };
+const uint32_t kSceneQuantizedPositions{ 1u << 1 };
+const uint32_t kSceneDrawData{ 1u << 2 };
+const char* const kSceneFeatureDefines[]{ "INSTANCED", "QUANTIZED_POSITIONS", "DRAW_DATA" };
+
+// How the cube field is submitted to the GPU
+enum class RenderMode {
+    kPerObject, // one model uniform upload + one draw call per cube
+    kDrawData,  // every cube's model matrix and material in one uniform buffer upload; draws index them by draw ID
+    kInstanced, // per-instance transforms in a VBO, one instanced draw call for all cubes
+    kQueue,     // draw packets per cube, sorted by state and merged into instanced draws by RenderQueue
+    kGpuCull    // cubes live in GPU buffers; a compute shader culls them and fills indirect draw commands
+};
+
+// Settings parsed from the command line
+struct Options {
+    RenderMode mode{ RenderMode::kPerObject };
+    int cube_count{ kDefaultCubeCount };
+    // Smallest formats by default; --float-vertices switches back to 32 bit floats for comparison
+    VertexFormat vertex_format{ PositionFormat::kSnorm16, TexCoordFormat::kUnorm16, NormalFormat::kNone };
+    // Exit after this many frames; 0 runs until the window is closed
+    long long max_frames{};
+    // No visible window, e.g. for headless runs under Xvfb with Mesa llvmpipe
+    bool hidden{};
+    // Skip cubes outside the view in the CPU driven modes; --no-cull draws everything for comparison
+    bool frustum_culling{ true };
+    // Ignore cached program binaries and compile everything (the results are cached again)
+    bool cold_shaders{};
+    // Only use the shader sources compiled into the executable; no overrides from disk, no hot reload
+    bool embedded_shaders{};
+    // Write the GLSL of stages without a SPIR-V module to spirv/ for compile_spirv.py
+    bool export_spirv{};
+    // Load textures on the GL thread before the first frame instead of streaming them in
+    bool sync_textures{};
+    // Streamed textures get their mips from the decode threads (gamma correct box filter) instead of glGenerateMipmap
+    bool cpu_mips{};
+    // Estimated VRAM textures may hold before unreferenced ones are evicted
+    size_t texture_budget{ kDefaultTextureBudget };
+    // Threads for per-cube work, including the GL thread; 0 uses every hardware thread
+    size_t thread_count{};
+    // Run this benchmark from Benchmark.h instead of rendering
+    const char* benchmark{ nullptr };
+    size_t benchmark_count{ kDefaultBenchmarkCount };
+};
+
 // Register callback on window that gets called every time window is resized
 static void FramebufferSizeCallback(GLFWwindow* window, int width, int height);
 // Register mouse position callback
@@ -28,21 +116,52 @@ static void ScrollCallback(GLFWwindow* window, double x_offset, double y_offset)
 // Process input during render loop
 static void ProcessInput(GLFWwindow* window, double delta_time);
 
-// load an image into currently bound texture
-static unsigned int CreateTexture2D(GLenum tex_unit, char* filename);
+// Parse the render mode (--instanced, --queue, --gpu-cull, --draw-data), --count N, the vertex format flags, --frames N, --hidden, --no-cull, --threads N, --cold-shaders, --embedded-shaders, --export-spirv, --sync-textures, --cpu-mips, --texture-budget MB and --bench NAME from the command line
+static Options ParseOptions(int argc, char* argv[]);
+// @return: short name of a render mode for the stats output
+static const char* GetModeName(RenderMode mode);
+// Place cube_count cubes; the first 10 use the original hand-picked locations
+static std::vector<glm::vec3> GenerateCubePositions(int cube_count);
+// @return: model transform of cube i spinning around an arbitrary axis over time
+static glm::mat4 ComputeCubeTransform(int i, const glm::vec3& position, float time);
+// @return: material of cube i in the draw-data mode; rgb: tint, a: how much of the face shows
+static glm::vec4 ComputeCubeMaterial(int i);
+
+int main(int argc, char* argv[]) {
+    Options options{ ParseOptions(argc, argv) };
+    // Shader files in the working directory win over the embedded copies, so edits show up without a rebuild
+    if (!options.embedded_shaders) {
+        ShaderSources::GetInstance().SetOverrideDirectory(".");
+    }
+    if (options.benchmark) {
+        return RunBenchmark(options.benchmark, options.benchmark_count);
+    }
 
-int main() {
     glfwInit();
 
     // Configure GLFW
-    // Use opengl 3.3
+    // Use opengl 3.3; GPU culling asks for 4.3 first for compute shaders and indirect draws
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     // use opengl core profile
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, options.hidden ? GLFW_FALSE : GLFW_TRUE);
 
     // Create window obj
-    GLFWwindow* window = glfwCreateWindow(kWidth, kHeight, "LearnOpenGL", nullptr, nullptr);
+    GLFWwindow* window{ nullptr };
+    if (options.mode == RenderMode::kGpuCull) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(kWidth, kHeight, "LearnOpenGL", nullptr, nullptr);
+        if (!window) {
+            std::cout << "No GL 4.3 context, culling on the CPU instead" << std::endl;
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        }
+    }
+    if (!window) {
+        window = glfwCreateWindow(kWidth, kHeight, "LearnOpenGL", nullptr, nullptr);
+    }
     if (!window) {
         std::cout << "Failed to create GLFW window!" << std::endl;
         glfwTerminate();
@@ -50,6 +169,10 @@ int main() {
     }
     // Tell GLFW to make the context of our window the main context on UI thread
     glfwMakeContextCurrent(window);
+    // Terminates GLFW when main returns, after every GL object declared below (Shaders included) has released its names
+    struct GlfwTerminator {
+        ~GlfwTerminator() { glfwTerminate(); }
+    } glfw_terminator;
 
     // Must initialize GLAD before calling OpenGL funcs, since GLAD manages func ptrs
     if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
@@ -64,19 +187,73 @@ int main() {
     glfwSetCursorPosCallback(window, MouseCallback);
     glfwSetScrollCallback(window, ScrollCallback);
     
-    /* Textures */
+    /* Shaders */
+
+    // Compiled and linked into shader programs unless the cache has a binary of the exact same
+    // sources for this driver. The scene program is only submitted here, so the driver compiles it
+    // while the textures load and the first frames run; the fallback draws until it is ready
+    ProgramCache program_cache{ "shader_cache", !options.cold_shaders };
+    // Stages with a precompiled module skip the GLSL front end where the driver takes SPIR-V
+    SpirvLibrary spirv_library{ "spirv", options.export_spirv };
+    ShaderCompiler shader_compiler{ &program_cache, &spirv_library };
+    // Edits to the scene shaders are rebuilt and swapped in while running
+    ShaderWatcher shader_watcher;
+    if (!options.embedded_shaders) {
+        shader_watcher.Start();
+    }
+    // Draw-data mode: the records' block size and draw ID source are compiled into the scene variant
+    std::unique_ptr<DrawDataBlock> draw_data;
+    if (options.mode == RenderMode::kDrawData) {
+        draw_data = std::make_unique<DrawDataBlock>();
+        std::cout << "Draw data: " << draw_data->GetCapacity() << " records per uniform range, draw ID from "
+            << GetDrawIdSourceName(draw_data->GetSource()) << std::endl;
+    }
+    std::cout << "Shader compiler: " << (shader_compiler.IsParallel() ? "KHR_parallel_shader_compile" : "deferred status checks")
+        << ", SPIR-V: " << (spirv_library.IsSupported() ? "yes" : "no")
+        << ", hot reload: " << (options.embedded_shaders ? "off (embedded sources)" : shader_watcher.IsNotifyBased() ? "inotify" : "polling")
+        << std::endl;
+
+    // The scene program is specialized for the render mode and vertex format instead of branching on uniforms
+    uint32_t scene_features{};
+    if (options.mode == RenderMode::kDrawData) { scene_features |= kSceneDrawData; }
+    else if (options.mode != RenderMode::kPerObject) { scene_features |= kSceneInstanced; }
+    if (options.vertex_format.position != PositionFormat::kFloat) { scene_features |= kSceneQuantizedPositions; }
+    ShaderVariantCache scene_variants{ "shader0.vert", "shader0.frag",
+        std::vector<std::string>(std::begin(kSceneFeatureDefines), std::end(kSceneFeatureDefines)), shader_compiler, &shader_watcher,
+        draw_data ? draw_data->GetDefines() : std::vector<std::string>{} };
+    Shader fallback_program{ "shader0.vert", "fallback.frag", &program_cache, scene_variants.GetDefines(scene_features) };
+    Shader& shader_program{ scene_variants.Get(scene_features) };
 
-    // Generate ogl texture object
-    unsigned int container_tex{ CreateTexture2D(GL_TEXTURE0, "container.jpg") };
+    /* Textures */
 
-    // load second image
-    unsigned int face_tex{ CreateTexture2D(GL_TEXTURE1, "awesomeface.png") };
+    // Streamed by default: the cubes show a grey placeholder for the first frames instead of startup
+    // waiting on the decodes; --sync-textures loads them here for comparison
+    std::unique_ptr<TextureStreamer> texture_streamer;
+    if (!options.sync_textures) {
+        texture_streamer = std::make_unique<TextureStreamer>();
+        if (options.cpu_mips) {
+            MipOptions mip_options;
+            // The textures are photos and drawings, stored sRGB encoded
+            mip_options.srgb = true;
+            texture_streamer->SetCpuMips(true, mip_options);
+        }
+    }
+    // Every texture goes through the manager, so files used twice are loaded once
+    std::unique_ptr<TextureManager> texture_manager{ std::make_unique<TextureManager>(options.texture_budget, texture_streamer.get()) };
+    TextureHandle container_handle{ texture_manager->Acquire("container.jpg") };
+    TextureHandle face_handle{ texture_manager->Acquire("awesomeface.png") };
+    unsigned int container_tex{ container_handle.GetTexture() };
+    unsigned int face_tex{ face_handle.GetTexture() };
+    GLState::GetInstance().BindTextureUnit(GL_TEXTURE0, GL_TEXTURE_2D, container_tex);
+    GLState::GetInstance().BindTextureUnit(GL_TEXTURE1, GL_TEXTURE_2D, face_tex);
+    const TextureManagerStats& texture_stats{ texture_manager->GetStats() };
+    std::cout << "Textures: " << texture_manager->GetTextureCount() << " resident, "
+        << texture_manager->GetResidentBytes() / (1024. * 1024.) << " of " << texture_manager->GetBudget() / (1024. * 1024.)
+        << " MB budget, " << texture_stats.hits << " hits, " << texture_stats.content_hits << " content hits, "
+        << texture_stats.misses << " misses (" << texture_stats.baked << " baked), " << texture_stats.evictions << " evictions" << std::endl;
 
     /* GPU Pipeline begins? */
 
-    // Create vertex and fragment shaders from file; compile and link into shader program
-    Shader shader_program{ "shader0.vert", "shader0.frag" };
-
     /* 1) Copy array into buffer for OpenGL */
 
     // Cube for texture tutorial. Stores local space vertices and texture coords
@@ -123,46 +300,90 @@ int main() {
         -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
         -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
     };
-    // Supply 10 locations for 10 cubes
-    glm::vec3 cubePositions[] {
-        glm::vec3(0.0f,  0.0f,  0.0f),
-        glm::vec3(2.0f,  5.0f, -15.0f),
-        glm::vec3(-1.5f, -2.2f, -2.5f),
-        glm::vec3(-3.8f, -2.0f, -12.3f),
-        glm::vec3(2.4f, -0.4f, -3.5f),
-        glm::vec3(-1.7f,  3.0f, -7.5f),
-        glm::vec3(1.3f, -2.0f, -2.5f),
-        glm::vec3(1.5f,  2.0f, -2.5f),
-        glm::vec3(1.5f,  0.2f, -1.5f),
-        glm::vec3(-1.3f,  1.0f, -1.5f)
-    };
+    // Weld the 36 expanded vertices into an indexed mesh and reorder it for the vertex cache
+    MeshBuilder cube_builder;
+    cube_builder.AddTriangles(vertices, sizeof(vertices) / (5 * sizeof(float)));
+    MeshBuildReport cube_report;
+    Mesh cube_mesh{ cube_builder.Build(true, &cube_report) };
+    std::cout << "Cube mesh: " << cube_report.input_vertices << " -> " << cube_report.unique_vertices << " vertices, "
+        << cube_report.triangles << " triangles, ACMR " << cube_report.before.acmr << " -> " << cube_report.after.acmr
+        << ", ATVR " << cube_report.before.atvr << " -> " << cube_report.after.atvr << std::endl;
+    GLsizei cube_index_count{ static_cast<GLsizei>(cube_mesh.indices.size()) };
+
+    // Pack the vertices; the shader undoes the position quantization with the scale/bias uniforms
+    EncodedMesh cube_encoded{ EncodeMesh(cube_mesh, options.vertex_format) };
+    const VertexEncodeReport& encode_report{ cube_encoded.report };
+    std::cout << "Cube vertices: " << encode_report.float_bytes_per_vertex << " -> " << encode_report.encoded_bytes_per_vertex
+        << " bytes/vertex, max position error " << encode_report.max_position_error
+        << " (bound " << encode_report.position_error_bound << "), max uv error " << encode_report.max_tex_coord_error
+        << " (bound " << encode_report.tex_coord_error_bound << ")" << std::endl;
+
+    // Supply a location for each cube
+    std::vector<glm::vec3> cube_positions{ GenerateCubePositions(options.cube_count) };
+    // Model transforms for the per-object path, which uploads them as uniforms
+    std::vector<glm::mat4> cube_transforms(cube_positions.size());
+    // Bounding spheres of the cubes for CPU culling; the cubes spin, so the sphere encloses every rotation
+    BoundingSpheres cube_bounds;
+    for (const glm::vec3& position : cube_positions) {
+        cube_bounds.Add(position, std::sqrt(3.f) * 0.5f);
+    }
+    // Indices of the cubes to draw this frame, ascending; every cube when culling is off
+    std::vector<uint32_t> visible_cubes(cube_positions.size());
+    std::iota(visible_cubes.begin(), visible_cubes.end(), 0);
+
+    // Per-frame data is written straight into this buffer's mapped memory
+    // Each region holds one frame's FrameData block and instance transforms
+    int ubo_alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ubo_alignment);
+    size_t instance_bytes{ cube_positions.size() * sizeof(glm::mat4) };
+    // The render queue aligns each merged run separately, hence the extra slack
+    size_t region_bytes{ sizeof(FrameData) + ubo_alignment + instance_bytes + 4096 };
+    if (draw_data) {
+        region_bytes += draw_data->GetStreamBytes(cube_positions.size());
+    }
+    std::unique_ptr<StreamBuffer> frame_stream{ std::make_unique<StreamBuffer>(region_bytes, kFramesInFlight) };
+    std::cout << "Stream buffer: " << kFramesInFlight << " x " << region_bytes << " bytes, "
+        << (frame_stream->IsPersistent() ? "persistent mapping" : "orphaning fallback") << std::endl;
 
     // OpenGL core requires vertex array object as well
     // VAO stores the vertex attr config and which VBO to use
-    unsigned int vx_buf_obj, vx_array_obj;
+    unsigned int vx_buf_obj, vx_array_obj, elem_buf_obj;
     glGenVertexArrays(1, &vx_array_obj);
     glGenBuffers(1, &vx_buf_obj);
+    glGenBuffers(1, &elem_buf_obj);
 
     /* 1. bind VAO; only changes if object changes */
-    glBindVertexArray(vx_array_obj);
+    GLState& gl_state{ GLState::GetInstance() };
+    gl_state.BindVertexArray(vx_array_obj);
     // Now any calls we make on GL_ARRAY_BUFFER will target vxBufObj
-    glBindBuffer(GL_ARRAY_BUFFER, vx_buf_obj);
+    gl_state.BindBuffer(GL_ARRAY_BUFFER, vx_buf_obj);
 
     // Copies vertex data for triangle 1 into the bound VBO
     // _DNYAMIC_DRAW will change a lot, _STREAM_DRAW changes every time its drawn
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW); 
+    glBufferData(GL_ARRAY_BUFFER, cube_encoded.vertex_data.size(), cube_encoded.vertex_data.data(), GL_STATIC_DRAW);
+    // Index buffer binding is recorded in the VAO, so it must stay bound while the VAO is
+    gl_state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, elem_buf_obj);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, cube_encoded.indices.size() * sizeof(unsigned int), cube_encoded.indices.data(), GL_STATIC_DRAW);
 
     /* 2) Set vertex attributes pointers */
     // tell opengl how to interpret our vertex data (how it's packed in the VBO)
-    // Note stride can be left as zero if data is tightly packed
     // Note this is called when vx_buf_obj is bound to GL_ARRAY_BUFFER
-
-    // Set position attribute from idx 0
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), reinterpret_cast<void*>(0));
-    glEnableVertexAttribArray(0);
-    // Set texture attribute from idx 1; specify the attribute offset
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), reinterpret_cast<void*>(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // The encoder picked the attribute types, offsets and stride to match the packed data
+    cube_encoded.layout.Apply();
+
+    // Per-instance model matrix, one column per attribute slot. The divisor of 1 advances it
+    // once per instance instead of once per vertex. The offset is re-pointed at the current
+    // stream region every frame
+    VertexLayout instance_layout;
+    for (unsigned int col{}; col < 4; ++col) {
+        instance_layout.Add(kInstanceModelAttrib + col, 4, GL_FLOAT, false, 1);
+    }
+    gl_state.BindBuffer(GL_ARRAY_BUFFER, frame_stream->GetId());
+    instance_layout.Apply();
+    // Draw IDs, for the draw-data mode only: the attribute's buffer is too short for instanced draws
+    if (draw_data) {
+        draw_data->SetupVertexArray();
+    }
 
     // Note at this point, array buffer can be unbound. 
     // Remember, DO NOT unbind the EBO while a VAO is active; bound EBO is stored within a VBO.
@@ -170,14 +391,48 @@ int main() {
 
     // 3) Now set to draw the object
 
-    // Set texture unit sampler uniforms
+    // Set texture unit sampler uniforms; the scene program gets the same once it is ready
     // Must activate the shader program before setting uniforms!
-    shader_program.Use();
-    shader_program.SetInt("texture1", 0); // Active texture 0
-    shader_program.SetInt("texture2", 1);
+    auto configure_program = [&](const Shader& program) {
+        program.Use();
+        program.SetInt("texture1", 0); // Active texture 0
+        program.SetInt("texture2", 1);
+        program.SetVec3("position_scale", cube_encoded.position_scale);
+        program.SetVec3("position_bias", cube_encoded.position_bias);
+        program.BindUniformBlock("FrameData", kFrameDataBinding);
+        program.BindUniformBlock(kDrawDataBlockName, kDrawDataBinding);
+    };
+    configure_program(fallback_program);
+    // Generation of the scene program that configure_program last ran on; 0 until it is ready
+    unsigned int scene_program_generation{};
 
     // Tell opengl not to draw obscured vertices
-    glEnable(GL_DEPTH_TEST);
+    gl_state.Enable(GL_DEPTH_TEST);
+
+    // Culling, animation and packet generation run here; the GL thread is worker 0 and
+    // only it touches GL, the workers write into buffers it maps and uploads
+    JobSystem jobs{ options.thread_count };
+    std::cout << "Job system: " << jobs.GetThreadCount() << " threads" << std::endl;
+
+    // Sorts and batches packets in queue mode; depth keys saturate at the far plane
+    RenderQueue render_queue{ 100.f, &jobs };
+    // Packets generated by the workers, submitted to render_queue on this thread
+    std::vector<DrawPacket> cube_packets;
+
+    // GPU culling mode: upload every cube once; from then on only the frame data changes
+    std::unique_ptr<GpuCuller> gpu_culler;
+    if (options.mode == RenderMode::kGpuCull) {
+        // Same spin as ComputeCubeTransform; the sphere encloses the unit cube
+        std::vector<CullObject> cull_objects(cube_positions.size());
+        for (size_t i{}; i < cube_positions.size(); ++i) {
+            cull_objects[i].position_radius = glm::vec4{ cube_positions[i], std::sqrt(3.f) * 0.5f };
+            cull_objects[i].axis_speed = glm::vec4{ glm::normalize(glm::vec3{ 1.f, 0.3f, 0.5f }), glm::radians(20.f * (i % 10 + 1)) };
+            cull_objects[i].mesh = 0;
+        }
+        IndirectMesh cube_indirect{ static_cast<unsigned int>(cube_index_count), 0, 0 };
+        gpu_culler = std::make_unique<GpuCuller>(std::move(cull_objects), std::vector<IndirectMesh>{ cube_indirect }, &program_cache);
+        std::cout << "GPU culling: " << (gpu_culler->IsGpuDriven() ? "compute shader + glMultiDrawElementsIndirect" : "CPU fallback") << std::endl;
+    }
 
     /* RENDER LOOP */
 
@@ -185,7 +440,14 @@ int main() {
     double delta_time{};
     double last_frame_time{}; 
 
-    while (!glfwWindowShouldClose(window)) { // returns true when window is closed by user
+    // draw call throughput, reported once per second
+    double last_report_time{ glfwGetTime() };
+    long long frames_since_report{};
+    long long draw_calls_since_report{};
+    long long visible_since_report{};
+    long long frame_count{};
+
+    while (!glfwWindowShouldClose(window) && (options.max_frames == 0 || frame_count < options.max_frames)) { // returns true when window is closed by user
         // update deltaTime
         double current_frame_time{ glfwGetTime() };
         delta_time = current_frame_time - last_frame_time;
@@ -194,6 +456,31 @@ int main() {
         // check for user input
         ProcessInput(window, delta_time);
 
+        // Switch to the scene program in the first frame after the driver has finished it,
+        // and again after every hot reload; a failed reload keeps the previous program
+        shader_watcher.SubmitReloads(shader_compiler);
+        shader_compiler.Poll();
+        if (shader_program.GetGeneration() != scene_program_generation) {
+            configure_program(shader_program);
+            scene_program_generation = shader_program.GetGeneration();
+            std::cout << "Program shader0: " << shader_program.GetBuildMs() << " ms, "
+                << (shader_program.IsFromCache() ? "binary cache" : "compiled")
+                << ", ready at frame " << frame_count << std::endl;
+        }
+        const Shader& program{ shader_program.IsReady() ? shader_program : fallback_program };
+
+        // Upload images the decode threads have finished, within the per-frame budget
+        if (texture_streamer && texture_streamer->GetPendingCount() > 0) {
+            texture_streamer->Update();
+            if (texture_streamer->GetPendingCount() == 0) {
+                std::cout << "Textures streamed in by frame " << frame_count << ", "
+                    << texture_streamer->GetStats().update_ms << " ms in Update" << std::endl;
+            }
+        }
+
+        // Claim this frame's stream region; blocks only if the GPU is kFramesInFlight frames behind
+        frame_stream->BeginFrame();
+
         /* RENDERING COMMANDS GO HERE */
 
         // Let's clear the screen with a greenish-blue; set clear color
@@ -203,28 +490,189 @@ int main() {
 
         // Set up transformation matrix 
         // remember that transformations are applied in reverse order from code
+        // Written once per frame into the FrameData block, which every program reads
+        const Camera& camera{ Camera::GetInstance() };
+        float time{ static_cast<float>(glfwGetTime()) };
+        size_t frame_data_offset;
+        FrameData* frame_data{ static_cast<FrameData*>(frame_stream->Allocate(sizeof(FrameData), ubo_alignment, &frame_data_offset)) };
+        if (!frame_data) {
+            // Only a failed map leaves a fresh region without room for this block; no program can draw without it
+            std::cout << "ERROR [STREAM BUFFER ALLOCATION FAILED, FRAME SKIPPED]" << std::endl;
+            frame_stream->EndFrame();
+            ++frame_count;
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            continue;
+        }
         // b) View Transform
-        auto view = Camera::GetInstance().GetViewTransform();
+        glm::mat4 view{ camera.GetViewTransform() };
         // c) Projection Transform: FOV, aspect ratio, near clipping plane, far clipping plane
-        auto proj = glm::perspective(glm::radians(Camera::GetInstance().GetZoom()), double{ kWidth } / kHeight, 0.1, 100.);
-
-        glBindVertexArray(vx_array_obj);
+        glm::mat4 proj{ glm::perspective(glm::radians(static_cast<float>(camera.GetZoom())), static_cast<float>(kWidth) / kHeight, 0.1f, 100.f) };
+        glm::mat4 view_proj{ proj * view };
+        // frame_data is write-only mapped memory: every field is stored once and never read back
+        frame_data->view = view;
+        frame_data->proj = proj;
+        frame_data->view_proj = view_proj;
+        frame_data->camera_pos = glm::vec4{ camera.GetPosition(), 1.f };
+        frame_data->time = time;
+        Frustum frustum{ ExtractFrustum(view_proj) };
+        std::copy(std::begin(frustum.planes), std::end(frustum.planes), frame_data->frustum_planes);
+        frame_stream->Flush();
+        gl_state.BindBufferRange(GL_UNIFORM_BUFFER, kFrameDataBinding, frame_stream->GetId(), frame_data_offset, sizeof(FrameData));
+
+        gl_state.BindVertexArray(vx_array_obj);
+
+        // Cull before any per-cube work. The compute pass reads the FrameData range bound above
+        // and must run before the draw; the CPU modes only animate and draw visible_cubes
+        if (gpu_culler) {
+            gpu_culler->Cull(frustum, time);
+        }
+        else if (options.frustum_culling) {
+            CullSpheres(frustum, cube_bounds, visible_cubes, jobs);
+        }
+        visible_since_report += visible_cubes.size();
 
-        // 4) activate program obj; update transform matrices in vertex shader
-        shader_program.Use();
-        shader_program.SetMatrix4("view", view);
-        shader_program.SetMatrix4("proj", proj);
+        // 4) activate program obj; the transforms come from the FrameData range bound here
+        program.Use();
         
         // 5) Draw each cube each with a different rotation
-        for (int i{}; i < 10; ++i) {
-            // a) Model Transform
-            auto model = glm::translate(glm::mat4{ 1.f }, cubePositions[i]);
-            // angle of rotation, and arbitrary axis. Rotate over time
-            float angle{ 20.f * (i + 1) };
-            model = glm::rotate(model, (float)glfwGetTime() * glm::radians(angle), glm::vec3{ 1.f, 0.3f, 0.5f });
-            shader_program.SetMatrix4("model", model);
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        if (options.mode == RenderMode::kGpuCull) {
+            gpu_culler->Draw(*frame_stream, instance_layout);
+            draw_calls_since_report += gpu_culler->GetDrawCallCount();
+        }
+        else if (options.mode == RenderMode::kQueue) {
+            // Every cube is an independent packet; alternate two materials so the queue has state to sort by
+            // Depth from the frame's local view, not frame_data, which points into write-combined GPU memory
+            const unsigned int program_id{ program.GetId() };
+            cube_packets.resize(visible_cubes.size());
+            jobs.ParallelFor(visible_cubes.size(), [&](size_t begin, size_t end) {
+                for (size_t v{ begin }; v < end; ++v) {
+                    uint32_t i{ visible_cubes[v] };
+                    DrawPacket& packet{ cube_packets[v] };
+                    packet = DrawPacket{};
+                    packet.program = program_id;
+                    packet.vao = vx_array_obj;
+                    packet.textures[0] = (i % 2 == 0) ? container_tex : face_tex;
+                    packet.textures[1] = (i % 2 == 0) ? face_tex : container_tex;
+                    packet.index_count = cube_index_count;
+                    packet.model = ComputeCubeTransform(static_cast<int>(i), cube_positions[i], time);
+                    packet.depth = -(view * packet.model[3]).z;
+                }
+            }, 256);
+            for (const DrawPacket& packet : cube_packets) {
+                render_queue.Submit(packet);
+            }
+            render_queue.Execute(*frame_stream, instance_layout);
+            draw_calls_since_report += render_queue.GetStats().draw_calls;
+        }
+        else if (options.mode == RenderMode::kInstanced) {
+            // a) Model Transforms, written directly into mapped GPU memory
+            size_t instance_offset;
+            glm::mat4* instances{ static_cast<glm::mat4*>(frame_stream->Allocate(visible_cubes.size() * sizeof(glm::mat4), sizeof(glm::vec4), &instance_offset)) };
+            if (instances) {
+                // Workers only write the mapped memory; mapping and unmapping stay on this thread
+                jobs.ParallelFor(visible_cubes.size(), [&](size_t begin, size_t end) {
+                    for (size_t v{ begin }; v < end; ++v) {
+                        uint32_t i{ visible_cubes[v] };
+                        instances[v] = ComputeCubeTransform(static_cast<int>(i), cube_positions[i], time);
+                    }
+                }, 256);
+                frame_stream->Flush();
+
+                // Point the instance attributes at this frame's region and let the GPU replicate the cube
+                gl_state.BindBuffer(GL_ARRAY_BUFFER, frame_stream->GetId());
+                instance_layout.Apply(instance_offset);
+                glDrawElementsInstanced(GL_TRIANGLES, cube_index_count, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(visible_cubes.size()));
+                ++draw_calls_since_report;
+            }
+            else if (!visible_cubes.empty()) {
+                std::cout << "ERROR [STREAM BUFFER FULL, INSTANCES SKIPPED]" << std::endl;
+            }
+        }
+        else if (draw_data && program.HasUniformBlock(kDrawDataBlock)) {
+            // a) Model transforms and materials of every cube, written directly into mapped GPU memory
+            // and bound in as few uniform ranges as the block size allows; no uniform calls per draw
+            size_t records_offset;
+            DrawRecord* records{ draw_data->Allocate(*frame_stream, visible_cubes.size(), &records_offset) };
+            if (records) {
+                jobs.ParallelFor(visible_cubes.size(), [&](size_t begin, size_t end) {
+                    for (size_t v{ begin }; v < end; ++v) {
+                        uint32_t i{ visible_cubes[v] };
+                        records[v].model = ComputeCubeTransform(static_cast<int>(i), cube_positions[i], time);
+                        records[v].material = ComputeCubeMaterial(static_cast<int>(i));
+                    }
+                }, 256);
+                frame_stream->Flush();
+                draw_calls_since_report += draw_data->Draw(*frame_stream, records_offset, visible_cubes.size(), cube_index_count);
+            }
+        }
+        else {
+            // Programs without the block, e.g. the per-object mode, take the model matrix as a uniform
+            cube_transforms.resize(visible_cubes.size());
+            jobs.ParallelFor(visible_cubes.size(), [&](size_t begin, size_t end) {
+                for (size_t v{ begin }; v < end; ++v) {
+                    // a) Model Transform
+                    uint32_t i{ visible_cubes[v] };
+                    cube_transforms[v] = ComputeCubeTransform(static_cast<int>(i), cube_positions[i], time);
+                }
+            }, 256);
+            // Resolved once per frame so the per-object loop never looks the name up
+            UniformHandle model_uniform{ program.GetUniform(kModelUniform) };
+            for (const glm::mat4& model : cube_transforms) {
+                program.SetMatrix4(model_uniform, model);
+                glDrawElements(GL_TRIANGLES, cube_index_count, GL_UNSIGNED_INT, nullptr);
+            }
+            draw_calls_since_report += cube_transforms.size();
+        }
+
+        // Fence the region so it is not overwritten before these draws have consumed it
+        frame_stream->EndFrame();
+
+        // Report throughput so both modes can be compared at the same object count
+        ++frames_since_report;
+        ++frame_count;
+        if (current_frame_time - last_report_time >= 1.) {
+            double elapsed{ current_frame_time - last_report_time };
+            std::cout << "[" << GetModeName(options.mode) << "] "
+                << cube_positions.size() << " cubes, "
+                << frames_since_report / elapsed << " fps, "
+                << draw_calls_since_report / elapsed << " draw calls/s, "
+                << frames_since_report * cube_positions.size() / elapsed << " cubes/s, "
+                << frame_stream->GetBytesStreamed() / elapsed / (1024. * 1024.) << " MB/s streamed, "
+                << frame_stream->GetFenceWaitMs() << " ms fence wait" << std::endl;
+            const GLStateCounters& gl_counters{ gl_state.GetCounters() };
+            std::cout << "    GL binds per frame: " << gl_counters.issued / frames_since_report << " issued, "
+                << gl_counters.skipped / frames_since_report << " skipped" << std::endl;
+            const GLStateCounters& uniform_counters{ gl_state.GetUniformCounters() };
+            std::cout << "    uniform sets per frame: " << uniform_counters.issued / frames_since_report << " issued, "
+                << uniform_counters.skipped / frames_since_report << " skipped" << std::endl;
+            if (options.mode == RenderMode::kQueue) {
+                const RenderQueueStats& queue_stats{ render_queue.GetStats() };
+                std::cout << "    queue: " << queue_stats.packets << " packets, draw calls "
+                    << queue_stats.naive_draw_calls << " -> " << queue_stats.draw_calls << ", state changes "
+                    << queue_stats.naive_state_changes << " -> " << queue_stats.state_changes << " per frame" << std::endl;
+            }
+            if (draw_data) {
+                std::cout << "    draw data: " << draw_data->GetRangeCount() << " uniform ranges of up to "
+                    << draw_data->GetCapacity() << " records per frame" << std::endl;
+            }
+            if (gpu_culler) {
+                // Reading the counts back stalls, so only do it for the report
+                size_t visible{ gpu_culler->GetVisibleCount() };
+                std::cout << "    culling: " << visible << " drawn, " << gpu_culler->GetObjectCount() - visible << " culled" << std::endl;
+            }
+            else {
+                long long visible{ visible_since_report / frames_since_report };
+                std::cout << "    culling (" << (options.frustum_culling ? GetSimdLevelName(GetBestSimdLevel()) : "off") << "): "
+                    << visible << " drawn, " << static_cast<long long>(cube_positions.size()) - visible << " culled per frame" << std::endl;
+            }
+            last_report_time = current_frame_time;
+            frames_since_report = 0;
+            draw_calls_since_report = 0;
+            visible_since_report = 0;
+            frame_stream->ResetCounters();
+            gl_state.ResetCounters();
         }
 
         /* glfw: swap buffers and poll I/O */
@@ -234,8 +682,7 @@ int main() {
         glfwPollEvents();
     }
 
-    // cleans/deletes all allocated resources
-    glfwTerminate();
+    // GL objects are destroyed in reverse order of declaration, then glfw_terminator cleans up GLFW
     return 0;
 }
 
@@ -278,40 +725,128 @@ void ProcessInput(GLFWwindow* window, double delta_time) {
     }
 }
 
-// load an image into currently bound texture
-unsigned int CreateTexture2D(GLenum tex_unit, char* filename) {
-    unsigned int tex;
-    glGenTextures(1, &tex);
-    // Specify texture unit this image will occupy
-    glActiveTexture(tex_unit);
-    glBindTexture(GL_TEXTURE_2D, tex);
-    // Set wrap/filtering options
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // S and T are texture dimension vars
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // load image
-    int width, height, num_channels;
-    unsigned char* img_data{ stbi_load(filename, &width, &height, &num_channels, 0) };
-
-    // Check for success
-    if (img_data) {
-        // If png, specify transparency format
-        size_t len{ strlen(filename) };
-        filename += (len - 3); // For file extensions differen in last 3 chars
-        int format{ (strcmp("jpg", filename) == 0) ? GL_RGB : GL_RGBA };
-        // apply image to 2D texture
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format, GL_UNSIGNED_BYTE, img_data);
-        // Mipmap for bound texture
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Good idea to free the image memory after generating mipmaps
-        stbi_image_free(img_data);
+// Parse the render mode (--instanced, --queue, --gpu-cull, --draw-data), --count N, the vertex format flags, --frames N, --hidden, --no-cull, --threads N, --cold-shaders, --embedded-shaders, --export-spirv, --sync-textures, --cpu-mips, --texture-budget MB and --bench NAME from the command line
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i{ 1 }; i < argc; ++i) {
+        if (strcmp(argv[i], "--instanced") == 0) {
+            options.mode = RenderMode::kInstanced;
+        }
+        else if (strcmp(argv[i], "--queue") == 0) {
+            options.mode = RenderMode::kQueue;
+        }
+        else if (strcmp(argv[i], "--gpu-cull") == 0) {
+            options.mode = RenderMode::kGpuCull;
+        }
+        else if (strcmp(argv[i], "--draw-data") == 0) {
+            options.mode = RenderMode::kDrawData;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.max_frames = std::max(0LL, atoll(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--hidden") == 0) {
+            options.hidden = true;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.thread_count = static_cast<size_t>(std::max(0, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--cold-shaders") == 0) {
+            options.cold_shaders = true;
+        }
+        else if (strcmp(argv[i], "--embedded-shaders") == 0) {
+            options.embedded_shaders = true;
+        }
+        else if (strcmp(argv[i], "--export-spirv") == 0) {
+            options.export_spirv = true;
+        }
+        else if (strcmp(argv[i], "--sync-textures") == 0) {
+            options.sync_textures = true;
+        }
+        else if (strcmp(argv[i], "--cpu-mips") == 0) {
+            options.cpu_mips = true;
+        }
+        else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc) {
+            options.texture_budget = static_cast<size_t>(std::max(0, atoi(argv[++i]))) << 20;
+        }
+        else if (strcmp(argv[i], "--no-cull") == 0) {
+            options.frustum_culling = false;
+        }
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            options.benchmark = argv[++i];
+        }
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            options.cube_count = std::max(1, atoi(argv[++i]));
+            options.benchmark_count = options.cube_count;
+        }
+        else if (strcmp(argv[i], "--float-vertices") == 0) {
+            options.vertex_format = VertexFormat{ PositionFormat::kFloat, TexCoordFormat::kFloat, NormalFormat::kNone };
+        }
+        else if (strcmp(argv[i], "--half-positions") == 0) {
+            options.vertex_format.position = PositionFormat::kHalf;
+        }
+        else {
+            std::cout << "Ignoring unknown option " << argv[i] << std::endl;
+        }
     }
-    else {
-        std::cout << "Failed to load texture" << std::endl;
+    return options;
+}
+
+// @return: short name of a render mode for the stats output
+const char* GetModeName(RenderMode mode) {
+    switch (mode) {
+        case RenderMode::kPerObject: return "per-object";
+        case RenderMode::kDrawData: return "draw-data";
+        case RenderMode::kInstanced: return "instanced";
+        case RenderMode::kQueue: return "queue";
+        case RenderMode::kGpuCull: return "gpu-cull";
     }
+    return "unknown";
+}
 
-    return tex;
+// Place cube_count cubes; the first 10 use the original hand-picked locations
+std::vector<glm::vec3> GenerateCubePositions(int cube_count) {
+    std::vector<glm::vec3> positions {
+        glm::vec3(0.0f,  0.0f,  0.0f),
+        glm::vec3(2.0f,  5.0f, -15.0f),
+        glm::vec3(-1.5f, -2.2f, -2.5f),
+        glm::vec3(-3.8f, -2.0f, -12.3f),
+        glm::vec3(2.4f, -0.4f, -3.5f),
+        glm::vec3(-1.7f,  3.0f, -7.5f),
+        glm::vec3(1.3f, -2.0f, -2.5f),
+        glm::vec3(1.5f,  2.0f, -2.5f),
+        glm::vec3(1.5f,  0.2f, -1.5f),
+        glm::vec3(-1.3f,  1.0f, -1.5f)
+    };
+    positions.resize(std::min<size_t>(positions.size(), cube_count));
+
+    // Scatter the rest in front of the camera; the volume grows with the count to keep density constant
+    // Fixed seed so runs with the same count are comparable
+    std::mt19937 rng{ 1234 };
+    float extent{ std::cbrt(static_cast<float>(cube_count)) };
+    std::uniform_real_distribution<float> spread{ -extent, extent };
+    std::uniform_real_distribution<float> depth{ -2.f * extent, 0.f };
+    while (positions.size() < static_cast<size_t>(cube_count)) {
+        positions.emplace_back(spread(rng), spread(rng), depth(rng));
+    }
+    return positions;
+}
+
+// @return: model transform of cube i spinning around an arbitrary axis over time
+glm::mat4 ComputeCubeTransform(int i, const glm::vec3& position, float time) {
+    auto model = glm::translate(glm::mat4{ 1.f }, position);
+    // angle of rotation, and arbitrary axis. Rotate over time
+    float angle{ 20.f * (i % 10 + 1) };
+    return glm::rotate(model, time * glm::radians(angle), glm::vec3{ 1.f, 0.3f, 0.5f });
+}
+
+// @return: material of cube i in the draw-data mode; rgb: tint, a: how much of the face shows
+glm::vec4 ComputeCubeMaterial(int i) {
+    static const glm::vec3 kTints[]{
+        glm::vec3{ 1.f, 1.f, 1.f },
+        glm::vec3{ 1.f, 0.6f, 0.6f },
+        glm::vec3{ 0.6f, 1.f, 0.6f },
+        glm::vec3{ 0.6f, 0.6f, 1.f },
+        glm::vec3{ 1.f, 1.f, 0.6f }
+    };
+    return glm::vec4{ kTints[i % 5], 0.2f + 0.2f * (i % 4) };
 }
@@ -2,11 +2,24 @@
 out vec4 frag_color;
 
 in vec2 tex_coord; // texture coordinates
+#ifdef DRAW_DATA
+flat in vec4 material; // This draw's record from the DrawData block; rgb: tint, a: texture2 mix
+#endif
 
 //fragment shader is the one that actually sets pixels to corresponding color from texture
 uniform sampler2D texture1;
 uniform sampler2D texture2;
 
+// How much of texture2 shows through; a compile-time constant, override with a define
+#ifndef FACE_MIX
+#define FACE_MIX 0.2
+#endif
+
 void main() {
-    frag_color = mix(texture(texture1, tex_coord), texture(texture2, tex_coord), 0.2);
+#ifdef DRAW_DATA
+    vec4 color = mix(texture(texture1, tex_coord), texture(texture2, tex_coord), material.a);
+    frag_color = vec4(color.rgb * material.rgb, color.a);
+#else
+    frag_color = mix(texture(texture1, tex_coord), texture(texture2, tex_coord), FACE_MIX);
+#endif
 }
\ No newline at end of file
@@ -1,14 +1,45 @@
 #version 330 core
-layout (location = 0) in vec3 a_pos; // position var has attr position 0
+#ifdef DRAW_DATA
+#include "draw_data.glsl"
+#endif
+layout (location = 0) in vec3 a_pos; // position var has attr position 0; may be quantized to [-1, 1]
 layout (location = 1) in vec2 a_tex_coord; // texture coordinates in pos 1
+layout (location = 2) in mat4 a_model; // per-instance model matrix; takes up locations 2-5
 
 out vec2 tex_coord; // Pipe texture coordinates to fragment shader
+#ifdef DRAW_DATA
+flat out vec4 material; // Per-draw material for the fragment shader
+#endif
 
+#include "frame_data.glsl"
+
+// Variant defines (see ShaderVariantCache):
+// INSTANCED: take the model matrix from a_model instead of the uniform
+// QUANTIZED_POSITIONS: a_pos is normalized and needs position_scale/position_bias
+// DRAW_DATA: take the model matrix and material from this draw's record in the DrawData block
+#if !defined(INSTANCED) && !defined(DRAW_DATA)
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
+#endif
+#ifdef QUANTIZED_POSITIONS
+// Undo position quantization: local position = a_pos * position_scale + position_bias
+uniform vec3 position_scale;
+uniform vec3 position_bias;
+#endif
 
 void main() {
-    gl_Position = proj * view * model * vec4(a_pos, 1.0); // transform closest to vector is applied first
+#if defined(INSTANCED)
+    mat4 model_transform = a_model;
+#elif defined(DRAW_DATA)
+    mat4 model_transform = draw_records[DRAW_ID].model;
+    material = draw_records[DRAW_ID].material;
+#else
+    mat4 model_transform = model;
+#endif
+#ifdef QUANTIZED_POSITIONS
+    vec3 local_pos = a_pos * position_scale + position_bias;
+#else
+    vec3 local_pos = a_pos;
+#endif
+    gl_Position = view_proj * model_transform * vec4(local_pos, 1.0); // transform closest to vector is applied first
 	tex_coord = a_tex_coord;
-}
\ No newline at end of file
+}
@@ -1,5 +1,3 @@
-#define STB_IMAGE_IMPLEMENTATION
-
 /* stb_image - v2.18 - public domain image loader - http://nothings.org/stb
 no warranty implied; use at your own risk
 
@@ -526,6 +524,26 @@ extern "C" {
 #define STBI_ASSERT(x) assert(x)
 #endif
 
+// Backported from stb_image 2.26: the failure reason is per thread, so decoders may run on
+// several threads at once. #define STBI_NO_THREAD_LOCALS to get the old shared global back
+#ifndef STBI_NO_THREAD_LOCALS
+   #if defined(__cplusplus) &&  __cplusplus >= 201103L
+      #define STBI_THREAD_LOCAL       thread_local
+   #elif defined(__GNUC__) && __GNUC__ < 5
+      #define STBI_THREAD_LOCAL       __thread
+   #elif defined(_MSC_VER)
+      #define STBI_THREAD_LOCAL       __declspec(thread)
+   #elif defined (__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+      #define STBI_THREAD_LOCAL       _Thread_local
+   #endif
+
+   #ifndef STBI_THREAD_LOCAL
+      #if defined(__GNUC__)
+        #define STBI_THREAD_LOCAL       __thread
+      #endif
+   #endif
+#endif
+
 
 #ifndef _MSC_VER
 #ifdef __cplusplus
@@ -841,8 +859,11 @@ static void    *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int
 static int      stbi__pnm_info(stbi__context *s, int *x, int *y, int *comp);
 #endif
 
-// this is not threadsafe
-static const char *stbi__g_failure_reason;
+static
+#ifdef STBI_THREAD_LOCAL
+STBI_THREAD_LOCAL
+#endif
+const char *stbi__g_failure_reason;
 
 STBIDEF const char *stbi_failure_reason(void)
 {
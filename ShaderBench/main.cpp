@@ -0,0 +1,741 @@
+/*
+Shader compile-time benchmark. Builds every shader/variant pair the renderer uses on a headless
+context and prints per-program preprocess, compile, link, first draw and binary cache timings as JSON.
+
+Compile and link are timed up to their status queries, which wait for the driver. Drivers may
+still defer part of the work (e.g. state dependent variants) until a program is first used, so
+the first draw into a small framebuffer is timed separately. The binary cache times are a store
+and a load through ProgramCache.
+
+usage: ShaderBench [--threads N] [--driver-threads N] [--context egl|glfw] [--shader-dir DIR]
+                   [--driver-cache] [--source-io N] [--output FILE]
+    --threads N         compile on N threads, each with its own context sharing objects with the others
+    --driver-threads N  glMaxShaderCompilerThreadsKHR(N) where KHR_parallel_shader_compile exists
+    --context           egl: surfaceless EGL (Linux, e.g. Mesa llvmpipe); glfw: hidden GLFW windows
+    --shader-dir DIR    shader files in DIR win over the embedded copies
+    --driver-cache      keep Mesa's on-disk shader cache, which is disabled by default; Mesa only
+                        offers program binaries with it, so cache timings are null without it
+    --source-io N       instead of building, time reading and preprocessing N scene programs from
+                        disk (--shader-dir, default .) vs the embedded table, with their heap
+                        allocations; needs no GL context
+*/
+
+#include "Hash.h"
+#include "ProgramCache.h"
+#include "ShaderPreprocessor.h"
+#include "ShaderSources.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Compile threads are capped here; each one is a GL context
+static const size_t kMaxThreads{ 64 };
+// Size of the framebuffer first draws render into
+static const int kFramebufferSize{ 64 };
+// Zeroed uniform buffer bound for FrameData; larger than the block
+static const size_t kFrameDataBytes{ 1024 };
+// Binding point of FrameData, as in FrameData.h
+static const unsigned int kFrameDataBinding{ 0 };
+// Directory the binary cache timings go through, apart from the app's cache
+static const char* const kCacheDirectory{ "shader_bench_cache" };
+// Timed repetitions per --source-io measurement; the median is reported
+static const int kSourceIoRepeats{ 15 };
+
+// Heap allocations made by the whole process, counted by the operator new below. Only this
+// benchmark executable replaces the allocator; the app keeps the default one
+static std::atomic<size_t> allocation_count{};
+
+// A program of the renderer; graphics programs are built in every feature combination
+struct BenchProgram {
+    const char* name;
+    // Vertex or compute stage
+    const char* first_path;
+    // Fragment stage; nullptr for compute programs
+    const char* frag_path;
+};
+static const BenchProgram kPrograms[]{
+    { "scene", "shader0.vert", "shader0.frag" },
+    { "fallback", "shader0.vert", "fallback.frag" },
+    { "cull", "cull.comp", nullptr },
+};
+// Same feature bits as the scene's ShaderVariantCache in OpenGL1/main.cpp
+static const char* const kFeatureDefines[]{ "INSTANCED", "QUANTIZED_POSITIONS" };
+static const uint32_t kFeatureCount{ sizeof(kFeatureDefines) / sizeof(kFeatureDefines[0]) };
+
+enum class ContextKind { kEgl, kGlfw };
+
+// Settings parsed from the command line
+struct Options {
+    size_t thread_count{ 1 };
+    // Passed to glMaxShaderCompilerThreadsKHR; 0xFFFFFFFF lets the driver decide
+    unsigned int driver_threads{ 0xFFFFFFFFu };
+#ifdef __linux__
+    ContextKind context{ ContextKind::kEgl };
+#else
+    ContextKind context{ ContextKind::kGlfw };
+#endif
+    const char* shader_directory{ "" };
+    bool driver_cache{};
+    // Programs --source-io loads; 0 builds programs as usual
+    size_t source_io_programs{};
+    const char* output{ nullptr };
+};
+
+// One shader/variant pair to build
+struct BenchJob {
+    const BenchProgram* program;
+    std::vector<std::string> defines;
+};
+
+// Timings of one job; negative times were not measured
+struct BenchResult {
+    size_t thread;
+    bool ok;
+    double preprocess_ms;
+    double compile_ms;
+    double link_ms;
+    double first_draw_ms;
+    double cache_store_ms;
+    double cache_load_ms;
+};
+
+// GL contexts of every compile thread, all sharing objects with the first
+struct BenchContexts {
+    ContextKind kind;
+    int major;
+    int minor;
+    std::vector<GLFWwindow*> windows;
+#ifdef __linux__
+    EGLDisplay display;
+    std::vector<EGLContext> contexts;
+#endif
+};
+
+// Parse the command line; see the usage at the top of this file
+static bool ParseOptions(int argc, char* argv[], Options& options);
+// Create count contexts of the newest core version available (4.6, 4.3 or 3.3); the first is current afterwards
+static bool CreateContexts(ContextKind kind, size_t count, BenchContexts& contexts);
+// Make context index current on this thread; an index past the last releases the current one
+static void MakeCurrent(BenchContexts& contexts, size_t index);
+static void DestroyContexts(BenchContexts& contexts);
+// Build the jobs of thread from the shared job counter until none are left
+static void RunWorker(size_t thread, BenchContexts& contexts, const Options& options, const std::vector<BenchJob>& jobs,
+    std::atomic<size_t>& next_job, std::vector<BenchResult>& results);
+// Build job on the current context, which has a framebuffer, VAO and FrameData buffer bound
+static BenchResult BuildJob(const BenchJob& job, ProgramCache& cache);
+// Time and count the allocations of reading and preprocessing the scene program from disk vs embedded
+// Writes the results as JSON; needs no GL context
+static void RunSourceIo(std::ostream& out, const Options& options);
+// Write the results as JSON
+static void WriteJson(std::ostream& out, const BenchContexts& contexts, const Options& options, const std::vector<BenchJob>& jobs,
+    const std::vector<BenchResult>& results, double total_ms);
+// Write text as a JSON string literal
+static void WriteJsonString(std::ostream& out, const std::string& text);
+// Write ms, or null if it was not measured
+static void WriteJsonMs(std::ostream& out, double ms);
+// @return: milliseconds since start
+static double ElapsedMs(std::chrono::steady_clock::time_point start);
+// @return: median milliseconds of kSourceIoRepeats calls of body, after one warm-up call
+template <typename Body>
+static double TimeMedianMs(Body&& body);
+
+// Counting replacement of the global allocator, for --source-io
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory{ std::malloc(size ? size : 1) }) {
+        return memory;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (!options.driver_cache) {
+        // Mesa's on-disk cache would turn every run after the first into cache hits
+#ifdef _WIN32
+        _putenv("MESA_SHADER_CACHE_DISABLE=true");
+#else
+        setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+#endif
+    }
+    if (options.source_io_programs > 0) {
+        if (options.output) {
+            std::ofstream file{ options.output };
+            RunSourceIo(file, options);
+            if (!file) {
+                std::cout << "ERROR [CANNOT WRITE " << options.output << "]" << std::endl;
+                return 1;
+            }
+        }
+        else {
+            RunSourceIo(std::cout, options);
+        }
+        return 0;
+    }
+    ShaderSources::GetInstance().SetOverrideDirectory(options.shader_directory);
+
+    BenchContexts contexts{};
+    if (!CreateContexts(options.context, options.thread_count, contexts)) {
+        return 1;
+    }
+
+    // Every program in every feature combination; compute programs need 4.3
+    std::vector<BenchJob> jobs;
+    const bool has_compute{ GLAD_GL_VERSION_4_3 != 0 };
+    for (const BenchProgram& program : kPrograms) {
+        if (!program.frag_path) {
+            if (has_compute) { jobs.push_back(BenchJob{ &program, {} }); }
+            continue;
+        }
+        for (uint32_t mask{}; mask < (1u << kFeatureCount); ++mask) {
+            BenchJob job{ &program, {} };
+            for (uint32_t bit{}; bit < kFeatureCount; ++bit) {
+                if (mask & (1u << bit)) { job.defines.push_back(kFeatureDefines[bit]); }
+            }
+            jobs.push_back(job);
+        }
+    }
+
+    // Workers make their own contexts current, so the main thread lets go of the first
+    MakeCurrent(contexts, kMaxThreads);
+    std::vector<BenchResult> results(jobs.size());
+    std::atomic<size_t> next_job{};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t{}; t < options.thread_count; ++t) {
+        workers.emplace_back(RunWorker, t, std::ref(contexts), std::cref(options), std::cref(jobs), std::ref(next_job), std::ref(results));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double total_ms{ ElapsedMs(start) };
+    MakeCurrent(contexts, 0);
+
+    if (options.output) {
+        std::ofstream file{ options.output };
+        WriteJson(file, contexts, options, jobs, results, total_ms);
+        if (!file) {
+            std::cout << "ERROR [CANNOT WRITE " << options.output << "]" << std::endl;
+        }
+    }
+    else {
+        WriteJson(std::cout, contexts, options, jobs, results, total_ms);
+    }
+    DestroyContexts(contexts);
+    bool all_ok{ std::all_of(results.begin(), results.end(), [](const BenchResult& result) { return result.ok; }) };
+    return all_ok ? 0 : 1;
+}
+
+// Parse the command line; see the usage at the top of this file
+bool ParseOptions(int argc, char* argv[], Options& options) {
+    for (int i{ 1 }; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.thread_count = std::min(kMaxThreads, static_cast<size_t>(std::max(1, atoi(argv[++i]))));
+        }
+        else if (strcmp(argv[i], "--driver-threads") == 0 && i + 1 < argc) {
+            options.driver_threads = static_cast<unsigned int>(std::max(0, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--context") == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "egl") == 0) {
+                options.context = ContextKind::kEgl;
+            }
+            else if (strcmp(argv[i], "glfw") == 0) {
+                options.context = ContextKind::kGlfw;
+            }
+            else {
+                std::cout << "ERROR [UNKNOWN CONTEXT " << argv[i] << "] use egl or glfw" << std::endl;
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--shader-dir") == 0 && i + 1 < argc) {
+            options.shader_directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--driver-cache") == 0) {
+            options.driver_cache = true;
+        }
+        else if (strcmp(argv[i], "--source-io") == 0 && i + 1 < argc) {
+            options.source_io_programs = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            options.output = argv[++i];
+        }
+        else {
+            std::cout << "ERROR [UNKNOWN OPTION " << argv[i] << "]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Create count contexts of the newest core version available (4.6, 4.3 or 3.3); the first is current afterwards
+bool CreateContexts(ContextKind kind, size_t count, BenchContexts& contexts) {
+    static const int kVersions[][2]{ { 4, 6 }, { 4, 3 }, { 3, 3 } };
+    contexts.kind = kind;
+    if (kind == ContextKind::kEgl) {
+#ifdef __linux__
+        // Surfaceless: no window system at all, e.g. on a headless CI machine
+        auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        contexts.display = get_platform_display ?
+            get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) : EGL_NO_DISPLAY;
+        EGLint egl_major{}, egl_minor{};
+        if (contexts.display == EGL_NO_DISPLAY || !eglInitialize(contexts.display, &egl_major, &egl_minor) || !eglBindAPI(EGL_OPENGL_API)) {
+            std::cout << "ERROR [NO SURFACELESS EGL DISPLAY] try --context glfw" << std::endl;
+            return false;
+        }
+        // The default surface type is EGL_WINDOW_BIT, which no surfaceless config has
+        const EGLint config_attributes[]{ EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config{};
+        EGLint config_count{};
+        if (!eglChooseConfig(contexts.display, config_attributes, &config, 1, &config_count) || config_count == 0) {
+            std::cout << "ERROR [NO EGL CONFIG WITH DESKTOP GL]" << std::endl;
+            return false;
+        }
+        for (const int* version : kVersions) {
+            const EGLint context_attributes[]{
+                EGL_CONTEXT_MAJOR_VERSION, version[0],
+                EGL_CONTEXT_MINOR_VERSION, version[1],
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE,
+            };
+            for (size_t c{}; c < count; ++c) {
+                EGLContext share{ contexts.contexts.empty() ? EGL_NO_CONTEXT : contexts.contexts[0] };
+                EGLContext context{ eglCreateContext(contexts.display, config, share, context_attributes) };
+                if (context == EGL_NO_CONTEXT) {
+                    break;
+                }
+                contexts.contexts.push_back(context);
+            }
+            if (contexts.contexts.size() == count) {
+                contexts.major = version[0];
+                contexts.minor = version[1];
+                break;
+            }
+            for (EGLContext context : contexts.contexts) {
+                eglDestroyContext(contexts.display, context);
+            }
+            contexts.contexts.clear();
+        }
+        if (contexts.contexts.empty()) {
+            std::cout << "ERROR [EGL CONTEXT CREATION FAILED]" << std::endl;
+            eglTerminate(contexts.display);
+            return false;
+        }
+        MakeCurrent(contexts, 0);
+        if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+            std::cout << "ERROR [GLAD INIT FAILED]" << std::endl;
+            return false;
+        }
+        return true;
+#else
+        std::cout << "ERROR [EGL CONTEXTS ARE ONLY SUPPORTED ON LINUX] use --context glfw" << std::endl;
+        return false;
+#endif
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    for (const int* version : kVersions) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        for (size_t c{}; c < count; ++c) {
+            GLFWwindow* share{ contexts.windows.empty() ? nullptr : contexts.windows[0] };
+            GLFWwindow* window{ glfwCreateWindow(kFramebufferSize, kFramebufferSize, "ShaderBench", nullptr, share) };
+            if (!window) {
+                break;
+            }
+            contexts.windows.push_back(window);
+        }
+        if (contexts.windows.size() == count) {
+            contexts.major = version[0];
+            contexts.minor = version[1];
+            break;
+        }
+        for (GLFWwindow* window : contexts.windows) {
+            glfwDestroyWindow(window);
+        }
+        contexts.windows.clear();
+    }
+    if (contexts.windows.empty()) {
+        std::cout << "ERROR [GLFW CONTEXT CREATION FAILED]" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    MakeCurrent(contexts, 0);
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
+        std::cout << "ERROR [GLAD INIT FAILED]" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Make context index current on this thread; an index past the last releases the current one
+void MakeCurrent(BenchContexts& contexts, size_t index) {
+#ifdef __linux__
+    if (contexts.kind == ContextKind::kEgl) {
+        EGLContext context{ index < contexts.contexts.size() ? contexts.contexts[index] : EGL_NO_CONTEXT };
+        eglMakeCurrent(contexts.display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+        return;
+    }
+#endif
+    glfwMakeContextCurrent(index < contexts.windows.size() ? contexts.windows[index] : nullptr);
+}
+
+void DestroyContexts(BenchContexts& contexts) {
+#ifdef __linux__
+    if (contexts.kind == ContextKind::kEgl) {
+        eglMakeCurrent(contexts.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        for (EGLContext context : contexts.contexts) {
+            eglDestroyContext(contexts.display, context);
+        }
+        eglTerminate(contexts.display);
+        return;
+    }
+#endif
+    for (GLFWwindow* window : contexts.windows) {
+        glfwDestroyWindow(window);
+    }
+    glfwTerminate();
+}
+
+// Build the jobs of thread from the shared job counter until none are left
+void RunWorker(size_t thread, BenchContexts& contexts, const Options& options, const std::vector<BenchJob>& jobs,
+    std::atomic<size_t>& next_job, std::vector<BenchResult>& results) {
+    MakeCurrent(contexts, thread);
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(options.driver_threads);
+    }
+
+    // Framebuffers and VAOs are not shared between contexts, so every thread makes its own
+    unsigned int framebuffer{}, color{}, vao{}, frame_data{};
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, kFramebufferSize, kFramebufferSize);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glViewport(0, 0, kFramebufferSize, kFramebufferSize);
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    std::vector<unsigned char> zeros(kFrameDataBytes);
+    glGenBuffers(1, &frame_data);
+    glBindBuffer(GL_UNIFORM_BUFFER, frame_data);
+    glBufferData(GL_UNIFORM_BUFFER, kFrameDataBytes, zeros.data(), GL_STATIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, kFrameDataBinding, frame_data);
+
+    // One cache per thread, since ProgramCache is not thread safe; they share the directory
+    ProgramCache cache{ kCacheDirectory };
+    for (size_t j{ next_job++ }; j < jobs.size(); j = next_job++) {
+        results[j] = BuildJob(jobs[j], cache);
+        results[j].thread = thread;
+    }
+
+    glDeleteBuffers(1, &frame_data);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &color);
+    glFinish();
+    MakeCurrent(contexts, kMaxThreads);
+}
+
+// Build job on the current context, which has a framebuffer, VAO and FrameData buffer bound
+BenchResult BuildJob(const BenchJob& job, ProgramCache& cache) {
+    BenchResult result{ 0, true, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0 };
+    const bool compute{ job.program->frag_path == nullptr };
+    const char* paths[]{ job.program->first_path, job.program->frag_path };
+    const unsigned int types[]{ static_cast<unsigned int>(compute ? GL_COMPUTE_SHADER : GL_VERTEX_SHADER), GL_FRAGMENT_SHADER };
+    const size_t stage_count{ compute ? 1u : 2u };
+
+    auto start = std::chrono::steady_clock::now();
+    PreprocessedSource sources[2];
+    for (size_t s{}; s < stage_count; ++s) {
+        result.ok = PreprocessShader(paths[s], job.defines, sources[s]) && result.ok;
+    }
+    result.preprocess_ms = ElapsedMs(start);
+    if (!result.ok) {
+        return result;
+    }
+
+    // Issue every stage before asking for any status, as ShaderCompiler does
+    start = std::chrono::steady_clock::now();
+    unsigned int stages[2]{};
+    std::vector<const char*> pieces;
+    std::vector<int> lengths;
+    for (size_t s{}; s < stage_count; ++s) {
+        stages[s] = glCreateShader(types[s]);
+        sources[s].GetPieces(pieces, lengths);
+        glShaderSource(stages[s], static_cast<GLsizei>(pieces.size()), pieces.data(), lengths.data());
+        glCompileShader(stages[s]);
+    }
+    for (size_t s{}; s < stage_count; ++s) {
+        int compiled{};
+        glGetShaderiv(stages[s], GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            char info_log[512];
+            glGetShaderInfoLog(stages[s], sizeof(info_log), nullptr, info_log);
+            std::cout << "ERROR [" << paths[s] << " COMPILATION FAILED]\n" << info_log << std::endl;
+            result.ok = false;
+        }
+    }
+    result.compile_ms = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    unsigned int program{ glCreateProgram() };
+    for (size_t s{}; s < stage_count; ++s) {
+        glAttachShader(program, stages[s]);
+    }
+    cache.PrepareForStore(program);
+    glLinkProgram(program);
+    int linked{};
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    result.link_ms = ElapsedMs(start);
+    for (size_t s{}; s < stage_count; ++s) {
+        glDetachShader(program, stages[s]);
+        glDeleteShader(stages[s]);
+    }
+    if (!linked) {
+        char info_log[512];
+        glGetProgramInfoLog(program, sizeof(info_log), nullptr, info_log);
+        std::cout << "ERROR [" << job.program->name << " LINKING FAILED]\n" << info_log << std::endl;
+        glDeleteProgram(program);
+        result.ok = false;
+        return result;
+    }
+
+    // Whatever the driver deferred to the first use; earlier work is drained so it does not count
+    glFinish();
+    start = std::chrono::steady_clock::now();
+    glUseProgram(program);
+    unsigned int block{ glGetUniformBlockIndex(program, "FrameData") };
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, block, kFrameDataBinding);
+    }
+    if (compute) {
+        // object_count is 0, so every invocation returns before touching the unbound buffers
+        glDispatchCompute(1, 1, 1);
+    }
+    else {
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glFinish();
+    result.first_draw_ms = ElapsedMs(start);
+    glUseProgram(0);
+
+    if (cache.IsSupported()) {
+        uint64_t key{ cache.GetDeviceKey() };
+        for (size_t s{}; s < stage_count; ++s) {
+            std::vector<const char*> key_pieces;
+            std::vector<int> key_lengths;
+            sources[s].GetPieces(key_pieces, key_lengths);
+            for (size_t p{}; p < key_pieces.size(); ++p) {
+                key = HashBytes(key, key_pieces[p], static_cast<size_t>(key_lengths[p]));
+            }
+            key = HashBytes(key, "", 1);
+        }
+        start = std::chrono::steady_clock::now();
+        cache.Store(key, program);
+        result.cache_store_ms = ElapsedMs(start);
+        start = std::chrono::steady_clock::now();
+        unsigned int loaded{ cache.Load(key) };
+        result.cache_load_ms = ElapsedMs(start);
+        if (loaded) {
+            glDeleteProgram(loaded);
+        }
+        else {
+            result.cache_load_ms = -1.0;
+        }
+    }
+    glDeleteProgram(program);
+    return result;
+}
+
+// Write the results as JSON
+void WriteJson(std::ostream& out, const BenchContexts& contexts, const Options& options, const std::vector<BenchJob>& jobs,
+    const std::vector<BenchResult>& results, double total_ms) {
+    const char* renderer{ reinterpret_cast<const char*>(glGetString(GL_RENDERER)) };
+    const char* version{ reinterpret_cast<const char*>(glGetString(GL_VERSION)) };
+    out << "{\n";
+    out << "  \"renderer\": "; WriteJsonString(out, renderer ? renderer : ""); out << ",\n";
+    out << "  \"version\": "; WriteJsonString(out, version ? version : ""); out << ",\n";
+    out << "  \"context\": \"" << (contexts.kind == ContextKind::kEgl ? "egl-surfaceless" : "glfw-hidden") << "\",\n";
+    out << "  \"context_version\": \"" << contexts.major << "." << contexts.minor << "\",\n";
+    out << "  \"threads\": " << options.thread_count << ",\n";
+    out << "  \"parallel_shader_compile\": " << (GLAD_GL_KHR_parallel_shader_compile ? "true" : "false") << ",\n";
+    out << "  \"driver_threads\": ";
+    if (options.driver_threads == 0xFFFFFFFFu) { out << "\"driver\""; } else { out << options.driver_threads; }
+    out << ",\n";
+    out << "  \"driver_cache\": " << (options.driver_cache ? "true" : "false") << ",\n";
+    out << "  \"total_ms\": "; WriteJsonMs(out, total_ms); out << ",\n";
+    out << "  \"programs\": [\n";
+    for (size_t j{}; j < jobs.size(); ++j) {
+        const BenchResult& result{ results[j] };
+        out << "    { \"name\": \"" << jobs[j].program->name << "\", \"defines\": [";
+        for (size_t d{}; d < jobs[j].defines.size(); ++d) {
+            out << (d ? ", " : "");
+            WriteJsonString(out, jobs[j].defines[d]);
+        }
+        out << "], \"thread\": " << result.thread << ", \"ok\": " << (result.ok ? "true" : "false");
+        out << ", \"preprocess_ms\": "; WriteJsonMs(out, result.preprocess_ms);
+        out << ", \"compile_ms\": "; WriteJsonMs(out, result.compile_ms);
+        out << ", \"link_ms\": "; WriteJsonMs(out, result.link_ms);
+        out << ", \"first_draw_ms\": "; WriteJsonMs(out, result.first_draw_ms);
+        out << ", \"cache_store_ms\": "; WriteJsonMs(out, result.cache_store_ms);
+        out << ", \"cache_load_ms\": "; WriteJsonMs(out, result.cache_load_ms);
+        out << " }" << (j + 1 < jobs.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}" << std::endl;
+}
+
+// Time and count the allocations of reading and preprocessing the scene program from disk vs embedded
+void RunSourceIo(std::ostream& out, const Options& options) {
+    ShaderSources& sources{ ShaderSources::GetInstance() };
+    const size_t program_count{ options.source_io_programs };
+    const char* const paths[]{ "shader0.vert", "shader0.frag" };
+    // Variants of the scene program, as a ShaderVariantCache would build them
+    const std::vector<std::string> defines(std::begin(kFeatureDefines), std::end(kFeatureDefines));
+
+    // One file set per program, read the way the loader did before sources were embedded:
+    // ifstream -> stringstream -> string, for every file including the includes
+    sources.SetOverrideDirectory(*options.shader_directory ? options.shader_directory : ".");
+    std::vector<std::string> dependencies;
+    std::vector<std::string> stage_dependencies;
+    for (const char* path : paths) {
+        PreprocessedSource source;
+        PreprocessShader(path, defines, source, &stage_dependencies);
+        dependencies.insert(dependencies.end(), stage_dependencies.begin(), stage_dependencies.end());
+    }
+    auto load_copying = [&dependencies, program_count] {
+        size_t bytes{};
+        for (size_t p{}; p < program_count; ++p) {
+            for (const std::string& path : dependencies) {
+                std::ifstream input{ path };
+                std::stringstream stream;
+                stream << input.rdbuf();
+                std::string contents{ stream.str() };
+                bytes += contents.size();
+            }
+        }
+        return bytes;
+    };
+    auto load_pieces = [&paths, &defines, program_count] {
+        size_t pieces{};
+        std::vector<const char*> strings;
+        std::vector<int> lengths;
+        for (size_t p{}; p < program_count; ++p) {
+            for (const char* path : paths) {
+                PreprocessedSource source;
+                PreprocessShader(path, defines, source);
+                source.GetPieces(strings, lengths);
+                pieces += strings.size();
+            }
+        }
+        return pieces;
+    };
+    // @return: allocations made by one call of body
+    auto count_allocations = [](auto&& body) {
+        size_t before{ allocation_count.load(std::memory_order_relaxed) };
+        body();
+        return allocation_count.load(std::memory_order_relaxed) - before;
+    };
+
+    double copying_ms{ TimeMedianMs(load_copying) };
+    size_t copying_allocations{ count_allocations(load_copying) };
+    double mapped_ms{ TimeMedianMs(load_pieces) };
+    size_t mapped_allocations{ count_allocations(load_pieces) };
+    size_t pieces{ load_pieces() };
+    sources.SetOverrideDirectory("");
+    double embedded_ms{ TimeMedianMs(load_pieces) };
+    size_t embedded_allocations{ count_allocations(load_pieces) };
+
+    const double count{ static_cast<double>(program_count) };
+    out << "{\n";
+    out << "  \"programs\": " << program_count << ",\n";
+    out << "  \"files_per_program\": " << dependencies.size() << ",\n";
+    out << "  \"files_embedded\": " << sources.GetEmbeddedCount() << ",\n";
+    out << "  \"pieces_per_program\": " << pieces / count << ",\n";
+    out << "  \"ifstream_copies\": { \"ms\": " << copying_ms << ", \"allocations_per_program\": " << copying_allocations / count << " },\n";
+    out << "  \"mapped_overrides\": { \"ms\": " << mapped_ms << ", \"allocations_per_program\": " << mapped_allocations / count << " },\n";
+    out << "  \"embedded\": { \"ms\": " << embedded_ms << ", \"allocations_per_program\": " << embedded_allocations / count << " }\n";
+    out << "}" << std::endl;
+}
+
+// Write text as a JSON string literal
+void WriteJsonString(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+            out << escaped;
+        }
+        else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+// Write ms, or null if it was not measured
+void WriteJsonMs(std::ostream& out, double ms) {
+    if (ms < 0.0) {
+        out << "null";
+        return;
+    }
+    out << ms;
+}
+
+// @return: milliseconds since start
+double ElapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// @return: median milliseconds of kSourceIoRepeats calls of body, after one warm-up call
+template <typename Body>
+double TimeMedianMs(Body&& body) {
+    body();
+    std::vector<double> times(kSourceIoRepeats);
+    for (double& time : times) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        time = ElapsedMs(start);
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
@@ -0,0 +1,130 @@
+/*
+Offline texture baker. Decodes each source image once, builds its mip chain and writes it as a
+GPU-ready .btx container next to the source (container.jpg -> container.jpg.btx), which
+TextureManager then uploads straight from a memory mapping instead of decoding the image.
+Bakes that are still current (same source hash) are skipped. No GL context is needed.
+
+usage: TextureBaker [--force] [--format bc1|bc3|bc4|bc5] [--fast] [--mips box|kaiser|lanczos] [--linear] FILE...
+    --force     bake even if the existing bake is current
+    --format    block compress every level: bc1 for RGB, bc3 for RGBA, bc4 for one channel, bc5 for two
+    --fast      bounding box endpoints instead of the slower, better endpoint search
+    --mips      mip filter, box by default
+    --linear    the sources hold data, e.g. normals, rather than sRGB color: filter them as stored
+*/
+
+#include "BakedTexture.h"
+#include "BlockCompression.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+// The one translation unit of the baker that holds the stb_image implementation
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image_.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Settings parsed from the command line
+struct Options {
+    bool force{};
+    TextureBakeOptions bake;
+    std::vector<std::string> sources;
+};
+
+// Parse the command line; see the usage at the top of this file
+static bool ParseOptions(int argc, char* argv[], Options& options);
+// @return: whether the bake at baked_path was made from the current contents of source_path
+static bool IsBakeCurrent(const std::string& source_path, const std::string& baked_path);
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    JobSystem jobs;
+    options.bake.jobs = &jobs;
+    int result{};
+    for (const std::string& source_path : options.sources) {
+        std::string baked_path{ GetBakedTexturePath(source_path) };
+        if (!options.force && IsBakeCurrent(source_path, baked_path)) {
+            std::cout << source_path << ": up to date" << std::endl;
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (!BakeTexture(source_path, baked_path, options.bake)) {
+            result = 1;
+            continue;
+        }
+        double ms{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+        // Reopened only to describe what was written; a stale status is expected without the source hash
+        BakedTexture baked{ baked_path, 0 };
+        const BakedTextureHeader& header{ baked.GetHeader() };
+        std::cout << source_path << " -> " << baked_path << ": " << header.width << "x" << header.height << ", "
+            << header.level_count << " levels, " << (options.bake.compress ? GetBlockFormatName(options.bake.format) : "uncompressed") << ", "
+            << GetMipFilterName(options.bake.mip_filter) << " mips, " << baked.GetDataBytes() / 1024. << " KB, " << ms << " ms" << std::endl;
+    }
+    return result;
+}
+
+/* Non-member helper implementation */
+
+// Parse the command line; see the usage at the top of this file
+bool ParseOptions(int argc, char* argv[], Options& options) {
+    for (int i{ 1 }; i < argc; ++i) {
+        if (strcmp(argv[i], "--force") == 0) {
+            options.force = true;
+        }
+        else if (strcmp(argv[i], "--fast") == 0) {
+            options.bake.quality = BlockQuality::kFast;
+        }
+        else if (strcmp(argv[i], "--linear") == 0) {
+            options.bake.srgb = false;
+        }
+        else if (strcmp(argv[i], "--mips") == 0 && i + 1 < argc) {
+            const char* name{ argv[++i] };
+            if (strcmp(name, "box") == 0) { options.bake.mip_filter = MipFilter::kBox; }
+            else if (strcmp(name, "kaiser") == 0) { options.bake.mip_filter = MipFilter::kKaiser; }
+            else if (strcmp(name, "lanczos") == 0) { options.bake.mip_filter = MipFilter::kLanczos; }
+            else {
+                std::cout << "ERROR [UNKNOWN MIP FILTER " << name << "]" << std::endl;
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char* name{ argv[++i] };
+            options.bake.compress = true;
+            if (strcmp(name, "bc1") == 0) { options.bake.format = BlockFormat::kBC1; }
+            else if (strcmp(name, "bc3") == 0) { options.bake.format = BlockFormat::kBC3; }
+            else if (strcmp(name, "bc4") == 0) { options.bake.format = BlockFormat::kBC4; }
+            else if (strcmp(name, "bc5") == 0) { options.bake.format = BlockFormat::kBC5; }
+            else {
+                std::cout << "ERROR [UNKNOWN FORMAT " << name << "]" << std::endl;
+                return false;
+            }
+        }
+        else if (strncmp(argv[i], "--", 2) == 0) {
+            std::cout << "ERROR [UNKNOWN OPTION " << argv[i] << "]" << std::endl;
+            return false;
+        }
+        else {
+            options.sources.push_back(argv[i]);
+        }
+    }
+    if (options.sources.empty()) {
+        std::cout << "usage: TextureBaker [--force] [--format bc1|bc3|bc4|bc5] [--fast] [--mips box|kaiser|lanczos] [--linear] FILE..." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// @return: whether the bake at baked_path was made from the current contents of source_path
+bool IsBakeCurrent(const std::string& source_path, const std::string& baked_path) {
+    MappedFile source{ source_path.c_str() };
+    if (!source.IsValid()) {
+        return false;
+    }
+    return BakedTexture{ baked_path, HashTextureSource(source.GetData(), source.GetSize()) }.IsValid();
+}